@@ -5,6 +5,7 @@ if __name__ == "__main__":
 
 ################################################################################
 
+import os
 import scons_msvc_env as msvc_env
 
 env = msvc_env.MsvcEnvironment()
@@ -12,6 +13,15 @@ env.set_build_dir("src", "build")
 env.Append(CPPPATH=[".", "pcre2_16", "romato/src"])
 env.Append(CPPDEFINES=["UNICODE", "HAVE_CONFIG_H"])
 
+# The JIT is always built. pcre2_jit_compile.c includes pcre2_jit_match.c,
+# pcre2_jit_misc.c and the sljit directory, which have to be those of PCRE2
+# 10.30 like the rest of pcre2_16.
+if not os.path.isfile("src/pcre2_16/sljit/sljitLir.c"):
+    raise SystemExit(
+        "copy pcre2_jit_*.c and sljit/ of PCRE2 10.30 to src/pcre2_16"
+        )
+env.Append(CPPDEFINES=["SUPPORT_JIT"])
+
 env_pcre = env.Clone()
 env_pcre.Append(CPPDEFINES=["_CRTIMP=", "_CRTIMP2_PURE=", "_VCRTIMP="])
 env_pcre.modify_flags("CCFLAGS", ["/W3", "/w44244", "/w44267"], ["/W4"])
@@ -33,10 +43,24 @@ pcre_src = [
     "pcre2_16/pcre2_ucd.c",
     "pcre2_16/pcre2_valid_utf.c",
     "pcre2_16/pcre2_xclass.c",
+    "pcre2_16/pcre2_jit_compile.c",
     "pcre2_16/pcre2_adapt.c",
     ]
 objs = env_pcre.Object(source=pcre_src)
 
+# The 8 bit library is built from the same sources. pcre2_adapt.c does not
+# depend on the code unit width and is only needed once.
+env_pcre8 = env_pcre.Clone()
+env_pcre8.Append(CPPDEFINES=["PCRE2_CODE_UNIT_WIDTH=8"])
+for s in pcre_src:
+    if not s.endswith("_adapt.c"):
+        objs += env_pcre8.Object(target=s[:-2] + "_8", source=s)
+
+# The result store and the platform layer only need the C library and the
+# system headers (see bld_test.py), so they are built without the
+# precompiled header.
+objs += env.Object(source=["result_store.cpp", "platform_win.cpp"])
+
 env.use_pch()
 
 env_mlib = env.Clone()
@@ -54,11 +78,18 @@ objs += env_mlib.Object(source=mlib_src)
 src = [
     "auto_complete_cb.cpp",
     "dir_iter.cpp",
+    "glob_set.cpp",
+    "ignore_rules.cpp",
+    "literal_finder.cpp",
     "rgrep.cpp",
+    "rgrep_bench.cpp",
+    "rgrep_cli.cpp",
     "rgrep_util.cpp",
     "rgrep_rx.cpp",
     "rgrep_dlg.cpp",
+    "result_cache.cpp",
     "text_file.cpp",
+    "trigram_index.cpp",
     "search_thread.cpp",
     "settings_dlg.cpp",
     ]
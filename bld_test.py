@@ -0,0 +1,122 @@
+if __name__ == "__main__":
+    import sys, subprocess # noqa : E401
+    sys.argv[0:1] = [sys.executable, "-m", "SCons", "-f", __file__]
+    sys.exit(subprocess.run(sys.argv).returncode)
+
+################################################################################
+
+# The headless tests only need the standard library. They are built with the
+# default tools of SCons (MSVC on Windows, gcc or clang elsewhere) and are
+# run right after they have been built. A test that fails breaks the build.
+#
+# Elsewhere than on Windows, the search and -cli are built as well, with
+# src/posix standing in for romato. test_dir_iter compares the walkers and
+# test_cli runs a few searches.
+
+import sys
+
+env = Environment()
+env.VariantDir("build/test", "src", duplicate=False)
+if env.subst("$CXX") == "cl":
+    env.Append(CXXFLAGS=["/EHsc", "/W4"])
+else:
+    env.Append(CXXFLAGS=["-std=c++17", "-Wall", "-Wextra", "-O2"])
+    env.Append(LIBS=["pthread"])
+
+# Like on Windows, os_char is a wchar_t of 16 bits (see platform.h).
+env_os = env.Clone()
+if sys.platform != "win32":
+    env_os.Append(CCFLAGS=["-fshort-wchar"])
+
+platform_src = (
+    "platform_win.cpp" if sys.platform == "win32" else "platform_posix.cpp"
+    )
+
+# the objects a test is linked with besides its own sources
+extra_objs = {}
+
+tests = {
+    "test_result_store": (env, [
+        "test/test_result_store.cpp",
+        "result_store.cpp",
+        ]),
+    "test_platform": (env_os, [
+        "test/test_platform.cpp",
+        platform_src,
+        ]),
+    }
+
+if sys.platform != "win32":
+    env_core = env_os.Clone()
+    env_core.Append(CPPPATH=["src/posix", "src", "src/pcre2_16"])
+    env_core.Append(CPPDEFINES=["HAVE_CONFIG_H"])
+    env_core.Append(CFLAGS=["-O2"])
+
+    # PCRE2 without the JIT, for 16 and 8 bit code units like in bld.py
+    pcre_src = [
+        "pcre2_16/pcre2_auto_possess.c",
+        "pcre2_16/pcre2_chartables.c",
+        "pcre2_16/pcre2_compile.c",
+        "pcre2_16/pcre2_context.c",
+        "pcre2_16/pcre2_find_bracket.c",
+        "pcre2_16/pcre2_match.c",
+        "pcre2_16/pcre2_match_data.c",
+        "pcre2_16/pcre2_newline.c",
+        "pcre2_16/pcre2_ord2utf.c",
+        "pcre2_16/pcre2_string_utils.c",
+        "pcre2_16/pcre2_study.c",
+        "pcre2_16/pcre2_substitute.c",
+        "pcre2_16/pcre2_substring.c",
+        "pcre2_16/pcre2_tables.c",
+        "pcre2_16/pcre2_ucd.c",
+        "pcre2_16/pcre2_valid_utf.c",
+        "pcre2_16/pcre2_xclass.c",
+        ]
+    core_objs = env_core.Object(
+        ["build/test/" + s for s in pcre_src + ["pcre2_16/pcre2_adapt.c"]]
+        )
+    env_pcre8 = env_core.Clone()
+    env_pcre8.Append(CPPDEFINES=["PCRE2_CODE_UNIT_WIDTH=8"])
+    for s in pcre_src:
+        core_objs += env_pcre8.Object(
+            "build/test/" + s[:-2] + "_8",
+            "build/test/" + s
+            )
+
+    core_src = [
+        "posix/yast.cpp",
+        "platform_posix.cpp",
+        "dir_iter.cpp",
+        "glob_set.cpp",
+        "ignore_rules.cpp",
+        "literal_finder.cpp",
+        "result_cache.cpp",
+        "result_store.cpp",
+        "rgrep_bench.cpp",
+        "rgrep_cli.cpp",
+        "rgrep_rx.cpp",
+        "rgrep_util.cpp",
+        "search_thread.cpp",
+        "text_file.cpp",
+        "trigram_index.cpp",
+        ]
+    for s in core_src:
+        core_objs += env_core.Object(
+            "build/test/core/" + s[:-4],
+            "build/test/" + s
+            )
+    for name in ["test_dir_iter", "test_cli"]:
+        tests[name] = (env_core, ["test/" + name + ".cpp"])
+        extra_objs[name] = core_objs
+
+for name, (test_env, src) in tests.items():
+    exe = test_env.Program(
+        "build/test/" + name,
+        ["build/test/" + s for s in src] + extra_objs.get(name, [])
+        )
+    passed = test_env.Command(
+        "build/test/" + name + ".passed",
+        exe,
+        [[exe[0].abspath], Touch("$TARGET")]
+        )
+    test_env.Default(passed)
@@ -32,45 +32,35 @@
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-DirectoryIterator::SingleDirIterator::SingleDirIterator(
-    SingleDirIterator* parent,
-    const Yast& pattern
-    ) :
-    m_path_prefix(pattern.str(), pattern.length() - 1),
-    m_parent(parent),
-    m_done_first(false)
+//
+// Copies str (including its terminator) to buf at pos and returns the length
+// of the string that ends there. buf is only grown, never shrunk, so it
+// stops being reallocated once the deepest path has been seen.
+//
+static UINT put_str(cvector<WCHAR>& buf, UINT pos, PCWSTR str)
 {
-    m_handle = FindFirstFileEx(
-        pattern,
-        FindExInfoBasic,
-        &m_find_data,
-        FindExSearchNameMatch,
-        nullptr,
-        // ignore pre Win7 systems and use
-        FIND_FIRST_EX_LARGE_FETCH
-        );
+    const UINT len = static_cast<UINT>(os_strlen(str));
+    if (buf.size() < pos + len + 1)
+    {
+        buf.resize(pos + len + 1 + MAX_PATH);
+    }
+    memcpy(&buf[pos], str, (len + 1) * sizeof(WCHAR));
+    return pos + len;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool DirectoryIterator::SingleDirIterator::next()
+DirectoryIterator::SingleDirIterator::SingleDirIterator(
+    SingleDirIterator* parent,
+    PCWSTR dir,
+    UINT prefix_len
+    ) :
+    m_entry(),
+    m_prefix_len(prefix_len),
+    m_parent(parent)
 {
-    bool found;
-    if (!m_done_first)
-    {
-        m_done_first = true;
-        found = (m_handle != INVALID_HANDLE_VALUE);
-    }
-    else
-    {
-        found = (FindNextFile(m_handle, &m_find_data) != 0);
-    }
-
-    while (found && is_dots())
-    {
-        found = (FindNextFile(m_handle, &m_find_data) != 0);
-    }
-    return found;
+    // A directory that cannot be read is like an empty one.
+    m_reader.open(dir);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -79,20 +69,20 @@ bool DirectoryIterator::SingleDirIterator::next()
 
 DirectoryIterator::DirectoryIterator(const Yast& dir_name) :
     m_dir_queue(nullptr),
+    m_depth(0),
+    m_path_len(0),
     m_prefix_len(0),
     m_done_first(false)
 {
     TRACE("dir iter: '%S'\n", dir_name.str());
-    if (PathIsDirectory(dir_name))
+    if (os_is_dir(dir_name))
     {
-        PCWSTR add = L"*";
-        m_prefix_len = dir_name.length();
-        if (dir_name.str()[m_prefix_len - 1] != L'\\')
+        m_prefix_len = put_str(m_path, 0, dir_name);
+        if (m_path[m_prefix_len - 1] != OS_SEP)
         {
-            add = L"\\*";
-            m_prefix_len++;
+            m_prefix_len = put_str(m_path, m_prefix_len, OS_SEP_STR);
         }
-        go_sub(dir_name + add);
+        go_sub(m_prefix_len);
     }
 }
 
@@ -109,7 +99,25 @@ DirectoryIterator::~DirectoryIterator()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool DirectoryIterator::next(Yast &path, bool& is_dir, bool go_down)
+void DirectoryIterator::set_path(UINT prefix_len, PCWSTR name)
+{
+    m_path_len = put_str(m_path, prefix_len, name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirectoryIterator::go_sub(UINT dir_len)
+{
+    // m_path holds the directory including its trailing separator
+    put_str(m_path, dir_len, L"");
+    TRACE("sub: '%S'\n", &m_path[0]);
+    m_dir_queue = new SingleDirIterator(m_dir_queue, &m_path[0], dir_len);
+    m_depth++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DirectoryIterator::next(bool& is_dir, bool go_down)
 {
     if (m_dir_queue == nullptr)
     {
@@ -122,7 +130,8 @@ bool DirectoryIterator::next(Yast &path, bool& is_dir, bool go_down)
     }
     else if (go_down && m_dir_queue->is_dir())
     {
-        go_sub(m_dir_queue->get_path() + L"\\*");
+        // m_path still holds the path of that directory
+        go_sub(put_str(m_path, m_path_len, OS_SEP_STR));
     }
 
     while (!m_dir_queue->next())
@@ -134,8 +143,8 @@ bool DirectoryIterator::next(Yast &path, bool& is_dir, bool go_down)
         }
     }
 
-    path = m_dir_queue->get_path();
-    TRACE("dir iter found: '%S'\n", path.str());
+    set_path(m_dir_queue->m_prefix_len, m_dir_queue->m_entry.name);
+    TRACE("dir iter found: '%S'\n", &m_path[0]);
     is_dir = m_dir_queue->is_dir();
     return true;
 }
@@ -143,3 +152,494 @@ bool DirectoryIterator::next(Yast &path, bool& is_dir, bool go_down)
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
+
+PathArena::PathArena()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void PathArena::reset(const Yast& root)
+{
+    Node node;
+    node.parent = NO_PARENT;
+    node.name_pos = 0;
+    node.name_len = root.length();
+    node.path_len = root.length();
+
+    m_lock.lock();
+    m_nodes.clear();
+    m_names.clear();
+    m_nodes.push_back(node);
+    m_names.insert(m_names.end(), root.str(), root.str() + root.length());
+    m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT PathArena::add(UINT parent, PCWSTR name)
+{
+    const UINT len = static_cast<UINT>(os_strlen(name));
+    Node node;
+    node.parent = parent;
+    node.name_len = len;
+
+    m_lock.lock();
+    node.name_pos = static_cast<UINT>(m_names.size());
+    node.path_len = m_nodes[parent].path_len + len + 1;
+    m_names.insert(m_names.end(), name, name + len);
+    m_nodes.push_back(node);
+    const UINT id = static_cast<UINT>(m_nodes.size() - 1);
+    m_lock.unlock();
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT PathArena::get_path(UINT dir, cvector<WCHAR>& buf)
+{
+    m_lock.lock_shared();
+    const UINT path_len = m_nodes[dir].path_len;
+    if (buf.size() < path_len + 1)
+    {
+        buf.resize(path_len + 1 + MAX_PATH);
+    }
+    buf[path_len] = 0;
+
+    // from the end of the path back to the root
+    UINT pos = path_len;
+    for (UINT id = dir; id != NO_PARENT; id = m_nodes[id].parent)
+    {
+        const Node& node = m_nodes[id];
+        if (id != 0)
+        {
+            buf[--pos] = OS_SEP;
+        }
+        pos -= node.name_len;
+        memcpy(
+            &buf[pos],
+            &m_names[node.name_pos],
+            node.name_len * sizeof(WCHAR)
+            );
+    }
+    m_lock.unlock_shared();
+    return path_len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+ParallelDirWalker::ParallelDirWalker(
+    const Yast& dir_name,
+    ENTER_CB enter_cb,
+    DIR_CB dir_cb,
+    FILE_CB file_cb,
+    LEAVE_CB leave_cb,
+    void* pctxt,
+    const volatile long* canceled
+    ) :
+    m_enter_cb(enter_cb),
+    m_dir_cb(dir_cb),
+    m_file_cb(file_cb),
+    m_leave_cb(leave_cb),
+    m_pctxt(pctxt),
+    m_canceled(canceled),
+    m_pending(0),
+    m_num_idle(0)
+{
+    TRACE("parallel dir walker: '%S'\n", dir_name.str());
+    if (os_is_dir(dir_name))
+    {
+        m_root = dir_name;
+        if (m_root.str()[m_root.length() - 1] != OS_SEP)
+        {
+            m_root += OS_SEP_STR;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::run(UINT num_walkers, const void* root_scope)
+{
+    if (m_root.is_empty())
+    {
+        return;
+    }
+    if (num_walkers < 1)
+    {
+        num_walkers = 1;
+    }
+    else if (num_walkers > MAX_WALKERS)
+    {
+        num_walkers = MAX_WALKERS;
+    }
+
+    m_walkers.clear();
+    m_walkers.resize(num_walkers);
+    for (UINT i = 0; i < num_walkers; i++)
+    {
+        Walker& walker = m_walkers[i];
+        walker.owner = this;
+        walker.index = i;
+        walker.head = 0;
+        walker.lock = &m_locks[i];
+    }
+    m_dirs.reset(m_root);
+    const Pending root = { 0, root_scope };
+    push(m_walkers[0], root);
+
+    // The first walker runs on the calling thread. So even if no other
+    // thread can be created, the whole tree is going to be walked.
+    for (UINT i = 1; i < num_walkers; i++)
+    {
+        m_threads[i].start(walker_proc, &m_walkers[i]);
+    }
+    walker_proc(&m_walkers[0]);
+    for (UINT i = 1; i < num_walkers; i++)
+    {
+        if (m_threads[i].is_started())
+        {
+            m_threads[i].join();
+        }
+    }
+    m_walkers.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::walker_proc(void* pctxt)
+{
+    Walker& walker = *p2p<Walker*>(pctxt);
+    ParallelDirWalker* self = walker.owner;
+    Pending dir;
+    while (!*self->m_canceled)
+    {
+        if (self->pop(walker, dir) || self->steal(walker, dir))
+        {
+            self->walk_dir(walker, dir);
+            if (os_decrement(&self->m_pending) == 0)
+            {
+                // Nobody is walking anymore, so nobody can produce new
+                // work. The idle walkers have to notice that.
+                self->wake_idle(true);
+            }
+        }
+        else if (self->m_pending == 0)
+        {
+            break;
+        }
+        else
+        {
+            // Others are still busy and may find more directories.
+            self->wait_for_work();
+        }
+    }
+
+    // After canceling, m_pending does not drop to zero.
+    self->wake_idle(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::push(Walker& walker, const Pending& dir)
+{
+    // Count the directory before anybody is able to take it, so that
+    // m_pending cannot drop to zero while there is still work.
+    os_increment(&m_pending);
+    walker.lock->lock();
+    walker.pending.push_back(dir);
+    walker.lock->unlock();
+
+    // A walker that goes to sleep counts itself as idle before it looks for
+    // work a last time. So either it sees this entry or we see it.
+    if (m_num_idle != 0)
+    {
+        wake_idle(false);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ParallelDirWalker::pop(Walker& walker, Pending& dir)
+{
+    bool found = false;
+    walker.lock->lock();
+    if (walker.pending.size() > walker.head)
+    {
+        dir = walker.pending.back();
+        walker.pending.pop_back();
+        if (walker.pending.size() == walker.head)
+        {
+            walker.pending.clear();
+            walker.head = 0;
+        }
+        found = true;
+    }
+    walker.lock->unlock();
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ParallelDirWalker::steal(Walker& thief, Pending& dir)
+{
+    // Taking the oldest entry of a victim means taking the directory that
+    // is closest to the root and most likely has the largest sub tree.
+    const UINT num_walkers = static_cast<UINT>(m_walkers.size());
+    for (UINT i = 1; i < num_walkers; i++)
+    {
+        Walker& victim = m_walkers[(thief.index + i) % num_walkers];
+        bool found = false;
+        victim.lock->lock();
+        if (victim.pending.size() > victim.head)
+        {
+            dir = victim.pending[victim.head++];
+            if (victim.pending.size() == victim.head)
+            {
+                victim.pending.clear();
+                victim.head = 0;
+            }
+            found = true;
+        }
+        victim.lock->unlock();
+        if (found)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ParallelDirWalker::has_work()
+{
+    for (Walker& walker : m_walkers)
+    {
+        walker.lock->lock_shared();
+        const bool found = walker.pending.size() > walker.head;
+        walker.lock->unlock_shared();
+        if (found)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::wait_for_work()
+{
+    m_idle_lock.lock();
+    os_increment(&m_num_idle);
+    while (!*m_canceled && m_pending != 0 && !has_work())
+    {
+        m_cv_idle.wait(m_idle_lock);
+    }
+    os_decrement(&m_num_idle);
+    m_idle_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::wake_idle(bool all)
+{
+    // Taking the lock makes sure that nobody is between looking for work
+    // and going to sleep.
+    m_idle_lock.lock();
+    m_idle_lock.unlock();
+    if (all)
+    {
+        m_cv_idle.wake_all();
+    }
+    else
+    {
+        m_cv_idle.wake_one();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ParallelDirWalker::walk_dir(Walker& walker, const Pending& dir)
+{
+    // The path of the directory is put together once. The names of its
+    // entries are then only copied behind it.
+    const UINT dir_len = m_dirs.get_path(dir.dir, walker.path);
+    const void* scope = dir.scope;
+    if (m_enter_cb)
+    {
+        scope = m_enter_cb(
+            m_pctxt,
+            walker.index,
+            scope,
+            &walker.path[0],
+            dir_len
+            );
+    }
+    put_str(walker.path, dir_len, L"");
+
+    OsDirReader reader;
+    OsDirEntry entry;
+    if (reader.open(&walker.path[0]))
+    {
+        while (!*m_canceled && reader.next(entry))
+        {
+            put_str(walker.path, dir_len, entry.name);
+            PCWSTR const path = &walker.path[0];
+            if (entry.is_dir())
+            {
+                // prune before the directory is ever opened
+                const void* sub_scope = scope;
+                const bool walk_sub = m_dir_cb(
+                    m_pctxt,
+                    walker.index,
+                    scope,
+                    path,
+                    entry,
+                    sub_scope
+                    );
+                if (walk_sub)
+                {
+                    const Pending sub = {
+                        m_dirs.add(dir.dir, entry.name),
+                        sub_scope
+                        };
+                    push(walker, sub);
+                }
+            }
+            else
+            {
+                m_file_cb(m_pctxt, walker.index, scope, path, entry);
+            }
+        }
+    }
+    if (m_leave_cb)
+    {
+        m_leave_cb(m_pctxt, walker.index, scope);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+DirWatcher::DirWatcher() :
+    m_overflow(false),
+    m_failed(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+DirWatcher::~DirWatcher()
+{
+    stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DirWatcher::start(const Yast& root)
+{
+    stop();
+    if (!m_monitor.open(root) || !m_thread.start(watch_proc, this))
+    {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirWatcher::stop()
+{
+    if (m_thread.is_started())
+    {
+        m_monitor.stop();
+        m_thread.join();
+    }
+    m_monitor.close();
+    m_changed.clear();
+    m_overflow = false;
+    m_failed = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DirWatcher::take(YastVector& changed)
+{
+    changed.clear();
+    m_lock.lock();
+    for (const Yast& name : m_changed)
+    {
+        changed.push_back(name);
+    }
+    m_changed.clear();
+    const bool overflow = m_overflow;
+    m_overflow = false;
+    m_lock.unlock();
+    return !overflow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DirWatcher::failed()
+{
+    m_lock.lock_shared();
+    const bool failed = m_failed;
+    m_lock.unlock_shared();
+    return failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirWatcher::set_lost(bool failed)
+{
+    m_lock.lock();
+    m_overflow = true;
+    m_failed = m_failed || failed;
+    m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirWatcher::on_name(void* pctxt, const os_char* name, size_t len)
+{
+    DirWatcher* self = p2p<DirWatcher*>(pctxt);
+    self->m_lock.lock();
+    self->m_changed.insert(Yast(name, static_cast<UINT>(len)));
+    self->m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void DirWatcher::watch_proc(void* pctxt)
+{
+    DirWatcher* self = p2p<DirWatcher*>(pctxt);
+    for (;;)
+    {
+        switch (self->m_monitor.wait(on_name, self))
+        {
+            case OsDirMonitor::CHANGES:
+                break;
+
+            case OsDirMonitor::LOST:
+                self->set_lost(false);
+                break;
+
+            case OsDirMonitor::STOPPED:
+                return;
+
+            default:
+                // e.g. the root has been deleted
+                TRACE("dir watcher: failed\n");
+                self->set_lost(true);
+                return;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
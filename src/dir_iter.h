@@ -27,77 +27,103 @@
 
 #pragma once
 
+#include "platform.h"
+
 ////////////////////////////////////////////////////////////////////////////////
 
+//
+// Walks a directory tree depth first. The path of the current entry is kept
+// in a single buffer: the directories on the way down leave their part of
+// the path in it, so only the name of the entry has to be put behind it.
+// Nothing is allocated per entry, only per directory.
+//
 class DirectoryIterator
 {
 protected:
 
     struct SingleDirIterator
     {
-        WIN32_FIND_DATAW m_find_data;
-        HANDLE m_handle;
-        Yast m_path_prefix;
+        OsDirReader m_reader;
+        OsDirEntry m_entry;
+        UINT m_prefix_len;          // of its directory in m_path
         SingleDirIterator *m_parent;
-        bool m_done_first;
 
-        SingleDirIterator(SingleDirIterator* parent, const Yast& path);
-        bool next();
+        SingleDirIterator(
+            SingleDirIterator* parent,
+            PCWSTR dir,
+            UINT prefix_len
+            );
 
-        bool is_dots()
+        bool next()
         {
-            const WCHAR *const n = m_find_data.cFileName;
-            return (
-                (n[0] == L'.') &&
-                ((n[1] == 0) || ((n[1] == L'.') && (n[2] == 0)))
-                );
+            return m_reader.next(m_entry);
         }
 
         bool is_dir()
         {
-            return !!(m_find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
-        }
-
-        Yast get_path()
-        {
-            PCWSTR cstr = m_find_data.cFileName;
-            return m_path_prefix + cstr;
+            return m_entry.is_dir();
         }
 
-        const WIN32_FIND_DATA* get_info()
+        const OsDirEntry* get_info()
         {
-            return &m_find_data;
-        }
-
-        ~SingleDirIterator()
-        {
-            FindClose(m_handle);
+            return &m_entry;
         }
     };
 
     SingleDirIterator* m_dir_queue;
+    UINT m_depth;                   // of m_dir_queue
+    cvector<WCHAR> m_path;          // of the current entry, 0 terminated
+    UINT m_path_len;
     UINT m_prefix_len;
     bool m_done_first;
 
-    void go_sub(const Yast& dir_name)
-    {
-        TRACE("sub: '%S'\n", dir_name.str());
-        m_dir_queue = new SingleDirIterator(m_dir_queue, dir_name);
-    }
+    void set_path(UINT prefix_len, PCWSTR name);
+    void go_sub(UINT dir_len);
 
     void go_up()
     {
         SingleDirIterator *obsolete = m_dir_queue;
         m_dir_queue = m_dir_queue->m_parent;
+        m_depth--;
         delete obsolete;
     }
 
 public:
     DirectoryIterator(const Yast& dir_name);
     ~DirectoryIterator();
-    bool next(Yast &path, bool& is_dir, bool go_down);
 
-    const WIN32_FIND_DATA* get_info()
+    // The path of the entry that has been found is provided by path_str().
+    bool next(bool& is_dir, bool go_down);
+
+    bool next(Yast &path, bool& is_dir, bool go_down)
+    {
+        const bool found = next(is_dir, go_down);
+        if (found)
+        {
+            path = Yast(path_str(), m_path_len);
+        }
+        return found;
+    }
+
+    // Only valid until next() is called again. The first prefix_len()
+    // characters are always the root with a trailing separator.
+    PCWSTR path_str() const
+    {
+        return &m_path[0];
+    }
+
+    UINT path_len() const
+    {
+        return m_path_len;
+    }
+
+    // The entries of the root have the depth 1.
+    UINT depth() const
+    {
+        return m_depth;
+    }
+
+    const OsDirEntry* get_info()
     {
         return m_dir_queue ? m_dir_queue->get_info() : nullptr;
     }
@@ -110,3 +136,201 @@ public:
 };
 
 ////////////////////////////////////////////////////////////////////////////////
+
+//
+// The directories found during a walk. Every one is stored once as its name
+// and the id of its parent, so a deep tree does not repeat its upper parts.
+// The root has the id 0 and its name is the whole path to it including the
+// trailing separator. May be used by several threads at once.
+//
+class PathArena
+{
+public:
+    PathArena();
+    void reset(const Yast& root);
+
+    UINT add(UINT parent, PCWSTR name);
+
+    // Puts the path of dir (ending with a separator) at the beginning of
+    // buf and returns its length. buf only grows, if it is too small.
+    UINT get_path(UINT dir, cvector<WCHAR>& buf);
+
+    static const UINT NO_PARENT = ~0u;
+
+protected:
+    PathArena(const PathArena&) = delete;
+    PathArena& operator=(const PathArena&) = delete;
+
+    struct Node
+    {
+        UINT parent;
+        UINT name_pos;
+        UINT name_len;
+        UINT path_len;              // including the trailing separator
+    };
+
+    OsRwLock m_lock;
+    cvector<Node> m_nodes;
+    cvector<WCHAR> m_names;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Walks a directory tree with several threads. Every walker owns a queue of
+// pending directories. Sub directories that are found by a walker are added
+// to its own queue, and walkers that ran out of work steal from the queues of
+// the others. The callbacks are called concurrently from all walkers, so the
+// order in which files are reported is not deterministic. Only the entries of
+// a single directory are reported in the order they are listed, by a single
+// walker, and the optional leave callback follows the last of them.
+//
+// Every directory has a scope, an opaque pointer for the callbacks. The root
+// gets the one that is passed to run(). The dir callback may give a sub
+// directory a scope of its own, otherwise it inherits the scope of its
+// parent. When a walker starts with a directory, the optional enter callback
+// may replace its scope. The result is passed to the callbacks for its
+// entries. So a caller that needs the order of a sequential walk can put
+// together the entries of every directory and its sub directories.
+//
+class ParallelDirWalker
+{
+public:
+    // dir ends with a separator.
+    using ENTER_CB = const void*(*)(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR dir,
+        UINT dir_len
+        );
+    // Called for every sub directory. Return false to skip it. sub_scope
+    // starts as scope and is what the sub directory gets.
+    using DIR_CB = bool(*)(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR path,
+        const OsDirEntry& info,
+        const void*& sub_scope
+        );
+    // Called for every file. path is only valid during the call.
+    using FILE_CB = void(*)(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR path,
+        const OsDirEntry& info
+        );
+    // Called when all entries of a directory have been reported, even if
+    // it could not be read.
+    using LEAVE_CB = void(*)(
+        void* pctxt,
+        UINT walker,
+        const void* scope
+        );
+
+    ParallelDirWalker(
+        const Yast& dir_name,
+        ENTER_CB enter_cb,
+        DIR_CB dir_cb,
+        FILE_CB file_cb,
+        LEAVE_CB leave_cb,
+        void* pctxt,
+        const volatile long* canceled
+        );
+    void run(UINT num_walkers, const void* root_scope = nullptr);
+
+    UINT prefix_len()
+    {
+        return m_root.length();
+    }
+
+    static const UINT MAX_WALKERS = 64;
+
+protected:
+
+    struct Pending
+    {
+        UINT dir;                   // in m_dirs
+        const void* scope;
+    };
+
+    struct Walker
+    {
+        ParallelDirWalker* owner;
+        UINT index;
+        OsRwLock* lock;             // in m_locks
+        cvector<Pending> pending;   // owner works at the back
+        size_t head;                // thieves take from here
+        cvector<WCHAR> path;        // of the current entry
+    };
+
+    cvector<Walker> m_walkers;
+    OsRwLock m_locks[MAX_WALKERS];
+    OsThread m_threads[MAX_WALKERS];    // m_threads[0] is not used
+    PathArena m_dirs;
+    Yast m_root;
+    ENTER_CB m_enter_cb;
+    DIR_CB m_dir_cb;
+    FILE_CB m_file_cb;
+    LEAVE_CB m_leave_cb;
+    void* m_pctxt;
+    const volatile long* m_canceled;
+    volatile long m_pending;        // directories queued or being walked
+    volatile long m_num_idle;       // walkers that are waiting for work
+    OsMutex m_idle_lock;
+    OsCondVar m_cv_idle;
+
+    static void walker_proc(void* pctxt);
+    void push(Walker& walker, const Pending& dir);
+    bool pop(Walker& walker, Pending& dir);
+    bool steal(Walker& thief, Pending& dir);
+    bool has_work();
+    void wait_for_work();
+    void wake_idle(bool all);
+    void walk_dir(Walker& walker, const Pending& dir);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Collects the names of the files and directories below a root, that have
+// been created, deleted, renamed or written, with an OsDirMonitor on a
+// thread of its own. The names are relative to the root. When changes
+// are lost, because there were too many of them at once, take() reports
+// that the whole tree has to be looked at again. That happens as well, if
+// watching failed and ended. Then failed() is true, until start() is
+// called again.
+//
+class DirWatcher
+{
+public:
+    DirWatcher();
+    ~DirWatcher();
+
+    bool start(const Yast& root);
+    void stop();
+
+    // Moves the names collected so far to changed. Returns false, if some
+    // changes got lost since the last call.
+    bool take(YastVector& changed);
+    bool failed();
+
+protected:
+    DirWatcher(const DirWatcher&) = delete;
+    DirWatcher& operator=(const DirWatcher&) = delete;
+
+    static void watch_proc(void* pctxt);
+    static void on_name(void* pctxt, const os_char* name, size_t len);
+    void set_lost(bool failed);
+
+    OsDirMonitor m_monitor;
+    OsThread m_thread;
+    OsRwLock m_lock;
+    cset<Yast> m_changed;           // guarded by m_lock
+    bool m_overflow;                // guarded by m_lock
+    bool m_failed;                  // guarded by m_lock
+};
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "pch.h"
+#include "glob_set.h"
+#include "platform.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline bool has_wildcard(PCWSTR str, UINT len)
+{
+    for (UINT i = 0; i < len; ++i)
+    {
+        if (str[i] == '*' || str[i] == '?')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline ULONGLONG ext_hash(PCWSTR ext, UINT len)
+{
+    return fnv1a(ext, len * sizeof(WCHAR));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+GlobSet::Kind GlobSet::classify(PCWSTR pat, UINT len)
+{
+    if (!has_wildcard(pat, len))
+    {
+        return GK_EXACT;
+    }
+    if (pat[len - 1] == '*' && !has_wildcard(pat, len - 1))
+    {
+        return GK_PREFIX;
+    }
+    if (pat[0] == '*' && !has_wildcard(pat + 1, len - 1))
+    {
+        // "*.ext" with an extension that has no dot
+        for (UINT i = 2; i < len; ++i)
+        {
+            if (pat[i] == '.')
+            {
+                return GK_SUFFIX;
+            }
+        }
+        return (len > 2 && pat[1] == '.') ? GK_EXTENSION : GK_SUFFIX;
+    }
+    return GK_WILDCARD;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void GlobSet::compile(const Yast& patterns)
+{
+    clear();
+    if (patterns.is_empty())
+    {
+        return;
+    }
+    YastVector list(patterns.split(L"|"));
+    for (Yast& pat : list)
+    {
+        pat.to_lower();
+    }
+    m_default = list[0].str()[0] == '-';
+    m_exclude.resize(list.size());
+
+    // Literals and wildcards are kept with the last pattern first, so that
+    // the first one that matches decides.
+    for (size_t i = list.size(); i-- > 0; )
+    {
+        PCWSTR pat = list[i].str();
+        UINT len = list[i].length();
+        if (pat[0] == '-')
+        {
+            m_exclude[i] = 1;
+            ++pat;
+            --len;
+        }
+        const Glob glob = {
+            static_cast<UINT>(m_chars.size()),
+            len,
+            static_cast<UINT>(i)
+            };
+        m_chars.insert(m_chars.end(), pat, pat + len);
+        m_chars.push_back(0);
+
+        const Kind kind = classify(pat, len);
+        if (kind == GK_EXTENSION)
+        {
+            m_extensions.push_back(glob);
+        }
+        else if (kind == GK_WILDCARD)
+        {
+            m_wildcards.push_back(glob);
+        }
+        else
+        {
+            m_literals.push_back(glob);
+            m_kinds.push_back(kind);
+        }
+    }
+
+    // Of equal extensions only the last one is of any interest, which is
+    // the first one in m_extensions. The table is kept at most half full.
+    if (m_extensions.size())
+    {
+        size_t size = 4;
+        while (size < 2 * m_extensions.size())
+        {
+            size *= 2;
+        }
+        m_ext_table.resize(size);
+        for (UINT e = 0; e < m_extensions.size(); ++e)
+        {
+            const Glob& glob = m_extensions[e];
+            PCWSTR const ext = &m_chars[glob.pos + 2];
+            if (find_extension(ext, glob.len - 2) == nullptr)
+            {
+                size_t slot = static_cast<size_t>(ext_hash(ext, glob.len - 2));
+                while (m_ext_table[slot & (size - 1)])
+                {
+                    ++slot;
+                }
+                m_ext_table[slot & (size - 1)] = e + 1;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void GlobSet::clear()
+{
+    m_chars.clear();
+    m_exclude.clear();
+    m_literals.clear();
+    m_kinds.clear();
+    m_wildcards.clear();
+    m_extensions.clear();
+    m_ext_table.clear();
+    m_default = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const GlobSet::Glob* GlobSet::find_extension(PCWSTR ext, UINT len) const
+{
+    if (m_ext_table.size() == 0)
+    {
+        return nullptr;
+    }
+    const size_t mask = m_ext_table.size() - 1;
+    size_t slot = static_cast<size_t>(ext_hash(ext, len)) & mask;
+    while (m_ext_table[slot])
+    {
+        const Glob& glob = m_extensions[m_ext_table[slot] - 1];
+        if (
+            glob.len - 2 == len &&
+            memcmp(&m_chars[glob.pos + 2], ext, len * sizeof(WCHAR)) == 0
+            )
+        {
+            return &glob;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool GlobSet::matches(PCWSTR name) const
+{
+    if (is_empty())
+    {
+        return true;
+    }
+
+    // Names found in a directory never exceed MAX_PATH characters.
+    WCHAR lower[MAX_PATH];
+    UINT len = 0;
+    while (name[len] && len < MAX_PATH - 1)
+    {
+        lower[len] = name[len];
+        ++len;
+    }
+    lower[len] = 0;
+    os_to_lower(lower, len);
+
+    // index + 1 of the last pattern that matches
+    UINT found = 0;
+    UINT dot = len;
+    while (dot > 0 && lower[dot - 1] != '.')
+    {
+        --dot;
+    }
+    if (dot > 0)
+    {
+        const Glob* ext = find_extension(lower + dot, len - dot);
+        if (ext)
+        {
+            found = ext->index + 1;
+        }
+    }
+
+    for (size_t i = 0; i < m_literals.size(); ++i)
+    {
+        const Glob& glob = m_literals[i];
+        if (glob.index < found)
+        {
+            break;
+        }
+        PCWSTR const pat = &m_chars[glob.pos];
+        bool match = false;
+        switch (m_kinds[i])
+        {
+            case GK_EXACT:
+                match = (
+                    len == glob.len &&
+                    memcmp(lower, pat, len * sizeof(WCHAR)) == 0
+                    );
+                break;
+
+            case GK_PREFIX:
+                // the literal is followed by '*'
+                match = (
+                    len >= glob.len - 1 &&
+                    memcmp(lower, pat, (glob.len - 1) * sizeof(WCHAR)) == 0
+                    );
+                break;
+
+            default:
+                // the literal is preceded by '*'
+                match = (
+                    len >= glob.len - 1 &&
+                    memcmp(
+                        lower + len - (glob.len - 1),
+                        pat + 1,
+                        (glob.len - 1) * sizeof(WCHAR)
+                        ) == 0
+                    );
+                break;
+        }
+        if (match)
+        {
+            found = glob.index + 1;
+            break;
+        }
+    }
+
+    for (const Glob& glob : m_wildcards)
+    {
+        if (glob.index < found)
+        {
+            break;
+        }
+        if (wild_match(lower, &m_chars[glob.pos]))
+        {
+            found = glob.index + 1;
+            break;
+        }
+    }
+    return found ? !m_exclude[found - 1] : m_default;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "rgrep_util.h"
+
+//
+// A list of wildcard patterns for file names, separated by '|', compiled
+// for matching many names. Case is ignored. A pattern that starts with '-'
+// excludes the names it matches, the others include them. The last
+// pattern that matches a name decides. If none matches, a name is included
+// only if the first pattern excludes.
+//
+// Patterns like "*.ext" are looked up by the extension of a name in a hash
+// table. Patterns without wildcards, with a single '*' at their end or with
+// a single '*' at their beginning are compared as literals. Only the
+// remaining ones are matched by wild_match. A name is matched without any
+// allocation.
+//
+class GlobSet
+{
+public:
+    GlobSet() : m_default(true)
+    {
+    }
+
+    void compile(const Yast& patterns);
+    void clear();
+
+    bool is_empty() const
+    {
+        return m_exclude.size() == 0;
+    }
+
+    bool matches(PCWSTR name) const;
+
+private:
+    enum Kind
+    {
+        GK_EXACT,
+        GK_PREFIX,
+        GK_SUFFIX,
+        GK_EXTENSION,
+        GK_WILDCARD
+    };
+
+    // A pattern (without the '-') in m_chars. index is its position in
+    // the list.
+    struct Glob
+    {
+        UINT pos;
+        UINT len;
+        UINT index;
+    };
+
+    static Kind classify(PCWSTR pat, UINT len);
+    const Glob* find_extension(PCWSTR ext, UINT len) const;
+
+    cvector<WCHAR>  m_chars;            // lower case, 0 terminated
+    cvector<BYTE>   m_exclude;          // per index
+    cvector<Glob>   m_literals;         // descending index
+    cvector<UINT>   m_kinds;            // of m_literals
+    cvector<Glob>   m_wildcards;        // descending index
+    cvector<Glob>   m_extensions;
+    cvector<UINT>   m_ext_table;        // position in m_extensions + 1
+    bool            m_default;
+};
+
+////////////////////////////////////////////////////////////////////////////////
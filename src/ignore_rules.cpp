@@ -0,0 +1,439 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "pch.h"
+#include "ignore_rules.h"
+#include "text_file.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Windows ignores case and so does git on Windows by default.
+static inline WCHAR fold(WCHAR c)
+{
+    if (c < 0x80)
+    {
+        return (c >= L'A' && c <= L'Z') ? WCHAR(c + (L'a' - L'A')) : c;
+    }
+    os_to_lower(&c, 1);
+    return c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Matches a path relative to the directory of an ignore file (or just a
+// name) against a pattern of gitignore(5). '*', '?' and '[...]' do not match
+// a backslash, "**/" matches any number of directories and a trailing "**"
+// matches everything. '/' in the pattern matches the backslash of the path
+// and '\' escapes the next character.
+//
+static bool glob_match(PCWSTR pat, PCWSTR str)
+{
+    while (*pat)
+    {
+        switch (*pat)
+        {
+            case L'*':
+                if (pat[1] == L'*')
+                {
+                    pat += 2;
+                    if (*pat == L'/')
+                    {
+                        pat++;
+                        for (;;)
+                        {
+                            if (glob_match(pat, str))
+                            {
+                                return true;
+                            }
+                            while (*str && *str != OS_SEP)
+                            {
+                                str++;
+                            }
+                            if (*str++ == 0)
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                    for (;; str++)
+                    {
+                        if (glob_match(pat, str))
+                        {
+                            return true;
+                        }
+                        if (*str == 0)
+                        {
+                            return false;
+                        }
+                    }
+                }
+                pat++;
+                for (;; str++)
+                {
+                    if (glob_match(pat, str))
+                    {
+                        return true;
+                    }
+                    if (*str == 0 || *str == OS_SEP)
+                    {
+                        return false;
+                    }
+                }
+
+            case L'?':
+                if (*str == 0 || *str == OS_SEP)
+                {
+                    return false;
+                }
+                pat++;
+                str++;
+                break;
+
+            case L'[':
+            {
+                if (*str == 0 || *str == OS_SEP)
+                {
+                    return false;
+                }
+                const WCHAR c = fold(*str);
+                PCWSTR p = pat + 1;
+                const bool negate = (*p == L'!' || *p == L'^');
+                if (negate)
+                {
+                    p++;
+                }
+                // a ']' right behind the '[' is a member of the class
+                PCWSTR const first = p;
+                bool found = false;
+                while (*p && (*p != L']' || p == first))
+                {
+                    WCHAR lo = *p;
+                    WCHAR hi = *p;
+                    if (p[1] == L'-' && p[2] && p[2] != L']')
+                    {
+                        hi = p[2];
+                        p += 3;
+                    }
+                    else
+                    {
+                        p++;
+                    }
+                    found = found || (lo <= c && c <= hi);
+                }
+                if (*p == 0)
+                {
+                    // not a class, but a plain '['
+                    if (*str != L'[')
+                    {
+                        return false;
+                    }
+                    pat++;
+                }
+                else
+                {
+                    if (found == negate)
+                    {
+                        return false;
+                    }
+                    pat = p + 1;
+                }
+                str++;
+                break;
+            }
+
+            case L'/':
+                if (*str != OS_SEP)
+                {
+                    return false;
+                }
+                pat++;
+                str++;
+                break;
+
+            case L'\\':
+                if (pat[1] == 0)
+                {
+                    return false;
+                }
+                pat++;
+                // fall through
+
+            default:
+                if (*pat != fold(*str))
+                {
+                    return false;
+                }
+                pat++;
+                str++;
+                break;
+        }
+    }
+    return *str == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+IgnoreRules::IgnoreRules(const IgnoreRules* parent, PCWSTR dir, UINT dir_len) :
+    m_parent(parent),
+    m_base_len(dir_len)
+{
+    Yast base(dir, dir_len);
+    if (dir_len && dir[dir_len - 1] != OS_SEP)
+    {
+        base += OS_SEP_STR;
+        m_base_len++;
+    }
+    // from the lowest to the highest precedence
+    read(base + L".git" OS_SEP_STR L"info" OS_SEP_STR L"exclude");
+    read(base + L".gitignore");
+    read(base + L".ignore");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IgnoreRules::read(const Yast& path)
+{
+    TextFile file;
+    if (!file.load(path, true, false))
+    {
+        return false;
+    }
+    parse(file.get_content());
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void IgnoreRules::parse(const Yast& text)
+{
+    PCWSTR pos = text.str();
+    PCWSTR const end = pos + text.length();
+    while (pos < end)
+    {
+        PCWSTR line = pos;
+        while (pos < end && *pos != L'\n')
+        {
+            pos++;
+        }
+        PCWSTR line_end = pos++;
+
+        // Trailing blanks are removed, unless they are escaped.
+        while (
+            line_end > line &&
+            (line_end[-1] == L'\r' || line_end[-1] == L' ' ||
+             line_end[-1] == L'\t') &&
+            !(line_end - 1 > line && line_end[-2] == L'\\')
+            )
+        {
+            line_end--;
+        }
+        if (line == line_end || *line == L'#')
+        {
+            continue;
+        }
+
+        Rule rule;
+        rule.negated = (*line == L'!');
+        if (rule.negated)
+        {
+            line++;
+        }
+        rule.dir_only = (line_end > line && line_end[-1] == L'/');
+        if (rule.dir_only)
+        {
+            line_end--;
+        }
+        rule.anchored = false;
+        for (PCWSTR p = line; p < line_end; p++)
+        {
+            if (*p == L'/')
+            {
+                rule.anchored = true;
+                break;
+            }
+        }
+        if (line < line_end && *line == L'/')
+        {
+            line++;
+        }
+        if (line == line_end)
+        {
+            continue;
+        }
+        rule.pattern = Yast(line, static_cast<UINT>(line_end - line));
+        rule.pattern.to_lower();
+        m_rules.push_back(rule);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Looks for the last rule that matches. Returns false if none does.
+bool IgnoreRules::decide(
+    PCWSTR path,
+    PCWSTR name,
+    bool is_dir,
+    bool& ignored
+    ) const
+{
+    for (size_t i = m_rules.size(); i-- > 0; )
+    {
+        const Rule& rule = m_rules[i];
+        if (rule.dir_only && !is_dir)
+        {
+            continue;
+        }
+        PCWSTR const str = rule.anchored ? path + m_base_len : name;
+        if (glob_match(rule.pattern.str(), str))
+        {
+            ignored = !rule.negated;
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IgnoreRules::is_ignored(
+    const IgnoreRules* scope,
+    PCWSTR path,
+    PCWSTR name,
+    bool is_dir
+    )
+{
+    if (is_dir && os_strcmpi(name, L".git") == 0)
+    {
+        return true;
+    }
+    for (const IgnoreRules* rules = scope; rules; rules = rules->m_parent)
+    {
+        bool ignored;
+        if (rules->decide(path, name, is_dir, ignored))
+        {
+            return ignored;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+IgnoreTree::IgnoreTree()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IgnoreTree::~IgnoreTree()
+{
+    clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void IgnoreTree::clear()
+{
+    for (IgnoreRules* rules : m_sets)
+    {
+        delete rules;
+    }
+    m_sets.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const IgnoreRules* IgnoreTree::enter(
+    const IgnoreRules* parent,
+    PCWSTR dir,
+    UINT dir_len
+    )
+{
+    IgnoreRules* rules = new IgnoreRules(parent, dir, dir_len);
+    if (!rules->has_rules())
+    {
+        delete rules;
+        return parent;
+    }
+    m_lock.lock();
+    m_sets.push_back(rules);
+    m_lock.unlock();
+    return rules;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const IgnoreRules* IgnoreTree::enter_parents(const Yast& root)
+{
+    Yast dir(root);
+    if (dir.is_empty())
+    {
+        return nullptr;
+    }
+    if (dir.str()[dir.length() - 1] != OS_SEP)
+    {
+        dir += OS_SEP_STR;
+    }
+
+    // The lengths of the parents of root, that belong to its repository,
+    // from the innermost to the top.
+    cvector<UINT> parents;
+    UINT len = dir.length();
+    OsDirEntry git;
+    while (!os_get_entry(Yast(dir.str(), len) + L".git", git))
+    {
+        // cut the last directory, but keep the separator in front of it
+        UINT up = len - 1;
+        while (up > 0 && dir.str()[up - 1] != OS_SEP)
+        {
+            up--;
+        }
+        if (up == 0)
+        {
+            // not inside a repository
+            parents.clear();
+            break;
+        }
+        len = up;
+        parents.push_back(len);
+    }
+
+    const IgnoreRules* scope = nullptr;
+    for (size_t i = parents.size(); i-- > 0; )
+    {
+        scope = enter(scope, dir.str(), parents[i]);
+    }
+    return scope;
+}
+
+////////////////////////////////////////////////////////////////////////////////
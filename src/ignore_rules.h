@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "rgrep_util.h"
+#include "platform.h"
+
+//
+// The rules of the ignore files of a single directory. git reads
+// .gitignore files and .git\info\exclude, other tools additionally read
+// .ignore files. The latter are read last, so their rules take precedence.
+// Every set refers to the set of the nearest directory above that has
+// ignore files, so the sets form a tree that mirrors the directories.
+//
+class IgnoreRules
+{
+public:
+    IgnoreRules(const IgnoreRules* parent, PCWSTR dir, UINT dir_len);
+
+    bool has_rules() const
+    {
+        return m_rules.size() != 0;
+    }
+
+    // Whether the entry with the absolute path and the name (its last part)
+    // is ignored by scope or one of its parents. The deepest rule that
+    // matches decides. The directory .git is always ignored. scope may be
+    // null.
+    static bool is_ignored(
+        const IgnoreRules* scope,
+        PCWSTR path,
+        PCWSTR name,
+        bool is_dir
+        );
+
+private:
+    IgnoreRules(const IgnoreRules&) = delete;
+    IgnoreRules& operator=(const IgnoreRules&) = delete;
+
+    // A pattern without '!', leading '/' and trailing '/', in lower case.
+    // If it contained a '/' it is matched against the path relative to the
+    // directory of the set, otherwise against the name of an entry.
+    struct Rule
+    {
+        Yast pattern;
+        bool negated;
+        bool dir_only;
+        bool anchored;
+    };
+
+    bool read(const Yast& path);
+    void parse(const Yast& text);
+    bool decide(PCWSTR path, PCWSTR name, bool is_dir, bool& ignored) const;
+
+    const IgnoreRules* m_parent;
+    UINT m_base_len;            // length of the directory with backslash
+    cvector<Rule> m_rules;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Owns the IgnoreRules that are read during a search. The sets are never
+// changed after they have been added, so they can be used by several
+// threads without locking. Only adding a set is serialized.
+//
+class IgnoreTree
+{
+public:
+    IgnoreTree();
+    ~IgnoreTree();
+    void clear();
+
+    // Reads the ignore files of the directories above root up to the top of
+    // the repository that contains root. Returns null if root is not inside
+    // a repository or if there are no ignore files.
+    const IgnoreRules* enter_parents(const Yast& root);
+
+    // Reads the ignore files of dir, which may or may not end with a
+    // backslash. Returns parent, if there are none, so a directory without
+    // ignore files costs no memory.
+    const IgnoreRules* enter(
+        const IgnoreRules* parent,
+        PCWSTR dir,
+        UINT dir_len
+        );
+
+private:
+    IgnoreTree(const IgnoreTree&) = delete;
+    IgnoreTree& operator=(const IgnoreTree&) = delete;
+
+    OsMutex m_lock;
+    cvector<IgnoreRules*> m_sets;
+};
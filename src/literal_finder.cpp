@@ -0,0 +1,773 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+#include "literal_finder.h"
+#include "platform.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LF_USE_SSE2 1
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+static inline C to_lower(C c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<C>(c + ('a' - 'A')) : c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline UINT code_unit(char c)
+{
+    return static_cast<BYTE>(c);
+}
+
+static inline UINT code_unit(WCHAR c)
+{
+    return c;
+}
+
+// Only ASCII letters can be compared caselessly without PCRE. 'k' and 's'
+// are special, since PCRE lets them match KELVIN SIGN and LATIN SMALL
+// LETTER LONG S too.
+template <class C>
+static inline bool folds_as_ascii(C c)
+{
+    const C lower = to_lower(c);
+    return code_unit(c) < 0x80 && lower != 'k' && lower != 's';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef LF_USE_SSE2
+
+static inline __m128i splat(char c)
+{
+    return _mm_set1_epi8(c);
+}
+
+static inline __m128i splat(WCHAR c)
+{
+    return _mm_set1_epi16(static_cast<short>(c));
+}
+
+static inline __m128i equal(__m128i a, __m128i b, char)
+{
+    return _mm_cmpeq_epi8(a, b);
+}
+
+static inline __m128i equal(__m128i a, __m128i b, WCHAR)
+{
+    return _mm_cmpeq_epi16(a, b);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+static inline bool is_word(C c)
+{
+    return (
+        (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') ||
+        c == '_'
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+static inline bool at_boundary(const C* subject, size_t len, size_t pos)
+{
+    const bool word_before = pos > 0 && is_word(subject[pos - 1]);
+    const bool word_after = pos < len && is_word(subject[pos]);
+    return word_before != word_after;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool LiteralFinder<C>::init(
+    const C* literal,
+    size_t len,
+    bool ignore_case,
+    bool whole
+    )
+{
+    m_literal.clear();
+    m_ignore_case = ignore_case;
+    m_whole_words = whole;
+    for (size_t i = 0; i < len; ++i)
+    {
+        // Only PCRE knows how to fold non-ASCII characters.
+        if (ignore_case && !folds_as_ascii(literal[i]))
+        {
+            m_literal.clear();
+            return false;
+        }
+        m_literal.push_back(ignore_case ? to_lower(literal[i]) : literal[i]);
+    }
+    return len != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool LiteralFinder<C>::verify(const C* candidate) const
+{
+    // First and last character have already been compared.
+    const size_t last = m_literal.size() - 1;
+    const C* const lit = &m_literal[0];
+    if (m_ignore_case)
+    {
+        for (size_t i = 1; i < last; ++i)
+        {
+            if (to_lower(candidate[i]) != lit[i])
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 1; i < last; ++i)
+        {
+            if (candidate[i] != lit[i])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool LiteralFinder<C>::is_boundary(
+    const C* subject,
+    size_t len,
+    size_t pos
+    ) const
+{
+    return at_boundary(subject, len, pos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool LiteralFinder<C>::find(
+    const C* subject,
+    size_t len,
+    size_t offset,
+    range& found
+    ) const
+{
+    const size_t n = m_literal.size();
+    if (n == 0 || len < n || offset > len - n)
+    {
+        return false;
+    }
+    const C first = m_literal[0];
+    const C last = m_literal[n - 1];
+    const size_t max_pos = len - n;
+    size_t pos = offset;
+
+#ifdef LF_USE_SSE2
+    // Compare the first and the last character of the literal with
+    // LANES characters of the subject at once. When ignoring case, ORing
+    // with 0x20 maps upper case ASCII letters to lower case ones (and
+    // some other characters to something else, which is sorted out by
+    // verify).
+    const size_t LANES = sizeof(__m128i) / sizeof(C);
+    const bool fold_first = m_ignore_case && first >= 'a' && first <= 'z';
+    const bool fold_last = m_ignore_case && last >= 'a' && last <= 'z';
+    const __m128i or_first = splat(static_cast<C>(fold_first ? 0x20 : 0));
+    const __m128i or_last = splat(static_cast<C>(fold_last ? 0x20 : 0));
+    const __m128i v_first = splat(first);
+    const __m128i v_last = splat(last);
+
+    while (pos + LANES - 1 <= max_pos)
+    {
+        const __m128i block_first = _mm_or_si128(
+            _mm_loadu_si128(p2p<const __m128i*>(subject + pos)),
+            or_first
+            );
+        const __m128i block_last = _mm_or_si128(
+            _mm_loadu_si128(p2p<const __m128i*>(subject + pos + n - 1)),
+            or_last
+            );
+        const __m128i eq_first = equal(block_first, v_first, first);
+        const __m128i eq_last = equal(block_last, v_last, last);
+        unsigned long mask = static_cast<unsigned long>(
+            _mm_movemask_epi8(_mm_and_si128(eq_first, eq_last))
+            );
+        while (mask)
+        {
+            const unsigned bit = os_lowest_bit(mask);
+            const size_t cand = pos + bit / sizeof(C);
+            if (
+                verify(subject + cand) &&
+                (
+                    !m_whole_words || (
+                        is_boundary(subject, len, cand) &&
+                        is_boundary(subject, len, cand + n)
+                        )
+                    )
+                )
+            {
+                found.begin = cand;
+                found.end = cand + n;
+                return true;
+            }
+            // movemask yields one bit per byte, so clear all bits that
+            // belong to this character.
+            mask &= ~(((1UL << sizeof(C)) - 1) << bit);
+        }
+        pos += LANES;
+    }
+#endif
+
+    for (; pos <= max_pos; ++pos)
+    {
+        const C* const cand = subject + pos;
+        const bool candidate = m_ignore_case ? (
+            to_lower(cand[0]) == first &&
+            to_lower(cand[n - 1]) == last
+            ) : (
+            cand[0] == first &&
+            cand[n - 1] == last
+            );
+        if (
+            candidate &&
+            verify(cand) &&
+            (
+                !m_whole_words || (
+                    is_boundary(subject, len, pos) &&
+                    is_boundary(subject, len, pos + n)
+                    )
+                )
+            )
+        {
+            found.begin = pos;
+            found.end = pos + n;
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Folds a code unit to lower case. Beyond ASCII, only UTF-16 code units can
+// be folded (by Windows), since a single byte might be just a part of a
+// UTF-8 character.
+
+static inline bool fold(char& c)
+{
+    if (code_unit(c) >= 0x80)
+    {
+        return false;
+    }
+    c = to_lower(c);
+    return true;
+}
+
+static inline bool fold(WCHAR& c)
+{
+    if (c < 0x80)
+    {
+        c = to_lower(c);
+    }
+    else
+    {
+        os_to_lower(&c, 1);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+void MultiLiteralFinder<C>::add(const C* literal, size_t len)
+{
+    m_units.insert(m_units.end(), literal, literal + len);
+    m_lengths.push_back(static_cast<UINT>(len));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool MultiLiteralFinder<C>::build(bool ignore_case, bool whole)
+{
+    m_ignore_case = ignore_case;
+    m_whole_words = whole;
+    m_next.clear();
+    m_match.clear();
+    m_suffix.clear();
+    m_starts.clear();
+    m_max_len = 0;
+
+    // Every code unit, that occurs in a literal, gets a class of its own.
+    // When ignoring case, the literals are folded and all code units that
+    // fold to the same one share its class. So the automaton does not
+    // have to care about case at all.
+    const size_t NUM_UNITS = size_t(1) << (8 * sizeof(C));
+    m_class.clear();
+    m_class.resize(NUM_UNITS);
+    UINT num_classes = 1;
+    for (C& c : m_units)
+    {
+        if (ignore_case && !fold(c))
+        {
+            return false;
+        }
+        USHORT& cls = m_class[code_unit(c)];
+        if (cls == 0)
+        {
+            if (num_classes > 0xffff)
+            {
+                return false;
+            }
+            cls = static_cast<USHORT>(num_classes++);
+        }
+    }
+    if (ignore_case)
+    {
+        for (size_t u = 0; u < NUM_UNITS; ++u)
+        {
+            C c = static_cast<C>(u);
+            if (fold(c))
+            {
+                m_class[u] = m_class[code_unit(c)];
+            }
+        }
+    }
+
+    // Build the trie. State 0 is the root, so 0 also marks a missing
+    // transition for now.
+    m_num_classes = num_classes;
+    cvector<UINT> next(num_classes);
+    m_match.push_back(0);
+    const C* lit = m_units.size() ? &m_units[0] : nullptr;
+    for (UINT idx = 0; idx < m_lengths.size(); ++idx)
+    {
+        const size_t len = m_lengths[idx];
+        if (len == 0)
+        {
+            return false;
+        }
+        UINT state = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            const size_t t = state * num_classes + m_class[code_unit(lit[i])];
+            if (next[t] == 0)
+            {
+                const UINT new_state = static_cast<UINT>(m_match.size());
+                if ((size_t(new_state) + 1) * num_classes > MAX_TRANSITIONS)
+                {
+                    m_match.clear();
+                    return false;
+                }
+                next[t] = new_state;
+                next.resize((size_t(new_state) + 1) * num_classes);
+                m_match.push_back(0);
+            }
+            state = next[t];
+        }
+        if (m_match[state] == 0)
+        {
+            // Of duplicate literals the first one is reported.
+            m_match[state] = idx + 1;
+        }
+        m_max_len = (len > m_max_len) ? len : m_max_len;
+        lit += len;
+    }
+    if (m_lengths.size() == 0)
+    {
+        m_match.clear();
+        return false;
+    }
+
+    // Turn the trie into a DFA by following the failure links breadth
+    // first. Then the failure link of a state and its transitions are
+    // complete, before they are needed for a deeper state.
+    const size_t num_states = m_match.size();
+    cvector<UINT> failure(num_states);
+    cvector<UINT> queue;
+    queue.reserve(num_states);
+    m_suffix.resize(num_states);
+    for (UINT cls = 0; cls < num_classes; ++cls)
+    {
+        if (next[cls] != 0)
+        {
+            queue.push_back(next[cls]);
+        }
+    }
+    for (size_t q = 0; q < queue.size(); ++q)
+    {
+        const UINT state = queue[q];
+        const UINT fail = failure[state];
+        m_suffix[state] = m_match[fail] ? fail : m_suffix[fail];
+        UINT* const row = &next[state * num_classes];
+        const UINT* const fail_row = &next[fail * num_classes];
+        for (UINT cls = 0; cls < num_classes; ++cls)
+        {
+            if (row[cls] != 0)
+            {
+                failure[row[cls]] = fail_row[cls];
+                queue.push_back(row[cls]);
+            }
+            else
+            {
+                row[cls] = fail_row[cls];
+            }
+        }
+    }
+
+    // Collect the code units that leave the root, if there are only a few.
+    size_t num_starts = 0;
+    for (size_t u = 0; u < NUM_UNITS; ++u)
+    {
+        if (next[m_class[u]] != 0 && num_starts++ < MAX_STARTS)
+        {
+            m_starts.push_back(static_cast<C>(u));
+        }
+    }
+    if (num_starts > MAX_STARTS)
+    {
+        m_starts.clear();
+    }
+
+    m_next.swap(next);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+size_t MultiLiteralFinder<C>::skip_to_start(
+    const C* subject,
+    size_t len,
+    size_t pos
+    ) const
+{
+#ifdef LF_USE_SSE2
+    // This resembles the Teddy algorithm, but simply compares with the
+    // code units that start a literal instead of shuffling nibble masks
+    // (which would need SSSE3).
+    const size_t num_starts = m_starts.size();
+    if (num_starts != 0)
+    {
+        const size_t LANES = sizeof(__m128i) / sizeof(C);
+        const C first = m_starts[0];
+        const __m128i v0 = splat(first);
+        const __m128i v1 = splat(m_starts[(num_starts > 1) ? 1 : 0]);
+        const __m128i v2 = splat(m_starts[num_starts - 1]);
+        for (; pos + LANES <= len; pos += LANES)
+        {
+            const __m128i block = _mm_loadu_si128(
+                p2p<const __m128i*>(subject + pos)
+                );
+            const __m128i eq = _mm_or_si128(
+                _mm_or_si128(
+                    equal(block, v0, first),
+                    equal(block, v1, first)
+                    ),
+                equal(block, v2, first)
+                );
+            const unsigned long mask = static_cast<unsigned long>(
+                _mm_movemask_epi8(eq)
+                );
+            if (mask)
+            {
+                const unsigned bit = os_lowest_bit(mask);
+                return pos + bit / sizeof(C);
+            }
+        }
+    }
+#endif
+
+    const UINT* const root = &m_next[0];
+    while (pos < len && root[m_class[code_unit(subject[pos])]] == 0)
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+bool MultiLiteralFinder<C>::find(
+    const C* subject,
+    size_t len,
+    size_t offset,
+    range& found
+    ) const
+{
+    if (!is_valid())
+    {
+        return false;
+    }
+    const UINT* const next = &m_next[0];
+    const USHORT* const cls = &m_class[0];
+    const UINT num_classes = m_num_classes;
+    bool have_match = false;
+    UINT state = 0;
+    for (size_t pos = offset; pos < len; ++pos)
+    {
+        if (state == 0)
+        {
+            // No literal has been started, so the match we have cannot
+            // become any longer or be preceded by another one.
+            if (have_match)
+            {
+                break;
+            }
+            pos = skip_to_start(subject, len, pos);
+            if (pos == len)
+            {
+                break;
+            }
+        }
+        state = next[state * num_classes + cls[code_unit(subject[pos])]];
+
+        // The literals ending here, from the longest to the shortest
+        for (
+            UINT s = m_match[state] ? state : m_suffix[state];
+            s != 0;
+            s = m_suffix[s]
+            )
+        {
+            const UINT idx = m_match[s] - 1;
+            const size_t begin = pos + 1 - m_lengths[idx];
+            if (
+                (!have_match || begin <= found.begin) &&
+                (
+                    !m_whole_words || (
+                        at_boundary(subject, len, begin) &&
+                        at_boundary(subject, len, pos + 1)
+                        )
+                    )
+                )
+            {
+                found.begin = begin;
+                found.end = pos + 1;
+                found.pattern = idx;
+                have_match = true;
+            }
+        }
+        if (have_match && pos + 1 >= found.begin + m_max_len)
+        {
+            break;
+        }
+    }
+    return have_match;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool BinaryFinder::init(
+    PCWSTR literal,
+    size_t len,
+    bool ignore_case,
+    bool whole
+    )
+{
+    m_narrow.clear();
+    m_wide.clear();
+    m_ignore_case = ignore_case;
+    m_whole_words = whole;
+    bool narrow = true;
+    for (size_t i = 0; i < len; ++i)
+    {
+        WCHAR c = literal[i];
+        if (ignore_case && !folds_as_ascii(c))
+        {
+            m_wide.clear();
+            return false;
+        }
+        c = ignore_case ? to_lower(c) : c;
+        narrow = narrow && c <= 0xff;
+        m_narrow.push_back(static_cast<BYTE>(c));
+        m_wide.push_back(static_cast<BYTE>(c & 0xff));
+        m_wide.push_back(static_cast<BYTE>(c >> 8));
+    }
+    if (!narrow)
+    {
+        m_narrow.clear();
+    }
+    return len != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool BinaryFinder::matches(
+    const cvector<BYTE>& form,
+    const BYTE* subject,
+    size_t len,
+    size_t pos
+    ) const
+{
+    const size_t n = form.size();
+    if (n == 0 || len - pos < n)
+    {
+        return false;
+    }
+    const BYTE* const cand = subject + pos;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const BYTE c = m_ignore_case ? to_lower(cand[i]) : cand[i];
+        if (c != form[i])
+        {
+            return false;
+        }
+    }
+    return (
+        &form != &m_narrow ||
+        !m_whole_words || (
+            at_boundary(subject, len, pos) &&
+            at_boundary(subject, len, pos + n)
+            )
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool BinaryFinder::find(
+    const BYTE* subject,
+    size_t len,
+    size_t offset,
+    range& found
+    ) const
+{
+    if (!is_valid())
+    {
+        return false;
+    }
+    size_t pos = offset;
+
+#ifdef LF_USE_SSE2
+    // The first two bytes of each form are compared with LANES bytes of
+    // the subject at once. A single byte form only has one byte to compare.
+    // Case is ignored as in LiteralFinder.
+    const size_t LANES = sizeof(__m128i);
+    const bool narrow = m_narrow.size() != 0;
+    const BYTE n0 = narrow ? m_narrow[0] : 0;
+    const BYTE n1 = (m_narrow.size() > 1) ? m_narrow[1] : 0;
+    const BYTE w0 = m_wide[0];
+    const BYTE w1 = m_wide[1];
+    const bool fold0 = m_ignore_case && n0 >= 'a' && n0 <= 'z';
+    const bool fold1 = m_ignore_case && n1 >= 'a' && n1 <= 'z';
+    const __m128i or0 = _mm_set1_epi8(fold0 ? 0x20 : 0);
+    const __m128i or1 = _mm_set1_epi8(fold1 ? 0x20 : 0);
+    const __m128i v_n0 = _mm_set1_epi8(static_cast<char>(n0));
+    const __m128i v_n1 = _mm_set1_epi8(static_cast<char>(n1));
+    const __m128i v_w0 = _mm_set1_epi8(static_cast<char>(w0));
+    const __m128i v_w1 = _mm_set1_epi8(static_cast<char>(w1));
+    const __m128i any1 = _mm_set1_epi8(
+        static_cast<char>((m_narrow.size() == 1) ? 0xff : 0)
+        );
+    const __m128i none = _mm_set1_epi8(static_cast<char>(narrow ? 0xff : 0));
+
+    while (pos + LANES + 1 <= len)
+    {
+        const __m128i b0 = _mm_or_si128(
+            _mm_loadu_si128(p2p<const __m128i*>(subject + pos)),
+            or0
+            );
+        const __m128i raw1 = _mm_loadu_si128(
+            p2p<const __m128i*>(subject + pos + 1)
+            );
+        const __m128i b1 = _mm_or_si128(raw1, or1);
+
+        // w0 is folded like n0, since both are the same for ASCII. The
+        // second byte of the wide form is zero then.
+        const __m128i eq_narrow = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(b0, v_n0), none),
+            _mm_or_si128(_mm_cmpeq_epi8(b1, v_n1), any1)
+            );
+        const __m128i eq_wide = _mm_and_si128(
+            _mm_cmpeq_epi8(b0, v_w0),
+            _mm_cmpeq_epi8(raw1, v_w1)
+            );
+        unsigned long mask = static_cast<unsigned long>(
+            _mm_movemask_epi8(_mm_or_si128(eq_narrow, eq_wide))
+            );
+        while (mask)
+        {
+            const unsigned bit = os_lowest_bit(mask);
+            const size_t cand = pos + bit;
+            if (matches(m_narrow, subject, len, cand))
+            {
+                found.begin = cand;
+                found.end = cand + m_narrow.size();
+                return true;
+            }
+            if (matches(m_wide, subject, len, cand))
+            {
+                found.begin = cand;
+                found.end = cand + m_wide.size();
+                return true;
+            }
+            mask &= mask - 1;
+        }
+        pos += LANES;
+    }
+#endif
+
+    for (; pos < len; ++pos)
+    {
+        if (matches(m_narrow, subject, len, pos))
+        {
+            found.begin = pos;
+            found.end = pos + m_narrow.size();
+            return true;
+        }
+        if (matches(m_wide, subject, len, pos))
+        {
+            found.begin = pos;
+            found.end = pos + m_wide.size();
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template class LiteralFinder<char>;
+template class LiteralFinder<WCHAR>;
+template class MultiLiteralFinder<char>;
+template class MultiLiteralFinder<WCHAR>;
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "rgrep_util.h"
+
+//
+// Searches for a literal string without the help of PCRE. Candidates are
+// located by comparing the first and the last character of the literal
+// with blocks of the subject (using SSE2 where available) and are then
+// verified. Case insensitivity is restricted to ASCII letters. C is
+// either char (UTF-8 or ANSI) or WCHAR (UTF-16).
+//
+template <class C>
+class LiteralFinder
+{
+public:
+
+    LiteralFinder() : m_ignore_case(false), m_whole_words(false)
+    {
+    }
+
+    // Returns false, if the literal cannot be handled (it is empty or
+    // ignore_case is requested for a literal containing non-ASCII
+    // characters, 'k' or 's').
+    bool init(const C* literal, size_t len, bool ignore_case, bool whole);
+
+    bool is_valid() const
+    {
+        return m_literal.size() != 0;
+    }
+
+    // Returns the first occurrence at or behind offset. Like '\b' in PCRE,
+    // WHOLE_WORDS treats only ASCII letters, digits and '_' as word
+    // characters.
+    bool find(
+        const C* subject,
+        size_t len,
+        size_t offset,
+        range& found
+        ) const;
+
+private:
+
+    bool verify(const C* candidate) const;
+    bool is_boundary(const C* subject, size_t len, size_t pos) const;
+
+    cvector<C> m_literal;               // lower case if m_ignore_case
+    bool m_ignore_case;
+    bool m_whole_words;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Searches for any of a list of literals at once with an Aho-Corasick
+// automaton, whose transitions are stored as a table over classes of code
+// units. Of the literals that match, the leftmost one is reported and of
+// those starting there the longest. As long as no literal has been
+// started, the subject is skipped until one of the few code units, that
+// may start a literal, shows up (using SSE2 where available).
+//
+template <class C>
+class MultiLiteralFinder
+{
+public:
+
+    MultiLiteralFinder() :
+        m_num_classes(0),
+        m_max_len(0),
+        m_ignore_case(false),
+        m_whole_words(false)
+    {
+    }
+
+    // Adds a literal. Its index is the number of literals added before.
+    void add(const C* literal, size_t len);
+
+    // Builds the automaton for all added literals. Returns false, if it
+    // cannot be built (there is no or an empty literal, it would become
+    // too large, or ignore_case is requested for 8 bit literals
+    // containing non-ASCII characters). UTF-16 literals are folded by
+    // Windows.
+    bool build(bool ignore_case, bool whole);
+
+    bool is_valid() const
+    {
+        return m_next.size() != 0;
+    }
+
+    // Returns the first match at or behind offset. found.pattern is set to
+    // the index of the literal.
+    bool find(
+        const C* subject,
+        size_t len,
+        size_t offset,
+        range& found
+        ) const;
+
+private:
+
+    size_t skip_to_start(const C* subject, size_t len, size_t pos) const;
+
+    // At most that many code units are compared with SSE2, when looking
+    // for the start of a literal.
+    static const size_t MAX_STARTS = 3;
+
+    // Limits the size of the transition table to 64 MB.
+    static const size_t MAX_TRANSITIONS = 16 * 1024 * 1024;
+
+    cvector<C> m_units;                 // all literals one after the other
+    cvector<UINT> m_lengths;            // length of each literal
+    cvector<USHORT> m_class;            // code unit -> class (0: none)
+    cvector<UINT> m_next;               // state * m_num_classes + class
+    cvector<UINT> m_match;              // state -> 1 + literal, 0: none
+    cvector<UINT> m_suffix;             // next state with a match on the
+                                        // failure chain
+    cvector<C> m_starts;                // empty, if more than MAX_STARTS
+    UINT m_num_classes;
+    size_t m_max_len;
+    bool m_ignore_case;
+    bool m_whole_words;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Searches binary data for a literal in two forms at once: with every
+// character as a single byte (like ANSI text in Latin-1) and in UTF-16LE.
+// Candidates for both forms are located in a single pass by comparing their
+// first two bytes with blocks of the subject (using SSE2 where available).
+// As for LiteralFinder, case insensitivity is restricted to ASCII. Whole
+// words are only checked for the single byte form.
+//
+class BinaryFinder
+{
+public:
+
+    BinaryFinder() : m_ignore_case(false), m_whole_words(false)
+    {
+    }
+
+    // Returns false, if the literal cannot be handled (see LiteralFinder).
+    bool init(PCWSTR literal, size_t len, bool ignore_case, bool whole);
+
+    bool is_valid() const
+    {
+        return m_wide.size() != 0;
+    }
+
+    // Returns the first occurrence of either form at or behind offset.
+    // The positions are byte offsets.
+    bool find(
+        const BYTE* subject,
+        size_t len,
+        size_t offset,
+        range& found
+        ) const;
+
+private:
+
+    bool matches(
+        const cvector<BYTE>& form,
+        const BYTE* subject,
+        size_t len,
+        size_t pos
+        ) const;
+
+    cvector<BYTE> m_narrow;             // empty, if a character is > 0xff
+    cvector<BYTE> m_wide;
+    bool m_ignore_case;
+    bool m_whole_words;
+};
@@ -35,9 +35,11 @@
 //#define ROMATO_ACTIVATE_TRACES 1
 
 #include "romato.h"
+#ifdef _WIN32
 #include "base_wnd.h"
 #include <shlwapi.h>
 #include <objbase.h>
 #include <shldisp.h>
 #include <shobjidl.h>
 #include <shlguid.h>
+#endif
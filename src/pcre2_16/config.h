@@ -304,6 +304,7 @@ sure both macros are undefined; an emulation function will then be used. */
 #endif
 
 /* Define to any value to enable support for Just-In-Time compiling. */
+/* roma: bld.py defines SUPPORT_JIT. */
 /* #undef SUPPORT_JIT */
 
 /* Define to any value to allow pcre2grep to be linked with libbz2, so that it
@@ -336,7 +337,9 @@ sure both macros are undefined; an emulation function will then be used. */
 /* #undef SUPPORT_PCRE2_32 */
 
 /* Define to any value to enable the 8 bit PCRE2 library. */
-/* #undef SUPPORT_PCRE2_8 */
+#ifndef SUPPORT_PCRE2_8
+#define SUPPORT_PCRE2_8 1
+#endif
 
 /* Define to any value to enable support for Unicode and UTF encoding. This
    will work even in an EBCDIC environment, but it is incompatible with the
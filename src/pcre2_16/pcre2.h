@@ -42,9 +42,12 @@ POSSIBILITY OF SUCH DAMAGE.
 // roma: This must match PCRE2_STATIC in config.h
 #define PCRE2_STATIC 1
 
-// roma: This must match SUPPORT_PCRE2_16 or SUPPORT_PCRE2_32 in config.h
-#undef PCRE2_CODE_UNIT_WIDTH
+// roma: The 16 bit library is the default. bld.py compiles the sources a
+// second time with PCRE2_CODE_UNIT_WIDTH=8 to get the 8 bit library too.
+// This must match SUPPORT_PCRE2_8 and SUPPORT_PCRE2_16 in config.h
+#ifndef PCRE2_CODE_UNIT_WIDTH
 #define PCRE2_CODE_UNIT_WIDTH 16
+#endif
 
 
 /* The current PCRE version information. */
@@ -352,6 +355,8 @@ numbers must not be changed. */
 typedef uint8_t  PCRE2_UCHAR8;
 #if defined(_MSC_VER) && defined(_NATIVE_WCHAR_T_DEFINED)
 typedef wchar_t PCRE2_UCHAR16;
+#elif defined(__cplusplus) && defined(__WCHAR_MAX__) && __WCHAR_MAX__ == 0xffff
+typedef wchar_t PCRE2_UCHAR16;
 #else
 typedef uint16_t PCRE2_UCHAR16;
 #endif
@@ -1,11 +1,21 @@
 
+#ifdef _WIN32
 extern int ispunct(int c)
 {
     return !c;
 }
+#endif
 
+#ifndef SUPPORT_JIT
 extern void _pcre2_jit_free_16(void *a, void *b)
 {
     (void)a;
     (void)b;
 }
+
+extern void _pcre2_jit_free_8(void *a, void *b)
+{
+    (void)a;
+    (void)b;
+}
+#endif
@@ -0,0 +1,625 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+//
+// The parts of the operating system, that the search needs: threads,
+// locks, atomic counters, files, text, the standard output and a few facts
+// about the machine. Windows is served by platform_win.cpp, everything else
+// by platform_posix.cpp. Only the C library and the system headers are
+// used, so that the layer can be tested on its own (see
+// test\test_platform.cpp).
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <dirent.h>
+#endif
+
+// Paths and text are UTF-16 on every system. Elsewhere than on Windows
+// paths are passed to the system as UTF-8 and wchar_t has to be as wide as
+// on Windows, i.e. everything is built with -fshort-wchar. The functions
+// of the C library, that take wchar_t, cannot be used then.
+using os_char = wchar_t;
+#define OS_TEXT(s) L##s
+#ifndef _WIN32
+static_assert(sizeof(wchar_t) == 2, "wchar_t has to be 16 bits wide");
+#endif
+
+// Separates the names in a path.
+#ifdef _WIN32
+#define OS_SEP_STR L"\\"
+#else
+#define OS_SEP_STR L"/"
+#endif
+const os_char OS_SEP = OS_SEP_STR[0];
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Atomic operations on counters and flags, that are shared by threads.
+// Each one is a full barrier. The new value is returned by increment and
+// decrement, the old one by exchange.
+
+#ifdef _WIN32
+
+inline long os_increment(volatile long* p)
+{
+    return InterlockedIncrement(p);
+}
+
+inline long os_decrement(volatile long* p)
+{
+    return InterlockedDecrement(p);
+}
+
+inline long os_exchange(volatile long* p, long value)
+{
+    return InterlockedExchange(p, value);
+}
+
+inline void os_barrier()
+{
+    MemoryBarrier();
+}
+
+#else
+
+inline long os_increment(volatile long* p)
+{
+    return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST);
+}
+
+inline long os_decrement(volatile long* p)
+{
+    return __atomic_sub_fetch(p, 1, __ATOMIC_SEQ_CST);
+}
+
+inline long os_exchange(volatile long* p, long value)
+{
+    return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+inline void os_barrier()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+void os_sleep(unsigned ms);
+
+// Number of logical processors.
+unsigned os_num_cpus();
+
+// Milliseconds since some point in the past. Wraps around after 49 days.
+uint32_t os_ticks();
+
+// Physical memory that is available right now, in bytes.
+uint64_t os_avail_memory();
+
+// Memory that has been committed for this process alone, in bytes. On
+// Linux, which does not account for that per process, this is the size of
+// the data segments and stacks. 0 if it is not known.
+uint64_t os_private_memory();
+
+// Index of the lowest bit, that is set in mask. mask must not be 0.
+inline unsigned os_lowest_bit(uint32_t mask)
+{
+#ifdef _WIN32
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return bit;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Code pages have the numbers of Windows. Elsewhere only UTF-8 is known
+// and every other code page is taken for Latin-1, which is what a system
+// without code pages, that has no UTF-8 either, most likely uses.
+const unsigned OS_CP_ANSI = 0;              // CP_ACP
+const unsigned OS_CP_UTF8 = 65001;          // CP_UTF8
+
+//
+// Converts len bytes in the code page cp to UTF-16, like
+// MultiByteToWideChar does. Returns the number of code units, that have
+// been written to dst, or that would be needed, if dst is nullptr. If
+// strict is set, invalid UTF-8 makes the conversion fail with 0. Otherwise
+// it turns into U+FFFD.
+//
+size_t os_to_utf16(
+    unsigned cp,
+    const char* src,
+    size_t len,
+    os_char* dst,
+    size_t dst_len,
+    bool strict
+    );
+
+// Converts len code units to the code page cp, like WideCharToMultiByte
+// does. Characters that cp does not have become '?'. UTF-8 never takes more
+// than three bytes per code unit. Returns the number of bytes like
+// os_to_utf16.
+size_t os_from_utf16(
+    unsigned cp,
+    const os_char* src,
+    size_t len,
+    char* dst,
+    size_t dst_len
+    );
+
+// Tells whether every character of the ANSI code page is a single byte.
+bool os_ansi_is_single_byte();
+
+// Lower case like CharLowerBuff, in place. Elsewhere the C library decides
+// and characters outside of the BMP are kept.
+void os_to_lower(os_char* str, size_t len);
+
+size_t os_strlen(const os_char* str);
+
+// Compares without regard to case like lstrcmpi (< 0, 0 or > 0).
+int os_strcmpi(const os_char* a, const os_char* b);
+
+// Parses the decimal digits at the start of str like _wcstoui64 and sets
+// end to the first character behind them. Too large a number is clamped.
+inline uint64_t os_parse_uint(const os_char* str, const os_char** end)
+{
+    uint64_t value = 0;
+    for (; *str >= '0' && *str <= '9'; ++str)
+    {
+        const unsigned digit = *str - '0';
+        value = (value > (UINT64_MAX - digit) / 10) ?
+            UINT64_MAX :
+            10 * value + digit;
+    }
+    if (end)
+    {
+        *end = str;
+    }
+    return value;
+}
+
+// Like _wtoi: blanks, an optional sign, digits and anything after them.
+inline int os_parse_int(const os_char* str)
+{
+    while (*str == ' ' || *str == '\t')
+    {
+        ++str;
+    }
+    const bool negative = (*str == '-');
+    if (*str == '-' || *str == '+')
+    {
+        ++str;
+    }
+    const uint64_t value = os_parse_uint(str, nullptr);
+    const int64_t clamped = static_cast<int64_t>(
+        (value > uint64_t(INT32_MAX)) ? uint64_t(INT32_MAX) : value
+        );
+    return static_cast<int>(negative ? -clamped : clamped);
+}
+
+//
+// The standard output or error of the process. Text is written to a
+// console as it is and as UTF-8 to everything else (a file or a pipe). A
+// GUI process on Windows has no standard handles, unless they have been
+// redirected. It uses the console of its parent then.
+//
+class OsStdStream
+{
+public:
+    explicit OsStdStream(bool error);
+    ~OsStdStream();
+
+    bool write(const os_char* str, size_t len);
+
+private:
+    OsStdStream(const OsStdStream&) = delete;
+    OsStdStream& operator=(const OsStdStream&) = delete;
+
+#ifdef _WIN32
+    HANDLE m_handle;
+    bool m_console;
+    bool m_owned;                   // m_handle is CONOUT$
+#else
+    int m_fd;
+#endif
+    char* m_utf8;                   // malloc'ed
+    size_t m_utf8_len;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// A thread, that runs a function until it returns. join() waits for that.
+// The thread has to be joined before its object is destroyed or started
+// again. A thread can be moved, as long as it is not joined meanwhile.
+//
+class OsThread
+{
+public:
+    using PROC = void(*)(void* arg);
+
+    OsThread();
+    OsThread(OsThread&& other);
+    ~OsThread();
+
+    bool start(PROC proc, void* arg);
+    void join();
+
+    bool is_started() const
+    {
+        return m_started;
+    }
+
+private:
+    OsThread(const OsThread&) = delete;
+    OsThread& operator=(const OsThread&) = delete;
+
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    pthread_t m_thread;
+#endif
+    bool m_started;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// A lock, that is only taken exclusively. OsCondVar waits with it.
+class OsMutex
+{
+public:
+    OsMutex();
+    ~OsMutex();
+    void lock();
+    void unlock();
+
+private:
+    OsMutex(const OsMutex&) = delete;
+    OsMutex& operator=(const OsMutex&) = delete;
+
+    friend class OsCondVar;
+#ifdef _WIN32
+    SRWLOCK m_lock;
+#else
+    pthread_mutex_t m_lock;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A lock for many readers or a single writer.
+class OsRwLock
+{
+public:
+    OsRwLock();
+    ~OsRwLock();
+    void lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+private:
+    OsRwLock(const OsRwLock&) = delete;
+    OsRwLock& operator=(const OsRwLock&) = delete;
+
+#ifdef _WIN32
+    SRWLOCK m_lock;
+#else
+    pthread_rwlock_t m_lock;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// A condition variable. wait() has to be called with the mutex being held.
+// It releases the mutex while waiting and takes it again before returning.
+// As usual, it may return without having been woken up.
+//
+class OsCondVar
+{
+public:
+    OsCondVar();
+    ~OsCondVar();
+    void wait(OsMutex& mutex);
+    void wake_one();
+    void wake_all();
+
+private:
+    OsCondVar(const OsCondVar&) = delete;
+    OsCondVar& operator=(const OsCondVar&) = delete;
+
+#ifdef _WIN32
+    CONDITION_VARIABLE m_cv;
+#else
+    pthread_cond_t m_cv;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// A part of a file, that has been mapped into memory read-only.
+struct OsView
+{
+    const void* base;               // where the system put the view
+    size_t len;                     // of the whole view
+    const uint8_t* data;            // the position that was asked for
+};
+
+//
+// A file that is either read sequentially and mapped or created and
+// written. Views stay valid after the file has been closed and have to be
+// released with unmap().
+//
+class OsFile
+{
+public:
+    OsFile();
+    ~OsFile();
+
+    bool open(const os_char* path);
+    bool create(const os_char* path);
+
+    // Creates a file, that is written and read again, and that is deleted
+    // when it is closed. rewind() goes back to its start.
+    bool create_temp(const os_char* path);
+    bool rewind();
+
+    // Creates a file of len bytes, that is written through a view of all
+    // of it. data points into the view, until unmap() is called with it.
+    bool create_mapped(
+        const os_char* path,
+        size_t len,
+        OsView& view,
+        uint8_t*& data
+        );
+
+    void close();
+
+    bool is_open() const;
+
+    // Reads len bytes, unless the file ends before. num_read tells how
+    // many bytes have been read.
+    bool read(void* buf, size_t len, size_t& num_read);
+    bool write(const void* buf, size_t len);
+    bool size(uint64_t& size);
+
+    // pos does not have to be aligned to anything.
+    bool map(uint64_t pos, size_t len, OsView& view);
+    static void unmap(const OsView& view);
+
+    // Asks the system to read the view into the cache without waiting for
+    // that. Windows can only do that since Windows 8.
+    static bool can_prefetch();
+    static void prefetch(const OsView& view);
+
+private:
+    OsFile(const OsFile&) = delete;
+    OsFile& operator=(const OsFile&) = delete;
+
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;               // created by the first map()
+#else
+    int m_fd;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// The attributes of a directory entry have the values of FILE_ATTRIBUTE_*
+// on every system. Elsewhere a name that starts with a dot is hidden and a
+// file that its owner may not write is read-only.
+const uint32_t OS_ATTR_READONLY = 0x01;
+const uint32_t OS_ATTR_HIDDEN = 0x02;
+const uint32_t OS_ATTR_SYSTEM = 0x04;
+const uint32_t OS_ATTR_DIRECTORY = 0x10;
+
+struct OsDirEntry
+{
+    const os_char* name;            // without the directory
+    uint64_t size;
+    uint64_t write_time;            // FILETIME: 100 ns since 1601 (UTC)
+    uint32_t attributes;            // OS_ATTR_*
+
+    bool is_dir() const
+    {
+        return (attributes & OS_ATTR_DIRECTORY) != 0;
+    }
+};
+
+//
+// Lists the entries of a single directory, without "." and "..". On
+// Windows FindFirstFileEx fetches them in large blocks. Elsewhere readdir
+// (getdents underneath) does, and every entry is looked at with fstatat.
+// Only files and directories are listed there: symbolic links are
+// followed to files but not to directories, so a walk cannot run in
+// circles, and pipes or devices are left out, because reading them could
+// block.
+//
+class OsDirReader
+{
+public:
+    OsDirReader();
+    ~OsDirReader();
+
+    // dir may end with a separator or not.
+    bool open(const os_char* dir);
+    void close();
+
+    // The entry stays valid until next() or close() is called.
+    bool next(OsDirEntry& entry);
+
+private:
+    OsDirReader(const OsDirReader&) = delete;
+    OsDirReader& operator=(const OsDirReader&) = delete;
+
+#ifdef _WIN32
+    HANDLE m_handle;
+    WIN32_FIND_DATAW m_data;
+    bool m_have_data;               // m_data has not been returned yet
+#else
+    DIR* m_dir;
+    os_char m_name[256];            // of the entry, at most NAME_MAX bytes
+#endif
+};
+
+// Fills entry for a single path, like OsDirReader does. entry.name is
+// nullptr.
+bool os_get_entry(const os_char* path, OsDirEntry& entry);
+
+inline bool os_is_dir(const os_char* path)
+{
+    OsDirEntry entry;
+    return os_get_entry(path, entry) && entry.is_dir();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_delete_file(const os_char* path);
+
+// Succeeds as well, if the directory exists already.
+bool os_create_dir(const os_char* path);
+
+// Only deletes an empty directory.
+bool os_delete_dir(const os_char* path);
+
+// Both replace a file, that has the new name already.
+bool os_rename(const os_char* from, const os_char* to);
+bool os_copy_file(const os_char* from, const os_char* to);
+
+// Only OS_ATTR_READONLY can be set elsewhere than on Windows, where every
+// attribute but OS_ATTR_DIRECTORY can.
+bool os_set_attributes(const os_char* path, uint32_t attributes);
+
+// The FILETIME (see OsDirEntry) at which a day starts in the local time
+// zone.
+bool os_local_midnight(
+    unsigned year,
+    unsigned month,
+    unsigned day,
+    uint64_t& time
+    );
+
+// The directory that keeps the data of the user for applications:
+// %LOCALAPPDATA% on Windows and $XDG_DATA_HOME or ~/.local/share
+// elsewhere. Returns the length of the path or 0, if it is not known or
+// does not fit into buf (with the terminating 0).
+size_t os_app_data_dir(os_char* buf, size_t len);
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Tells which names below a directory have been created, deleted, renamed
+// or written. Windows uses ReadDirectoryChangesW on the root. Linux uses
+// inotify with a watch on every directory of the tree; directories that
+// appear later are watched as soon as their creation is reported. Other
+// systems cannot open a monitor.
+//
+class OsDirMonitor
+{
+public:
+    enum Result
+    {
+        CHANGES,                    // the names have been passed to the cb
+        LOST,                       // too many changes, some got lost
+        STOPPED,                    // by stop()
+        FAILED                      // e.g. the root has been deleted
+    };
+
+    // name is relative to the root and not terminated.
+    using NAME_CB = void(*)(void* pctxt, const os_char* name, size_t len);
+
+    OsDirMonitor();
+    ~OsDirMonitor();
+
+    bool open(const os_char* root);
+    void close();
+
+    // Blocks until something has changed. Changes that happen meanwhile
+    // are kept by the system for the next call.
+    Result wait(NAME_CB cb, void* pctxt);
+
+    // Makes the current or the next wait() return STOPPED. May be called
+    // by any thread, but not after close().
+    void stop();
+
+private:
+    OsDirMonitor(const OsDirMonitor&) = delete;
+    OsDirMonitor& operator=(const OsDirMonitor&) = delete;
+
+#ifdef _WIN32
+    HANDLE m_dir;
+    HANDLE m_stop;                  // event
+    HANDLE m_done;                  // event of the read
+    DWORD* m_buf;                   // has to be DWORD aligned
+#else
+    struct Watch
+    {
+        int wd;
+        char* path;                 // relative to the root, malloc'ed
+    };
+
+    bool add_tree(const char* rel);
+    void remove_tree(const char* rel);
+    Watch* find(int wd);
+    void erase(Watch* watch);
+
+    int m_fd;                       // of inotify
+    int m_stop[2];                  // pipe
+    char* m_root;
+    Watch* m_watches;               // sorted by wd
+    size_t m_num_watches;
+    size_t m_max_watches;
+    char* m_buf;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
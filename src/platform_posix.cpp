@@ -0,0 +1,1643 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "platform.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <wctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+void os_sleep(unsigned ms)
+{
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = static_cast<long>(ms % 1000) * 1000000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned os_num_cpus()
+{
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? static_cast<unsigned>(count) : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t os_ticks()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>(
+        uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t os_avail_memory()
+{
+    const long pages = sysconf(_SC_AVPHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0)
+    {
+        return 0;
+    }
+    return uint64_t(pages) * uint64_t(page_size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t os_private_memory()
+{
+#ifdef __linux__
+    // The sixth of the numbers in statm is the number of pages of data.
+    const int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    char buf[256];
+    const ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+    {
+        return 0;
+    }
+    buf[len] = 0;
+    const char* p = buf;
+    for (int i = 0; i < 5 && p; i++)
+    {
+        p = strchr(p, ' ');
+        p = p ? p + 1 : nullptr;
+    }
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (!p || page_size <= 0)
+    {
+        return 0;
+    }
+    return strtoull(p, nullptr, 10) * uint64_t(page_size);
+#else
+    return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint32_t NO_CHAR = 0xffffffff;
+
+// Decodes the UTF-8 sequence at pos and moves pos behind it. An invalid
+// sequence gives NO_CHAR and only its first byte is skipped.
+static uint32_t decode_utf8(const uint8_t* src, size_t len, size_t& pos)
+{
+    const uint32_t first = src[pos++];
+    if (first < 0x80)
+    {
+        return first;
+    }
+    size_t follow;
+    uint32_t c;
+    uint32_t min;
+    if ((first & 0xe0) == 0xc0)
+    {
+        follow = 1;
+        c = first & 0x1f;
+        min = 0x80;
+    }
+    else if ((first & 0xf0) == 0xe0)
+    {
+        follow = 2;
+        c = first & 0x0f;
+        min = 0x800;
+    }
+    else if ((first & 0xf8) == 0xf0)
+    {
+        follow = 3;
+        c = first & 0x07;
+        min = 0x10000;
+    }
+    else
+    {
+        return NO_CHAR;
+    }
+    if (len - pos < follow)
+    {
+        return NO_CHAR;
+    }
+    for (size_t i = 0; i < follow; ++i)
+    {
+        const uint32_t b = src[pos + i];
+        if ((b & 0xc0) != 0x80)
+        {
+            return NO_CHAR;
+        }
+        c = (c << 6) | (b & 0x3f);
+    }
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c < 0xe000))
+    {
+        return NO_CHAR;
+    }
+    pos += follow;
+    return c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_to_utf16(
+    unsigned cp,
+    const char* src,
+    size_t len,
+    os_char* dst,
+    size_t dst_len,
+    bool strict
+    )
+{
+    const uint8_t* const bytes = reinterpret_cast<const uint8_t*>(src);
+    size_t num = 0;
+    for (size_t pos = 0; pos < len; )
+    {
+        uint32_t c = bytes[pos];
+        if (cp != OS_CP_UTF8)
+        {
+            ++pos;
+        }
+        else if ((c = decode_utf8(bytes, len, pos)) == NO_CHAR)
+        {
+            if (strict)
+            {
+                return 0;
+            }
+            c = 0xfffd;
+        }
+        const size_t units = (c < 0x10000) ? 1 : 2;
+        if (dst)
+        {
+            if (num + units > dst_len)
+            {
+                return 0;
+            }
+            if (units == 1)
+            {
+                dst[num] = static_cast<os_char>(c);
+            }
+            else
+            {
+                c -= 0x10000;
+                dst[num] = static_cast<os_char>(0xd800 | (c >> 10));
+                dst[num + 1] = static_cast<os_char>(0xdc00 | (c & 0x3ff));
+            }
+        }
+        num += units;
+    }
+    return num;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_from_utf16(
+    unsigned cp,
+    const os_char* src,
+    size_t len,
+    char* dst,
+    size_t dst_len
+    )
+{
+    size_t num = 0;
+    for (size_t pos = 0; pos < len; )
+    {
+        uint32_t c = static_cast<uint16_t>(src[pos++]);
+        if (cp != OS_CP_UTF8)
+        {
+            c = (c < 0x100) ? c : '?';
+        }
+        else if (c >= 0xd800 && c < 0xe000)
+        {
+            // a pair of surrogates or U+FFFD for a single one
+            const uint32_t low = (pos < len) ? uint16_t(src[pos]) : 0;
+            if (c < 0xdc00 && low >= 0xdc00 && low < 0xe000)
+            {
+                c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                ++pos;
+            }
+            else
+            {
+                c = 0xfffd;
+            }
+        }
+        const size_t bytes = (cp != OS_CP_UTF8 || c < 0x80) ? 1 :
+            (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+        if (dst)
+        {
+            if (num + bytes > dst_len)
+            {
+                return 0;
+            }
+            uint8_t* const out = reinterpret_cast<uint8_t*>(dst + num);
+            switch (bytes)
+            {
+                case 1:
+                    out[0] = static_cast<uint8_t>(c);
+                    break;
+                case 2:
+                    out[0] = static_cast<uint8_t>(0xc0 | (c >> 6));
+                    out[1] = static_cast<uint8_t>(0x80 | (c & 0x3f));
+                    break;
+                case 3:
+                    out[0] = static_cast<uint8_t>(0xe0 | (c >> 12));
+                    out[1] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3f));
+                    out[2] = static_cast<uint8_t>(0x80 | (c & 0x3f));
+                    break;
+                default:
+                    out[0] = static_cast<uint8_t>(0xf0 | (c >> 18));
+                    out[1] = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3f));
+                    out[2] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3f));
+                    out[3] = static_cast<uint8_t>(0x80 | (c & 0x3f));
+                    break;
+            }
+        }
+        num += bytes;
+    }
+    return num;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_ansi_is_single_byte()
+{
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The case of characters other than ASCII is only known to a locale with
+// UTF-8. The one of the process is left alone.
+static os_char to_lower(os_char c)
+{
+    static const locale_t utf8 = newlocale(LC_CTYPE_MASK, "C.UTF-8", 0);
+    if (c < 0x80)
+    {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    if (utf8 == 0 || (c >= 0xd800 && c < 0xe000))
+    {
+        return c;
+    }
+    const wint_t lower = towlower_l(static_cast<uint16_t>(c), utf8);
+    return (lower < 0x10000) ? static_cast<os_char>(lower) : c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void os_to_lower(os_char* str, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        str[i] = to_lower(str[i]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_strlen(const os_char* str)
+{
+    size_t len = 0;
+    while (str[len])
+    {
+        ++len;
+    }
+    return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int os_strcmpi(const os_char* a, const os_char* b)
+{
+    for (;; ++a, ++b)
+    {
+        const int diff = int(to_lower(*a)) - int(to_lower(*b));
+        if (diff || *a == 0)
+        {
+            return diff;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Returns the UTF-8 of len code units, terminated by 0, in a buffer from
+// malloc.
+static char* utf8_dup(const os_char* str, size_t len)
+{
+    char* const utf8 = static_cast<char*>(malloc(3 * len + 1));
+    if (utf8)
+    {
+        utf8[os_from_utf16(OS_CP_UTF8, str, len, utf8, 3 * len)] = 0;
+    }
+    return utf8;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Returns the UTF-16 of a name from the system in a buffer from malloc.
+// Invalid UTF-8 is not refused, but cannot be passed back either.
+static os_char* utf16_dup(const char* str, size_t len)
+{
+    os_char* const utf16 = static_cast<os_char*>(
+        malloc((len + 1) * sizeof(os_char))
+        );
+    if (utf16)
+    {
+        utf16[os_to_utf16(OS_CP_UTF8, str, len, utf16, len, false)] = 0;
+    }
+    return utf16;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A path as the system takes it. str() is nullptr if it cannot be
+// converted.
+class NativePath
+{
+public:
+    explicit NativePath(const os_char* path) :
+        m_str(utf8_dup(path, os_strlen(path)))
+    {
+    }
+
+    ~NativePath()
+    {
+        free(m_str);
+    }
+
+    const char* str() const
+    {
+        return m_str;
+    }
+
+private:
+    NativePath(const NativePath&) = delete;
+    NativePath& operator=(const NativePath&) = delete;
+
+    char* m_str;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsStdStream::OsStdStream(bool error) :
+    m_fd(error ? STDERR_FILENO : STDOUT_FILENO),
+    m_utf8(nullptr),
+    m_utf8_len(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsStdStream::~OsStdStream()
+{
+    free(m_utf8);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsStdStream::write(const os_char* str, size_t len)
+{
+    if (m_utf8_len < 3 * len)
+    {
+        free(m_utf8);
+        m_utf8_len = 3 * len;
+        m_utf8 = static_cast<char*>(malloc(m_utf8_len));
+        if (m_utf8 == nullptr)
+        {
+            m_utf8_len = 0;
+            return false;
+        }
+    }
+    const char* src = m_utf8;
+    size_t rest = os_from_utf16(OS_CP_UTF8, str, len, m_utf8, m_utf8_len);
+    while (rest)
+    {
+        const ssize_t done = ::write(m_fd, src, rest);
+        if (done < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (done <= 0)
+        {
+            return false;
+        }
+        src += done;
+        rest -= static_cast<size_t>(done);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// What a new thread has to call. It is freed by the thread itself.
+struct ThreadStart
+{
+    OsThread::PROC proc;
+    void* arg;
+};
+
+static void* thread_start(void* pctxt)
+{
+    const ThreadStart start = *static_cast<ThreadStart*>(pctxt);
+    free(pctxt);
+    start.proc(start.arg);
+    return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::OsThread() : m_thread(), m_started(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::OsThread(OsThread&& other) :
+    m_thread(other.m_thread),
+    m_started(other.m_started)
+{
+    other.m_started = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::~OsThread()
+{
+    join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsThread::start(PROC proc, void* arg)
+{
+    ThreadStart* start = static_cast<ThreadStart*>(malloc(sizeof(ThreadStart)));
+    if (start == nullptr)
+    {
+        return false;
+    }
+    start->proc = proc;
+    start->arg = arg;
+    if (pthread_create(&m_thread, nullptr, thread_start, start) != 0)
+    {
+        free(start);
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsThread::join()
+{
+    if (m_started)
+    {
+        pthread_join(m_thread, nullptr);
+        m_started = false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+OsMutex::OsMutex()
+{
+    pthread_mutex_init(&m_lock, nullptr);
+}
+
+OsMutex::~OsMutex()
+{
+    pthread_mutex_destroy(&m_lock);
+}
+
+void OsMutex::lock()
+{
+    pthread_mutex_lock(&m_lock);
+}
+
+void OsMutex::unlock()
+{
+    pthread_mutex_unlock(&m_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsRwLock::OsRwLock()
+{
+    pthread_rwlock_init(&m_lock, nullptr);
+}
+
+OsRwLock::~OsRwLock()
+{
+    pthread_rwlock_destroy(&m_lock);
+}
+
+void OsRwLock::lock()
+{
+    pthread_rwlock_wrlock(&m_lock);
+}
+
+void OsRwLock::unlock()
+{
+    pthread_rwlock_unlock(&m_lock);
+}
+
+void OsRwLock::lock_shared()
+{
+    pthread_rwlock_rdlock(&m_lock);
+}
+
+void OsRwLock::unlock_shared()
+{
+    pthread_rwlock_unlock(&m_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsCondVar::OsCondVar()
+{
+    pthread_cond_init(&m_cv, nullptr);
+}
+
+OsCondVar::~OsCondVar()
+{
+    pthread_cond_destroy(&m_cv);
+}
+
+void OsCondVar::wait(OsMutex& mutex)
+{
+    pthread_cond_wait(&m_cv, &mutex.m_lock);
+}
+
+void OsCondVar::wake_one()
+{
+    pthread_cond_signal(&m_cv);
+}
+
+void OsCondVar::wake_all()
+{
+    pthread_cond_broadcast(&m_cv);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+OsFile::OsFile() : m_fd(-1)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsFile::~OsFile()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::open(const os_char* path)
+{
+    close();
+    const NativePath native(path);
+    m_fd = native.str() ? ::open(native.str(), O_RDONLY | O_CLOEXEC) : -1;
+    if (m_fd < 0)
+    {
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create(const os_char* path)
+{
+    close();
+    const NativePath native(path);
+    m_fd = native.str() ?
+        ::open(native.str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666) :
+        -1;
+    return m_fd >= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create_temp(const os_char* path)
+{
+    // The name goes away right now, the file when it is closed.
+    close();
+    const NativePath native(path);
+    if (native.str() == nullptr)
+    {
+        return false;
+    }
+    m_fd = ::open(native.str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (m_fd >= 0)
+    {
+        unlink(native.str());
+    }
+    return m_fd >= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::rewind()
+{
+    return lseek(m_fd, 0, SEEK_SET) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create_mapped(
+    const os_char* path,
+    size_t len,
+    OsView& view,
+    uint8_t*& data
+    )
+{
+    close();
+    const NativePath native(path);
+    if (native.str() == nullptr)
+    {
+        return false;
+    }
+    m_fd = ::open(native.str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (m_fd < 0 || len == 0 || ftruncate(m_fd, static_cast<off_t>(len)) != 0)
+    {
+        return false;
+    }
+    void* const base = mmap(
+        nullptr,
+        len,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        m_fd,
+        0
+        );
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+    view.base = base;
+    view.len = len;
+    view.data = static_cast<const uint8_t*>(base);
+    data = static_cast<uint8_t*>(base);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::close()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::is_open() const
+{
+    return m_fd >= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::read(void* buf, size_t len, size_t& num_read)
+{
+    uint8_t* dst = static_cast<uint8_t*>(buf);
+    num_read = 0;
+    while (num_read < len)
+    {
+        const ssize_t done = ::read(m_fd, dst + num_read, len - num_read);
+        if (done < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        if (done == 0)
+        {
+            break;
+        }
+        num_read += static_cast<size_t>(done);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::write(const void* buf, size_t len)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(buf);
+    while (len)
+    {
+        const ssize_t done = ::write(m_fd, src, len);
+        if (done < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (done <= 0)
+        {
+            return false;
+        }
+        src += done;
+        len -= static_cast<size_t>(done);
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::size(uint64_t& size)
+{
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+    {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::map(uint64_t pos, size_t len, OsView& view)
+{
+    // A view has to start at a multiple of the page size.
+    const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t view_pos = pos - (pos % page_size);
+    const size_t skip = static_cast<size_t>(pos - view_pos);
+    if (skip + len == 0)
+    {
+        return false;
+    }
+    void* base = mmap(
+        nullptr,
+        skip + len,
+        PROT_READ,
+        MAP_SHARED,
+        m_fd,
+        static_cast<off_t>(view_pos)
+        );
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+    view.base = base;
+    view.len = skip + len;
+    view.data = static_cast<const uint8_t*>(base) + skip;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::unmap(const OsView& view)
+{
+    if (view.base)
+    {
+        munmap(const_cast<void*>(view.base), view.len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::can_prefetch()
+{
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::prefetch(const OsView& view)
+{
+    if (view.base)
+    {
+        madvise(const_cast<void*>(view.base), view.len, MADV_WILLNEED);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Seconds between 1601-01-01, where FILETIME starts, and 1970-01-01.
+static const uint64_t EPOCH_DIFF = 11644473600ull;
+
+// Only files and directories are turned into entries (see OsDirReader).
+static bool entry_from_stat(
+    const os_char* name,
+    const struct stat& st,
+    OsDirEntry& entry
+    )
+{
+    if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode))
+    {
+        return false;
+    }
+    entry.name = name;
+    entry.size = S_ISREG(st.st_mode) ? static_cast<uint64_t>(st.st_size) : 0;
+    entry.write_time = (
+        (static_cast<uint64_t>(st.st_mtim.tv_sec) + EPOCH_DIFF) * 10000000 +
+        static_cast<uint64_t>(st.st_mtim.tv_nsec) / 100
+        );
+    entry.attributes = 0;
+    if (S_ISDIR(st.st_mode))
+    {
+        entry.attributes |= OS_ATTR_DIRECTORY;
+    }
+    if ((st.st_mode & S_IWUSR) == 0)
+    {
+        entry.attributes |= OS_ATTR_READONLY;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirReader::OsDirReader() : m_dir(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirReader::~OsDirReader()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirReader::open(const os_char* dir)
+{
+    close();
+    const NativePath native(dir);
+    m_dir = native.str() ? opendir(native.str()) : nullptr;
+    return m_dir != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirReader::close()
+{
+    if (m_dir)
+    {
+        closedir(m_dir);
+        m_dir = nullptr;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirReader::next(OsDirEntry& entry)
+{
+    if (m_dir == nullptr)
+    {
+        return false;
+    }
+    const int fd = dirfd(m_dir);
+    while (const struct dirent* ent = readdir(m_dir))
+    {
+        const char* const n = ent->d_name;
+        if (n[0] == '.' && (n[1] == 0 || (n[1] == '.' && n[2] == 0)))
+        {
+            continue;
+        }
+        // A link is looked at again with its target, unless that is a
+        // directory. Entries that vanish in between are skipped.
+        struct stat st;
+        if (fstatat(fd, n, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            continue;
+        }
+        if (S_ISLNK(st.st_mode))
+        {
+            if (fstatat(fd, n, &st, 0) != 0 || S_ISDIR(st.st_mode))
+            {
+                continue;
+            }
+        }
+        // NAME_MAX bytes of UTF-8 are never more code units.
+        const size_t len = os_to_utf16(
+            OS_CP_UTF8,
+            n,
+            strlen(n),
+            m_name,
+            sizeof(m_name) / sizeof(m_name[0]) - 1,
+            false
+            );
+        m_name[len] = 0;
+        if (len && entry_from_stat(m_name, st, entry))
+        {
+            if (n[0] == '.')
+            {
+                entry.attributes |= OS_ATTR_HIDDEN;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_get_entry(const os_char* path, OsDirEntry& entry)
+{
+    const NativePath native(path);
+    struct stat st;
+    if (
+        native.str() == nullptr ||
+        stat(native.str(), &st) != 0 ||
+        !entry_from_stat(nullptr, st, entry)
+        )
+    {
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_delete_file(const os_char* path)
+{
+    const NativePath native(path);
+    return native.str() && unlink(native.str()) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_create_dir(const os_char* path)
+{
+    const NativePath native(path);
+    return native.str() && (mkdir(native.str(), 0777) == 0 || errno == EEXIST);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_delete_dir(const os_char* path)
+{
+    const NativePath native(path);
+    return native.str() && rmdir(native.str()) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_rename(const os_char* from, const os_char* to)
+{
+    const NativePath native_from(from);
+    const NativePath native_to(to);
+    return (
+        native_from.str() &&
+        native_to.str() &&
+        rename(native_from.str(), native_to.str()) == 0
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_copy_file(const os_char* from, const os_char* to)
+{
+    // Like CopyFile, the copy gets the permissions of the original.
+    const NativePath native_from(from);
+    struct stat st;
+    OsFile src;
+    if (
+        native_from.str() == nullptr ||
+        stat(native_from.str(), &st) != 0 ||
+        !src.open(from)
+        )
+    {
+        return false;
+    }
+    const NativePath native(to);
+    const int dst = native.str() ? ::open(
+        native.str(),
+        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        st.st_mode & 07777
+        ) : -1;
+    if (dst < 0)
+    {
+        return false;
+    }
+    static const size_t BUF_SIZE = 64 * 1024;
+    uint8_t* const buf = static_cast<uint8_t*>(malloc(BUF_SIZE));
+    bool ok = buf != nullptr;
+    size_t num_read = 0;
+    while (ok && (ok = src.read(buf, BUF_SIZE, num_read)) && num_read)
+    {
+        for (size_t pos = 0; ok && pos < num_read; )
+        {
+            const ssize_t done = ::write(dst, buf + pos, num_read - pos);
+            if (done < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            ok = done > 0;
+            pos += ok ? static_cast<size_t>(done) : 0;
+        }
+    }
+    free(buf);
+    ok = (::close(dst) == 0) && ok;
+    if (!ok)
+    {
+        unlink(native.str());
+    }
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_set_attributes(const os_char* path, uint32_t attributes)
+{
+    const NativePath native(path);
+    struct stat st;
+    if (native.str() == nullptr || stat(native.str(), &st) != 0)
+    {
+        return false;
+    }
+    mode_t mode = st.st_mode & 07777;
+    if (attributes & OS_ATTR_READONLY)
+    {
+        mode &= ~(S_IWUSR | S_IWGRP | S_IWOTH);
+    }
+    else
+    {
+        mode |= S_IWUSR;
+    }
+    return chmod(native.str(), mode) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_local_midnight(
+    unsigned year,
+    unsigned month,
+    unsigned day,
+    uint64_t& time
+    )
+{
+    // mktime accepts days like the 31st of February, that do not exist,
+    // by moving them.
+    struct tm tm = {};
+    tm.tm_year = static_cast<int>(year) - 1900;
+    tm.tm_mon = static_cast<int>(month) - 1;
+    tm.tm_mday = static_cast<int>(day);
+    tm.tm_isdst = -1;
+    const time_t t = mktime(&tm);
+    if (
+        t == time_t(-1) ||
+        tm.tm_year != static_cast<int>(year) - 1900 ||
+        tm.tm_mon != static_cast<int>(month) - 1 ||
+        tm.tm_mday != static_cast<int>(day) ||
+        t < -static_cast<time_t>(EPOCH_DIFF)
+        )
+    {
+        return false;
+    }
+    time = (static_cast<uint64_t>(t) + EPOCH_DIFF) * 10000000;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_app_data_dir(os_char* buf, size_t len)
+{
+    const char* const data_home = getenv("XDG_DATA_HOME");
+    const char* const home = getenv("HOME");
+    const char* dir = data_home;
+    const char* sub = "";
+    if (dir == nullptr || dir[0] != '/')
+    {
+        dir = home;
+        sub = "/.local/share";
+    }
+    if (dir == nullptr || dir[0] == 0 || len == 0)
+    {
+        return 0;
+    }
+    const size_t dir_len = os_to_utf16(
+        OS_CP_UTF8,
+        dir,
+        strlen(dir),
+        buf,
+        len - 1,
+        false
+        );
+    const size_t sub_len = strlen(sub);
+    if (dir_len == 0 || dir_len + sub_len >= len)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i <= sub_len; ++i)
+    {
+        buf[dir_len + i] = static_cast<os_char>(sub[i]);
+    }
+    return dir_len + sub_len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Returns "a/b" or b, if a is empty, in a buffer from malloc.
+static char* join_path(const char* a, const char* b)
+{
+    const size_t a_len = strlen(a);
+    const size_t b_len = strlen(b);
+    char* const path = static_cast<char*>(malloc(a_len + b_len + 2));
+    if (path == nullptr)
+    {
+        return nullptr;
+    }
+    size_t pos = 0;
+    if (a_len)
+    {
+        memcpy(path, a, a_len);
+        path[a_len] = '/';
+        pos = a_len + 1;
+    }
+    memcpy(path + pos, b, b_len + 1);
+    return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void close_fd(int& fd)
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::OsDirMonitor() :
+    m_fd(-1),
+    m_root(nullptr),
+    m_watches(nullptr),
+    m_num_watches(0),
+    m_max_watches(0),
+    m_buf(nullptr)
+{
+    m_stop[0] = m_stop[1] = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::~OsDirMonitor()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirMonitor::close()
+{
+    // Closing the inotify instance removes all of its watches.
+    close_fd(m_fd);
+    close_fd(m_stop[0]);
+    close_fd(m_stop[1]);
+    for (size_t i = 0; i < m_num_watches; ++i)
+    {
+        free(m_watches[i].path);
+    }
+    free(m_watches);
+    m_watches = nullptr;
+    m_num_watches = m_max_watches = 0;
+    free(m_root);
+    m_root = nullptr;
+    free(m_buf);
+    m_buf = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __linux__
+
+static const size_t MONITOR_BUF_SIZE = 64 * 1024;
+
+static const uint32_t WATCH_MASK = (
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+    IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF |
+    IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK
+    );
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirMonitor::open(const os_char* root)
+{
+    close();
+    m_root = utf8_dup(root, os_strlen(root));
+    size_t len = m_root ? strlen(m_root) : 0;
+    while (len > 1 && m_root[len - 1] == '/')
+    {
+        --len;
+    }
+    m_buf = static_cast<char*>(malloc(MONITOR_BUF_SIZE));
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (
+        m_root == nullptr ||
+        m_buf == nullptr ||
+        m_fd < 0 ||
+        pipe2(m_stop, O_CLOEXEC) != 0
+        )
+    {
+        close();
+        return false;
+    }
+    m_root[len] = 0;
+
+    // The root has to be watched itself, unlike the directories below.
+    if (!add_tree("") || m_num_watches == 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Watches the directory rel and everything below it. A directory that
+// vanishes meanwhile is no error: its parent reports that. Running out of
+// watches (see /proc/sys/fs/inotify/max_user_watches) is.
+//
+bool OsDirMonitor::add_tree(const char* rel)
+{
+    char* const full = rel[0] ? join_path(m_root, rel) : strdup(m_root);
+    if (full == nullptr)
+    {
+        return false;
+    }
+    const int wd = inotify_add_watch(m_fd, full, WATCH_MASK);
+    if (wd < 0)
+    {
+        free(full);
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+
+    // A directory that is watched already (e.g. after being moved) gets
+    // its new path.
+    char* const path = strdup(rel);
+    if (path == nullptr)
+    {
+        free(full);
+        return false;
+    }
+    Watch* const watch = find(wd);
+    if (watch)
+    {
+        free(watch->path);
+        watch->path = path;
+    }
+    else
+    {
+        if (m_num_watches == m_max_watches)
+        {
+            const size_t max = m_max_watches ? 2 * m_max_watches : 64;
+            Watch* const watches = static_cast<Watch*>(
+                realloc(m_watches, max * sizeof(Watch))
+                );
+            if (watches == nullptr)
+            {
+                free(path);
+                free(full);
+                return false;
+            }
+            m_watches = watches;
+            m_max_watches = max;
+        }
+        size_t pos = m_num_watches;
+        while (pos > 0 && m_watches[pos - 1].wd > wd)
+        {
+            --pos;
+        }
+        memmove(
+            m_watches + pos + 1,
+            m_watches + pos,
+            (m_num_watches - pos) * sizeof(Watch)
+            );
+        m_watches[pos].wd = wd;
+        m_watches[pos].path = path;
+        ++m_num_watches;
+    }
+
+    bool ok = true;
+    OsDirReader reader;
+    OsDirEntry entry;
+    os_char* const wide = utf16_dup(full, strlen(full));
+    if (wide && reader.open(wide))
+    {
+        while (ok && reader.next(entry))
+        {
+            if (entry.is_dir())
+            {
+                char* const name = utf8_dup(entry.name, os_strlen(entry.name));
+                char* const sub = name ? join_path(rel, name) : nullptr;
+                ok = sub && add_tree(sub);
+                free(sub);
+                free(name);
+            }
+        }
+    }
+    free(wide);
+    free(full);
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Stops watching rel and everything below it, because it has been moved
+// out of the tree.
+void OsDirMonitor::remove_tree(const char* rel)
+{
+    const size_t len = strlen(rel);
+    size_t kept = 0;
+    for (size_t i = 0; i < m_num_watches; ++i)
+    {
+        const char* const path = m_watches[i].path;
+        if (
+            strncmp(path, rel, len) == 0 &&
+            (path[len] == 0 || path[len] == '/')
+            )
+        {
+            inotify_rm_watch(m_fd, m_watches[i].wd);
+            free(m_watches[i].path);
+        }
+        else
+        {
+            m_watches[kept++] = m_watches[i];
+        }
+    }
+    m_num_watches = kept;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::Watch* OsDirMonitor::find(int wd)
+{
+    size_t lo = 0;
+    size_t hi = m_num_watches;
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (m_watches[mid].wd < wd)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (lo < m_num_watches && m_watches[lo].wd == wd) ?
+        m_watches + lo :
+        nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirMonitor::erase(Watch* watch)
+{
+    free(watch->path);
+    const size_t pos = watch - m_watches;
+    memmove(
+        watch,
+        watch + 1,
+        (m_num_watches - pos - 1) * sizeof(Watch)
+        );
+    --m_num_watches;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::Result OsDirMonitor::wait(NAME_CB cb, void* pctxt)
+{
+    struct pollfd fds[2] = {
+        { m_stop[0], POLLIN, 0 },
+        { m_fd, POLLIN, 0 }
+        };
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return FAILED;
+        }
+        if (fds[0].revents)
+        {
+            return STOPPED;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            return FAILED;
+        }
+    }
+
+    Result result = CHANGES;
+    for (;;)
+    {
+        const ssize_t len = read(m_fd, m_buf, MONITOR_BUF_SIZE);
+        if (len < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            return (len == 0 || errno == EAGAIN) ? result : FAILED;
+        }
+        for (ssize_t pos = 0; pos < len; )
+        {
+            const struct inotify_event* ev = (
+                reinterpret_cast<const struct inotify_event*>(m_buf + pos)
+                );
+            pos += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                result = LOST;
+                continue;
+            }
+            Watch* const watch = find(ev->wd);
+            if (watch == nullptr)
+            {
+                // removed by remove_tree
+                continue;
+            }
+            const bool is_root = watch->path[0] == 0;
+            if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // The parent reports the names of all other directories.
+                if (is_root)
+                {
+                    return FAILED;
+                }
+                if (ev->mask & IN_IGNORED)
+                {
+                    erase(watch);
+                }
+                continue;
+            }
+            if (ev->len == 0)
+            {
+                continue;
+            }
+            char* const name = join_path(watch->path, ev->name);
+            if (name == nullptr)
+            {
+                return FAILED;
+            }
+            // A directory that is renamed within the tree keeps its
+            // watches, which get the new paths with add_tree. Events that
+            // are queued for it meanwhile are not lost that way. One that
+            // is moved away is not watched any more.
+            bool ok = true;
+            if (ev->mask & IN_ISDIR)
+            {
+                const struct inotify_event* next = (
+                    reinterpret_cast<const struct inotify_event*>(m_buf + pos)
+                    );
+                if (
+                    (ev->mask & IN_MOVED_FROM) &&
+                    !(
+                        pos < len &&
+                        (next->mask & IN_MOVED_TO) &&
+                        next->cookie == ev->cookie
+                        )
+                    )
+                {
+                    remove_tree(name);
+                }
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    ok = add_tree(name);
+                }
+            }
+            const size_t name_len = strlen(name);
+            os_char* const wide = utf16_dup(name, name_len);
+            free(name);
+            if (wide == nullptr)
+            {
+                return FAILED;
+            }
+            cb(pctxt, wide, os_strlen(wide));
+            free(wide);
+            if (!ok)
+            {
+                return FAILED;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirMonitor::stop()
+{
+    const char c = 0;
+    while (write(m_stop[1], &c, 1) < 0 && errno == EINTR);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#else
+
+bool OsDirMonitor::open(const os_char*)
+{
+    return false;
+}
+
+OsDirMonitor::Result OsDirMonitor::wait(NAME_CB, void*)
+{
+    return FAILED;
+}
+
+void OsDirMonitor::stop()
+{
+}
+
+bool OsDirMonitor::add_tree(const char*)
+{
+    return false;
+}
+
+void OsDirMonitor::remove_tree(const char*)
+{
+}
+
+OsDirMonitor::Watch* OsDirMonitor::find(int)
+{
+    return nullptr;
+}
+
+void OsDirMonitor::erase(Watch*)
+{
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
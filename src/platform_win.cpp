@@ -0,0 +1,1066 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "platform.h"
+#include <stdlib.h>
+#include <psapi.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+void os_sleep(unsigned ms)
+{
+    Sleep(ms);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned os_num_cpus()
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t os_ticks()
+{
+    return GetTickCount();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t os_avail_memory()
+{
+    MEMORYSTATUSEX mstat = {sizeof(MEMORYSTATUSEX)};
+    GlobalMemoryStatusEx(&mstat);
+    return mstat.ullAvailPhys;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t os_private_memory()
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc = {sizeof(PROCESS_MEMORY_COUNTERS_EX)};
+    if (
+        !K32GetProcessMemoryInfo(
+            GetCurrentProcess(),
+            reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc),
+            sizeof(pmc)
+            )
+        )
+    {
+        return 0;
+    }
+    return pmc.PrivateUsage;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_to_utf16(
+    unsigned cp,
+    const char* src,
+    size_t len,
+    os_char* dst,
+    size_t dst_len,
+    bool strict
+    )
+{
+    if (len == 0 || len > MAXLONG || dst_len > MAXLONG)
+    {
+        return 0;
+    }
+    const int num = MultiByteToWideChar(
+        cp,
+        (strict && cp == CP_UTF8) ? MB_ERR_INVALID_CHARS : 0,
+        src,
+        static_cast<int>(len),
+        dst,
+        dst ? static_cast<int>(dst_len) : 0
+        );
+    return (num > 0) ? num : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_from_utf16(
+    unsigned cp,
+    const os_char* src,
+    size_t len,
+    char* dst,
+    size_t dst_len
+    )
+{
+    if (len == 0 || len > MAXLONG || dst_len > MAXLONG)
+    {
+        return 0;
+    }
+    const int num = WideCharToMultiByte(
+        cp,
+        0,
+        src,
+        static_cast<int>(len),
+        dst,
+        dst ? static_cast<int>(dst_len) : 0,
+        nullptr,
+        nullptr
+        );
+    return (num > 0) ? num : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_ansi_is_single_byte()
+{
+    CPINFO cpi;
+    return GetCPInfo(CP_ACP, &cpi) && cpi.MaxCharSize == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void os_to_lower(os_char* str, size_t len)
+{
+    while (len)
+    {
+        const DWORD chunk = static_cast<DWORD>(
+            (len > 0x40000000) ? 0x40000000 : len
+            );
+        CharLowerBuffW(str, chunk);
+        str += chunk;
+        len -= chunk;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_strlen(const os_char* str)
+{
+    return lstrlenW(str);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int os_strcmpi(const os_char* a, const os_char* b)
+{
+    return lstrcmpiW(a, b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsStdStream::OsStdStream(bool error) :
+    m_console(false),
+    m_owned(false),
+    m_utf8(nullptr),
+    m_utf8_len(0)
+{
+    m_handle = GetStdHandle(error ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE);
+    if (m_handle == nullptr || m_handle == INVALID_HANDLE_VALUE)
+    {
+        AttachConsole(ATTACH_PARENT_PROCESS);
+        m_handle = CreateFileW(
+            L"CONOUT$",
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            0,
+            nullptr
+            );
+        m_owned = (m_handle != INVALID_HANDLE_VALUE);
+    }
+    DWORD mode;
+    m_console = GetConsoleMode(m_handle, &mode) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsStdStream::~OsStdStream()
+{
+    if (m_owned)
+    {
+        CloseHandle(m_handle);
+    }
+    free(m_utf8);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsStdStream::write(const os_char* str, size_t len)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+    if (
+        m_handle == nullptr ||
+        m_handle == INVALID_HANDLE_VALUE ||
+        len > MAXLONG
+        )
+    {
+        return false;
+    }
+    DWORD written;
+    if (m_console)
+    {
+        return WriteConsoleW(
+            m_handle,
+            str,
+            static_cast<DWORD>(len),
+            &written,
+            nullptr
+            ) != 0;
+    }
+    if (m_utf8_len < 3 * len)
+    {
+        free(m_utf8);
+        m_utf8_len = 3 * len;
+        m_utf8 = static_cast<char*>(malloc(m_utf8_len));
+        if (m_utf8 == nullptr)
+        {
+            m_utf8_len = 0;
+            return false;
+        }
+    }
+    const size_t num = os_from_utf16(CP_UTF8, str, len, m_utf8, m_utf8_len);
+    return (
+        num > 0 &&
+        WriteFile(m_handle, m_utf8, static_cast<DWORD>(num), &written, nullptr)
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// What a new thread has to call. It is freed by the thread itself.
+struct ThreadStart
+{
+    OsThread::PROC proc;
+    void* arg;
+};
+
+static DWORD WINAPI thread_start(void* pctxt)
+{
+    const ThreadStart start = *static_cast<ThreadStart*>(pctxt);
+    free(pctxt);
+    start.proc(start.arg);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::OsThread() : m_handle(nullptr), m_started(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::OsThread(OsThread&& other) :
+    m_handle(other.m_handle),
+    m_started(other.m_started)
+{
+    other.m_handle = nullptr;
+    other.m_started = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsThread::~OsThread()
+{
+    join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsThread::start(PROC proc, void* arg)
+{
+    ThreadStart* start = static_cast<ThreadStart*>(malloc(sizeof(ThreadStart)));
+    if (start == nullptr)
+    {
+        return false;
+    }
+    start->proc = proc;
+    start->arg = arg;
+    m_handle = CreateThread(nullptr, 0, thread_start, start, 0, nullptr);
+    if (m_handle == nullptr)
+    {
+        free(start);
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsThread::join()
+{
+    if (m_started)
+    {
+        WaitForSingleObject(m_handle, INFINITE);
+        CloseHandle(m_handle);
+        m_handle = nullptr;
+        m_started = false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+OsMutex::OsMutex()
+{
+    InitializeSRWLock(&m_lock);
+}
+
+OsMutex::~OsMutex()
+{
+}
+
+void OsMutex::lock()
+{
+    AcquireSRWLockExclusive(&m_lock);
+}
+
+void OsMutex::unlock()
+{
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsRwLock::OsRwLock()
+{
+    InitializeSRWLock(&m_lock);
+}
+
+OsRwLock::~OsRwLock()
+{
+}
+
+void OsRwLock::lock()
+{
+    AcquireSRWLockExclusive(&m_lock);
+}
+
+void OsRwLock::unlock()
+{
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+void OsRwLock::lock_shared()
+{
+    AcquireSRWLockShared(&m_lock);
+}
+
+void OsRwLock::unlock_shared()
+{
+    ReleaseSRWLockShared(&m_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsCondVar::OsCondVar()
+{
+    InitializeConditionVariable(&m_cv);
+}
+
+OsCondVar::~OsCondVar()
+{
+}
+
+void OsCondVar::wait(OsMutex& mutex)
+{
+    SleepConditionVariableSRW(&m_cv, &mutex.m_lock, INFINITE, 0);
+}
+
+void OsCondVar::wake_one()
+{
+    WakeConditionVariable(&m_cv);
+}
+
+void OsCondVar::wake_all()
+{
+    WakeAllConditionVariable(&m_cv);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+OsFile::OsFile() : m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsFile::~OsFile()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::open(const os_char* path)
+{
+    close();
+    m_file = CreateFileW(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+        );
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create(const os_char* path)
+{
+    close();
+    m_file = CreateFileW(
+        path,
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+        );
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create_temp(const os_char* path)
+{
+    close();
+    m_file = CreateFileW(
+        path,
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+        nullptr
+        );
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::rewind()
+{
+    LARGE_INTEGER zero = {};
+    return SetFilePointerEx(m_file, zero, nullptr, FILE_BEGIN) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::create_mapped(
+    const os_char* path,
+    size_t len,
+    OsView& view,
+    uint8_t*& data
+    )
+{
+    close();
+    m_file = CreateFileW(
+        path,
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        0,
+        nullptr
+        );
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    const HANDLE mapping = CreateFileMappingW(
+        m_file,
+        nullptr,
+        PAGE_READWRITE,
+        static_cast<DWORD>(uint64_t(len) >> 32),
+        static_cast<DWORD>(len),
+        nullptr
+        );
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+    void* const base = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, len);
+    CloseHandle(mapping);
+    if (base == nullptr)
+    {
+        return false;
+    }
+    view.base = base;
+    view.len = len;
+    view.data = static_cast<const uint8_t*>(base);
+    data = static_cast<uint8_t*>(base);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::close()
+{
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::is_open() const
+{
+    return m_file != INVALID_HANDLE_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::read(void* buf, size_t len, size_t& num_read)
+{
+    // ReadFile takes at most 4 GB at once.
+    BYTE* dst = static_cast<BYTE*>(buf);
+    num_read = 0;
+    while (num_read < len)
+    {
+        const size_t rest = len - num_read;
+        const DWORD chunk = static_cast<DWORD>(
+            (rest > 0x40000000) ? 0x40000000 : rest
+            );
+        DWORD done = 0;
+        if (!ReadFile(m_file, dst + num_read, chunk, &done, nullptr))
+        {
+            return false;
+        }
+        if (done == 0)
+        {
+            break;
+        }
+        num_read += done;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::write(const void* buf, size_t len)
+{
+    const BYTE* src = static_cast<const BYTE*>(buf);
+    while (len)
+    {
+        const DWORD chunk = static_cast<DWORD>(
+            (len > 0x40000000) ? 0x40000000 : len
+            );
+        DWORD done = 0;
+        if (!WriteFile(m_file, src, chunk, &done, nullptr) || done == 0)
+        {
+            return false;
+        }
+        src += done;
+        len -= done;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::size(uint64_t& size)
+{
+    LARGE_INTEGER lsize;
+    if (!GetFileSizeEx(m_file, &lsize))
+    {
+        return false;
+    }
+    size = lsize.QuadPart;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::map(uint64_t pos, size_t len, OsView& view)
+{
+    if (m_mapping == nullptr)
+    {
+        m_mapping = CreateFileMappingW(
+            m_file,
+            nullptr,
+            PAGE_READONLY,
+            0,
+            0,
+            nullptr
+            );
+        if (m_mapping == nullptr)
+        {
+            return false;
+        }
+    }
+
+    // A view has to start at a multiple of the allocation granularity.
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    const uint64_t view_pos = pos - (pos % si.dwAllocationGranularity);
+    const size_t skip = static_cast<size_t>(pos - view_pos);
+    const void* base = MapViewOfFile(
+        m_mapping,
+        FILE_MAP_READ,
+        static_cast<DWORD>(view_pos >> 32),
+        static_cast<DWORD>(view_pos),
+        skip + len
+        );
+    if (base == nullptr)
+    {
+        return false;
+    }
+    view.base = base;
+    view.len = skip + len;
+    view.data = static_cast<const uint8_t*>(base) + skip;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::unmap(const OsView& view)
+{
+    if (view.base)
+    {
+        UnmapViewOfFile(view.base);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The declarations need _WIN32_WINNT >= 0x0602, so they are repeated here.
+struct PrefetchRange
+{
+    PVOID   address;
+    SIZE_T  size;
+};
+using PREFETCH_VM = BOOL(WINAPI*)(HANDLE, ULONG_PTR, PrefetchRange*, ULONG);
+
+static PREFETCH_VM prefetch_function()
+{
+    static const PREFETCH_VM function = reinterpret_cast<PREFETCH_VM>(
+        GetProcAddress(
+            GetModuleHandleW(L"kernel32.dll"),
+            "PrefetchVirtualMemory"
+            )
+        );
+    return function;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsFile::can_prefetch()
+{
+    return prefetch_function() != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsFile::prefetch(const OsView& view)
+{
+    const PREFETCH_VM prefetch_vm = prefetch_function();
+    if (prefetch_vm && view.base)
+    {
+        PrefetchRange range = { const_cast<void*>(view.base), view.len };
+        prefetch_vm(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+static void entry_from_data(
+    const WIN32_FIND_DATAW& data,
+    const os_char* name,
+    OsDirEntry& entry
+    )
+{
+    entry.name = name;
+    entry.size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    entry.write_time = (
+        (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) |
+        data.ftLastWriteTime.dwLowDateTime
+        );
+    entry.attributes = data.dwFileAttributes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirReader::OsDirReader() :
+    m_handle(INVALID_HANDLE_VALUE),
+    m_have_data(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirReader::~OsDirReader()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirReader::open(const os_char* dir)
+{
+    close();
+    const size_t len = lstrlenW(dir);
+    wchar_t* const pattern = static_cast<wchar_t*>(
+        malloc((len + 3) * sizeof(wchar_t))
+        );
+    if (pattern == nullptr)
+    {
+        return false;
+    }
+    memcpy(pattern, dir, len * sizeof(wchar_t));
+    size_t pos = len;
+    if (pos == 0 || (dir[pos - 1] != L'\\' && dir[pos - 1] != L'/'))
+    {
+        pattern[pos++] = L'\\';
+    }
+    pattern[pos++] = L'*';
+    pattern[pos] = 0;
+
+    m_handle = FindFirstFileExW(
+        pattern,
+        FindExInfoBasic,
+        &m_data,
+        FindExSearchNameMatch,
+        nullptr,
+        FIND_FIRST_EX_LARGE_FETCH
+        );
+    free(pattern);
+    m_have_data = (m_handle != INVALID_HANDLE_VALUE);
+    return m_have_data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirReader::close()
+{
+    if (m_handle != INVALID_HANDLE_VALUE)
+    {
+        FindClose(m_handle);
+        m_handle = INVALID_HANDLE_VALUE;
+    }
+    m_have_data = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirReader::next(OsDirEntry& entry)
+{
+    for (;;)
+    {
+        if (m_have_data)
+        {
+            m_have_data = false;
+        }
+        else if (
+            m_handle == INVALID_HANDLE_VALUE ||
+            !FindNextFileW(m_handle, &m_data)
+            )
+        {
+            return false;
+        }
+        const wchar_t* const n = m_data.cFileName;
+        if (n[0] != L'.' || (n[1] != 0 && (n[1] != L'.' || n[2] != 0)))
+        {
+            entry_from_data(m_data, n, entry);
+            return true;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_get_entry(const os_char* path, OsDirEntry& entry)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attr))
+    {
+        return false;
+    }
+    WIN32_FIND_DATAW data = {};
+    data.dwFileAttributes = attr.dwFileAttributes;
+    data.ftLastWriteTime = attr.ftLastWriteTime;
+    data.nFileSizeHigh = attr.nFileSizeHigh;
+    data.nFileSizeLow = attr.nFileSizeLow;
+    entry_from_data(data, nullptr, entry);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_delete_file(const os_char* path)
+{
+    return DeleteFileW(path) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_create_dir(const os_char* path)
+{
+    return (
+        CreateDirectoryW(path, nullptr) ||
+        GetLastError() == ERROR_ALREADY_EXISTS
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_delete_dir(const os_char* path)
+{
+    return RemoveDirectoryW(path) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_rename(const os_char* from, const os_char* to)
+{
+    return MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_copy_file(const os_char* from, const os_char* to)
+{
+    return CopyFileW(from, to, false) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_set_attributes(const os_char* path, uint32_t attributes)
+{
+    return SetFileAttributesW(path, attributes & ~OS_ATTR_DIRECTORY) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool os_local_midnight(
+    unsigned year,
+    unsigned month,
+    unsigned day,
+    uint64_t& time
+    )
+{
+    SYSTEMTIME st = {};
+    st.wYear = static_cast<WORD>(year);
+    st.wMonth = static_cast<WORD>(month);
+    st.wDay = static_cast<WORD>(day);
+    SYSTEMTIME utc;
+    FILETIME ft;
+    if (
+        !TzSpecificLocalTimeToSystemTime(nullptr, &st, &utc) ||
+        !SystemTimeToFileTime(&utc, &ft)
+        )
+    {
+        return false;
+    }
+    time = (uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t os_app_data_dir(os_char* buf, size_t len)
+{
+    const DWORD res = GetEnvironmentVariableW(
+        L"LOCALAPPDATA",
+        buf,
+        static_cast<DWORD>((len > MAXDWORD) ? MAXDWORD : len)
+        );
+    return (res < len) ? res : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Larger buffers are refused for directories on the network.
+static const DWORD MONITOR_BUF_SIZE = 64 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::OsDirMonitor() :
+    m_dir(INVALID_HANDLE_VALUE),
+    m_stop(nullptr),
+    m_done(nullptr),
+    m_buf(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::~OsDirMonitor()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool OsDirMonitor::open(const os_char* root)
+{
+    close();
+    m_dir = CreateFileW(
+        root,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr
+        );
+    m_stop = CreateEventW(nullptr, true, false, nullptr);
+    m_done = CreateEventW(nullptr, true, false, nullptr);
+    m_buf = static_cast<DWORD*>(malloc(MONITOR_BUF_SIZE));
+    if (
+        m_dir == INVALID_HANDLE_VALUE ||
+        m_stop == nullptr ||
+        m_done == nullptr ||
+        m_buf == nullptr
+        )
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirMonitor::close()
+{
+    if (m_dir != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_dir);
+        m_dir = INVALID_HANDLE_VALUE;
+    }
+    if (m_stop)
+    {
+        CloseHandle(m_stop);
+        m_stop = nullptr;
+    }
+    if (m_done)
+    {
+        CloseHandle(m_done);
+        m_done = nullptr;
+    }
+    free(m_buf);
+    m_buf = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+OsDirMonitor::Result OsDirMonitor::wait(NAME_CB cb, void* pctxt)
+{
+    const DWORD filter = (
+        FILE_NOTIFY_CHANGE_FILE_NAME |
+        FILE_NOTIFY_CHANGE_DIR_NAME |
+        FILE_NOTIFY_CHANGE_SIZE |
+        FILE_NOTIFY_CHANGE_LAST_WRITE |
+        FILE_NOTIFY_CHANGE_CREATION
+        );
+    OVERLAPPED ovl = {};
+    ovl.hEvent = m_done;
+    ResetEvent(m_done);
+    if (
+        !ReadDirectoryChangesW(
+            m_dir,
+            m_buf,
+            MONITOR_BUF_SIZE,
+            true,
+            filter,
+            nullptr,
+            &ovl,
+            nullptr
+            )
+        )
+    {
+        return FAILED;
+    }
+    const HANDLE events[] = { m_stop, m_done };
+    DWORD len = 0;
+    if (WaitForMultipleObjects(2, events, false, INFINITE) != WAIT_OBJECT_0 + 1)
+    {
+        CancelIo(m_dir);
+        GetOverlappedResult(m_dir, &ovl, &len, true);
+        return STOPPED;
+    }
+    if (!GetOverlappedResult(m_dir, &ovl, &len, false))
+    {
+        return (GetLastError() == ERROR_NOTIFY_ENUM_DIR) ? LOST : FAILED;
+    }
+    if (len == 0)
+    {
+        // the buffer was too small
+        return LOST;
+    }
+    const BYTE* const buf = reinterpret_cast<const BYTE*>(m_buf);
+    for (DWORD pos = 0; pos < len; )
+    {
+        const FILE_NOTIFY_INFORMATION* info = (
+            reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buf + pos)
+            );
+        cb(pctxt, info->FileName, info->FileNameLength / sizeof(WCHAR));
+        if (info->NextEntryOffset == 0)
+        {
+            break;
+        }
+        pos += info->NextEntryOffset;
+    }
+    return CHANGES;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void OsDirMonitor::stop()
+{
+    SetEvent(m_stop);
+}
+
+////////////////////////////////////////////////////////////////////////////////
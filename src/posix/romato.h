@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+//
+// Stands in for romato (the submodule src\romato), which needs Windows,
+// where Windows is not available. It only has what the search and -cli
+// need (see bld_test.py): the types and constants of Windows they are
+// written with, TRACE, p2p, the containers and Yast. Everything that has
+// to ask the system goes through platform.h.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include "../platform.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The integers have the widths of Windows (LLP64).
+using BYTE = uint8_t;
+using WORD = uint16_t;
+using USHORT = uint16_t;
+using DWORD = uint32_t;
+using UINT = unsigned int;
+using INT = int;
+using LONG = int32_t;
+using ULONG = uint32_t;
+using LONGLONG = int64_t;
+using ULONGLONG = uint64_t;
+using UINT_PTR = uintptr_t;
+using BOOL = int;
+
+using CHAR = char;
+using PSTR = char*;
+using PCSTR = const char*;
+using WCHAR = os_char;
+using PWSTR = WCHAR*;
+using PCWSTR = const WCHAR*;
+
+#define TRUE 1
+#define FALSE 0
+
+#define MAXDWORD 0xffffffff
+#define MAXLONG 0x7fffffff
+#define MAX_PATH 260
+
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define CP_ACP OS_CP_ANSI
+#define CP_UTF8 OS_CP_UTF8
+
+// The attributes, that platform.h does not know, are never set here.
+#define FILE_ATTRIBUTE_READONLY OS_ATTR_READONLY
+#define FILE_ATTRIBUTE_HIDDEN OS_ATTR_HIDDEN
+#define FILE_ATTRIBUTE_SYSTEM OS_ATTR_SYSTEM
+#define FILE_ATTRIBUTE_DIRECTORY OS_ATTR_DIRECTORY
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x400
+#define FILE_ATTRIBUTE_OFFLINE 0x1000
+#define FILE_ATTRIBUTE_RECALL_ON_DATA_ACCESS 0x400000
+
+// Traces are only written by the Windows build.
+#define TRACE(...) ((void)0)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// pointer to pointer cast
+template <typename T, typename S> inline T p2p(S s)
+{
+    return reinterpret_cast<T>(s);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include "container.h"
+#include "yast.h"
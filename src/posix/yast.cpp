@@ -0,0 +1,451 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+#include "romato.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast::Yast() : m_buf(1, 0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast::Yast(PCWSTR str) : m_buf(1, 0)
+{
+    if (str)
+    {
+        append(str, os_strlen(str));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast::Yast(PCWSTR str, UINT len) : m_buf(1, 0)
+{
+    append(str, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast::Yast(UINT len) : m_buf(size_t(len) + 1, 0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast::Yast(UINT len, PCSTR str, UINT cp) : m_buf(1, 0)
+{
+    const size_t num = os_to_utf16(cp, str, len, nullptr, 0, false);
+    if (num && num <= MAX_LEN)
+    {
+        m_buf.resize(num + 1);
+        os_to_utf16(cp, str, len, &m_buf[0], num, false);
+        m_buf[num] = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast& Yast::operator=(PCWSTR str)
+{
+    if (str < &m_buf[0] || str >= &m_buf[0] + m_buf.size())
+    {
+        clear();
+        if (str)
+        {
+            append(str, os_strlen(str));
+        }
+    }
+    else
+    {
+        *this = Yast(str);
+    }
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Yast::append(PCWSTR str, size_t len)
+{
+    m_buf.insert(m_buf.end() - 1, str, str + len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast& Yast::operator+=(const Yast& other)
+{
+    if (&other == this)
+    {
+        return *this += Yast(other);
+    }
+    append(other.str(), other.length());
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast& Yast::operator+=(PCWSTR str)
+{
+    return *this += Yast(str);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast& Yast::operator+=(WCHAR c)
+{
+    append(&c, 1);
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Yast::format(PCWSTR fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vformat(fmt, args);
+    va_end(args);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Appends the digits of value with the flags and the width of a format.
+static void put_number(
+    cvector<WCHAR>& out,
+    uint64_t value,
+    bool negative,
+    unsigned base,
+    bool upper,
+    bool left,
+    WCHAR pad,
+    size_t width
+    )
+{
+    static const char DIGITS[] = "0123456789abcdef0123456789ABCDEF";
+    WCHAR digits[24];
+    size_t num = 0;
+    do
+    {
+        digits[num++] = DIGITS[(value % base) + (upper ? 16 : 0)];
+        value /= base;
+    }
+    while (value);
+    const size_t len = num + (negative ? 1 : 0);
+    const size_t fill = (width > len) ? width - len : 0;
+    if (!left && pad == ' ')
+    {
+        out.insert(out.end(), fill, ' ');
+    }
+    if (negative)
+    {
+        out.push_back('-');
+    }
+    if (!left && pad == '0')
+    {
+        out.insert(out.end(), fill, '0');
+    }
+    while (num)
+    {
+        out.push_back(digits[--num]);
+    }
+    if (left)
+    {
+        out.insert(out.end(), fill, ' ');
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Yast::vformat(PCWSTR fmt, va_list args)
+{
+    cvector<WCHAR> out;
+    while (*fmt)
+    {
+        if (*fmt != '%')
+        {
+            out.push_back(*fmt++);
+            continue;
+        }
+        ++fmt;
+        bool left = false;
+        WCHAR pad = ' ';
+        for (;; ++fmt)
+        {
+            if (*fmt == '-')
+            {
+                left = true;
+            }
+            else if (*fmt == '0')
+            {
+                pad = '0';
+            }
+            else
+            {
+                break;
+            }
+        }
+        size_t width = 0;
+        while (*fmt >= '0' && *fmt <= '9')
+        {
+            width = 10 * width + (*fmt++ - '0');
+        }
+        bool wide_int = false;
+        if (fmt[0] == 'I' && fmt[1] == '6' && fmt[2] == '4')
+        {
+            wide_int = true;
+            fmt += 3;
+        }
+        else if (*fmt == 'l' || *fmt == 'h')
+        {
+            ++fmt;
+        }
+        const WCHAR conv = *fmt;
+        if (conv)
+        {
+            ++fmt;
+        }
+        switch (conv)
+        {
+            case 'd':
+            case 'i':
+            {
+                const int64_t value = wide_int ?
+                    va_arg(args, int64_t) :
+                    va_arg(args, int);
+                put_number(
+                    out,
+                    (value < 0) ? 0 - uint64_t(value) : uint64_t(value),
+                    value < 0,
+                    10,
+                    false,
+                    left,
+                    pad,
+                    width
+                    );
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            case 'X':
+            {
+                const uint64_t value = wide_int ?
+                    va_arg(args, uint64_t) :
+                    va_arg(args, unsigned);
+                put_number(
+                    out,
+                    value,
+                    false,
+                    (conv == 'u') ? 10 : 16,
+                    conv == 'X',
+                    left,
+                    pad,
+                    width
+                    );
+                break;
+            }
+
+            case 'c':
+                out.push_back(static_cast<WCHAR>(va_arg(args, int)));
+                break;
+
+            case 's':
+            case 'S':
+            {
+                Yast str;
+                if (conv == 's')
+                {
+                    str = va_arg(args, PCWSTR);
+                }
+                else
+                {
+                    PCSTR narrow = va_arg(args, PCSTR);
+                    const UINT len = static_cast<UINT>(strlen(narrow));
+                    str = Yast(len, narrow, CP_ACP);
+                }
+                const size_t fill = (width > str.length()) ?
+                    width - str.length() :
+                    0;
+                if (!left)
+                {
+                    out.insert(out.end(), fill, ' ');
+                }
+                out.insert(out.end(), str.str(), str.str() + str.length());
+                if (left)
+                {
+                    out.insert(out.end(), fill, ' ');
+                }
+                break;
+            }
+
+            case '%':
+                out.push_back('%');
+                break;
+
+            default:
+                break;
+        }
+    }
+    out.push_back(0);
+    m_buf.swap(out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int Yast::find(int start, PCWSTR sub) const
+{
+    const size_t len = length();
+    const size_t sub_len = os_strlen(sub);
+    if (start < 0 || sub_len > len)
+    {
+        return -1;
+    }
+    for (size_t pos = start; pos + sub_len <= len; ++pos)
+    {
+        if (memcmp(&m_buf[pos], sub, sub_len * sizeof(WCHAR)) == 0)
+        {
+            return static_cast<int>(pos);
+        }
+    }
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast Yast::slice(int begin, int end) const
+{
+    const int len = static_cast<int>(length());
+    if (begin < 0)
+    {
+        begin += len + 1;
+    }
+    if (end < 0)
+    {
+        end += len + 1;
+    }
+    begin = (begin < 0) ? 0 : (begin > len) ? len : begin;
+    end = (end < begin) ? begin : (end > len) ? len : end;
+    return Yast(str() + begin, static_cast<UINT>(end - begin));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast Yast::replace(PCWSTR old_str, PCWSTR new_str) const
+{
+    const int old_len = static_cast<int>(os_strlen(old_str));
+    if (old_len == 0)
+    {
+        return *this;
+    }
+    Yast result;
+    int pos = 0;
+    for (int hit; (hit = find(pos, old_str)) >= 0; pos = hit + old_len)
+    {
+        result.append(str() + pos, hit - pos);
+        result += new_str;
+    }
+    result.append(str() + pos, length() - pos);
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+YastVector Yast::split(PCWSTR sep) const
+{
+    YastVector parts;
+    const int sep_len = static_cast<int>(os_strlen(sep));
+    int pos = 0;
+    for (int hit; sep_len && (hit = find(pos, sep)) >= 0; pos = hit + sep_len)
+    {
+        parts.push_back(Yast(str() + pos, hit - pos));
+    }
+    parts.push_back(Yast(str() + pos, length() - pos));
+    return parts;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Yast::to_lower()
+{
+    os_to_lower(&m_buf[0], length());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast operator+(const Yast& a, const Yast& b)
+{
+    Yast result(a);
+    result += b;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast operator+(const Yast& a, PCWSTR b)
+{
+    Yast result(a);
+    result += b;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast operator+(PCWSTR a, const Yast& b)
+{
+    Yast result(a);
+    result += b;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+CharFromW::CharFromW(UINT cp, PCWSTR str) : m_cp(cp), m_buf(1, 0)
+{
+    if (str)
+    {
+        *this = str;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+CharFromW& CharFromW::operator=(PCWSTR str)
+{
+    const size_t len = os_strlen(str);
+    const size_t num = os_from_utf16(m_cp, str, len, nullptr, 0);
+    m_buf.resize(num + 1);
+    os_from_utf16(m_cp, str, len, &m_buf[0], num);
+    m_buf[num] = 0;
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
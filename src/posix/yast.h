@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+#pragma once
+
+//
+// The string class of romato: UTF-16 that is always terminated by 0, with
+// a length of 32 bits. Positions and lengths are given in code units.
+//
+
+#include <stdarg.h>
+
+class Yast;
+using YastVector = cvector<Yast>;
+
+class Yast
+{
+public:
+    static const UINT MAX_LEN = MAXLONG;
+
+    Yast();
+    Yast(PCWSTR str);
+    Yast(PCWSTR str, UINT len);
+
+    // len characters, that are all 0
+    explicit Yast(UINT len);
+
+    // converted from len bytes in the code page cp
+    Yast(UINT len, PCSTR str, UINT cp);
+
+    Yast& operator=(PCWSTR str);
+
+    PCWSTR str() const
+    {
+        return &m_buf[0];
+    }
+
+    operator PCWSTR() const
+    {
+        return str();
+    }
+
+    UINT length() const
+    {
+        return static_cast<UINT>(m_buf.size() - 1);
+    }
+
+    UINT byte_length() const
+    {
+        return length() * sizeof(WCHAR);
+    }
+
+    bool is_empty() const
+    {
+        return m_buf.size() == 1;
+    }
+
+    void clear()
+    {
+        m_buf.assign(1, 0);
+    }
+
+    // Makes it len characters long, that are all 0.
+    void clear(UINT len)
+    {
+        m_buf.assign(size_t(len) + 1, 0);
+    }
+
+    Yast& operator+=(const Yast& other);
+    Yast& operator+=(PCWSTR str);
+    Yast& operator+=(WCHAR c);
+
+    // Like wsprintf: %s takes a PCWSTR, %S a PCSTR and %I64 is the prefix
+    // of 64 bit integers.
+    void format(PCWSTR fmt, ...);
+    void vformat(PCWSTR fmt, va_list args);
+
+    // The position of sub at or after start or -1.
+    int find(int start, PCWSTR sub) const;
+
+    // The part from begin up to end. Negative positions count from the
+    // end, -1 being the end itself.
+    Yast slice(int begin, int end) const;
+
+    Yast replace(PCWSTR old_str, PCWSTR new_str) const;
+    YastVector split(PCWSTR sep) const;
+    void to_lower();
+
+    // Same code units, without regard to case or normalization.
+    bool binary_same(const Yast& other) const
+    {
+        return m_buf == other.m_buf;
+    }
+
+    bool operator==(const Yast& other) const
+    {
+        return m_buf == other.m_buf;
+    }
+
+    bool operator!=(const Yast& other) const
+    {
+        return m_buf != other.m_buf;
+    }
+
+    bool operator<(const Yast& other) const
+    {
+        return m_buf < other.m_buf;
+    }
+
+private:
+    void append(PCWSTR str, size_t len);
+
+    cvector<WCHAR> m_buf;
+};
+
+Yast operator+(const Yast& a, const Yast& b);
+Yast operator+(const Yast& a, PCWSTR b);
+Yast operator+(PCWSTR a, const Yast& b);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Converts UTF-16 to a code page.
+class CharFromW
+{
+public:
+    CharFromW(UINT cp, PCWSTR str);
+    CharFromW& operator=(PCWSTR str);
+
+    PCSTR str() const
+    {
+        return &m_buf[0];
+    }
+
+    UINT length() const
+    {
+        return static_cast<UINT>(m_buf.size() - 1);
+    }
+
+private:
+    UINT m_cp;
+    cvector<char> m_buf;
+};
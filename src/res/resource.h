@@ -79,6 +79,8 @@
 #define IDC_COPY_CSV_RESULT             1039
 #define IDC_VIEWER_CMD                  1040
 #define IDC_CSV_SEP                     1041
+#define IDC_NUM_WORKERS                 1042
+#define IDC_RADIO_LIST                  1043
 
 // Next default values for new objects
 //
@@ -0,0 +1,610 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "pch.h"
+#include "result_cache.h"
+#include "search_thread.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Layout of a cache file. Every record starts at a multiple of 8 bytes:
+//
+//      CacheHeader
+//      for every entry, least recently used first:
+//          CacheRecord
+//          LineInfo    lines[num_lines]
+//          WCHAR       path[path_len]
+//          WCHAR       text[text_len]      padded to a multiple of 8 bytes
+//
+struct CacheHeader
+{
+    DWORD       magic;
+    DWORD       version;
+    UINT        num_entries;
+    UINT        line_info_size;         // differs between 32 and 64 bit
+};
+
+struct CacheRecord
+{
+    ULONGLONG   query;
+    ULONGLONG   size;
+    ULONGLONG   write_time;
+    ULONGLONG   matches;
+    UINT        num_lines;
+    UINT        text_len;
+    UINT        path_len;
+    UINT        encoding;
+};
+
+static const DWORD CACHE_MAGIC = 0x43524752;    // "RGRC"
+static const DWORD CACHE_VERSION = 1;
+
+static const size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+// has to be a power of two
+static const size_t MIN_BUCKETS = 1024;
+
+// Results that would take more than this part of the capacity are not kept.
+static const size_t MAX_ENTRY_PART = 16;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline size_t padded(size_t len)
+{
+    return (len + 7) & ~size_t(7);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline ULONGLONG entry_hash(const Yast& path, ULONGLONG query)
+{
+    return fnv1a(path.str(), path.length() * sizeof(WCHAR), query);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Writes a file in large blocks.
+class BlockWriter
+{
+public:
+    BlockWriter(OsFile& file) : m_file(file), m_total(0), m_ok(true)
+    {
+        m_buf.reserve(BLOCK_SIZE);
+    }
+
+    void write(const void* data, size_t size)
+    {
+        const BYTE* bytes = p2p<const BYTE*>(data);
+        m_buf.insert(m_buf.end(), bytes, bytes + size);
+        if (m_buf.size() >= BLOCK_SIZE)
+        {
+            flush();
+        }
+    }
+
+    void pad()
+    {
+        static const BYTE zeros[8] = {};
+        write(zeros, padded(m_total + m_buf.size()) - m_total - m_buf.size());
+    }
+
+    bool flush()
+    {
+        m_ok = m_ok && (
+            m_buf.size() == 0 ||
+            m_file.write(&m_buf[0], m_buf.size())
+            );
+        m_total += m_buf.size();
+        m_buf.clear();
+        return m_ok;
+    }
+
+private:
+    static const size_t BLOCK_SIZE = 1024 * 1024;
+
+    OsFile& m_file;
+    cvector<BYTE> m_buf;
+    ULONGLONG m_total;
+    bool m_ok;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+ResultCache::ResultCache() :
+    m_head(NONE),
+    m_tail(NONE),
+    m_count(0),
+    m_used(0),
+    m_capacity(DEFAULT_CAPACITY),
+    m_modified(false)
+{
+    rehash(MIN_BUCKETS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResultCache::~ResultCache()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::set_capacity(size_t bytes)
+{
+    m_lock.lock();
+    m_capacity = bytes;
+    while (m_used > m_capacity && m_tail != NONE)
+    {
+        remove(m_tail);
+    }
+    m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::lookup(
+    const Yast& path,
+    const FileStamp& stamp,
+    ULONGLONG query,
+    SearchResult& result,
+    size_t& matches
+    )
+{
+    bool found = false;
+    m_lock.lock();
+    const UINT idx = find(path, entry_hash(path, query), query);
+    if (idx != NONE)
+    {
+        Entry& entry = m_entries[idx];
+        if (
+            entry.stamp.size != stamp.size ||
+            entry.stamp.write_time != stamp.write_time
+            )
+        {
+            // will be searched and inserted again
+            remove(idx);
+        }
+        else
+        {
+            matches = entry.matches;
+            if (matches)
+            {
+                result.path = entry.path;
+                result.line_info = entry.line_info;
+                result.line_text = entry.line_text;
+                result.encoding = entry.encoding;
+            }
+            unlink(idx);
+            link_front(idx);
+            found = true;
+        }
+    }
+    m_lock.unlock();
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::contains(
+    const Yast& path,
+    const FileStamp& stamp,
+    ULONGLONG query
+    )
+{
+    m_lock.lock();
+    const UINT idx = find(path, entry_hash(path, query), query);
+    const bool found = (
+        idx != NONE &&
+        m_entries[idx].stamp.size == stamp.size &&
+        m_entries[idx].stamp.write_time == stamp.write_time
+        );
+    m_lock.unlock();
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::insert(
+    const Yast& path,
+    const FileStamp& stamp,
+    ULONGLONG query,
+    const SearchResult& result,
+    size_t matches
+    )
+{
+    static const LineInfos no_lines;
+    static const LineText no_text;
+    m_lock.lock();
+    const UINT idx = find(path, entry_hash(path, query), query);
+    if (idx != NONE)
+    {
+        remove(idx);
+    }
+    add(
+        path,
+        query,
+        stamp,
+        matches,
+        matches ? result.line_info : no_lines,
+        matches ? result.line_text : no_text,
+        result.encoding
+        );
+    m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::clear()
+{
+    m_lock.lock();
+    m_entries.clear();
+    m_free.clear();
+    m_head = m_tail = NONE;
+    rehash(MIN_BUCKETS);
+    m_count = m_used = 0;
+    m_modified = false;
+    m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::is_empty()
+{
+    m_lock.lock_shared();
+    const bool empty = m_count == 0;
+    m_lock.unlock_shared();
+    return empty;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::is_modified()
+{
+    m_lock.lock_shared();
+    const bool modified = m_modified;
+    m_lock.unlock_shared();
+    return modified;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::load(const Yast& path)
+{
+    OsFile file;
+    uint64_t size = 0;
+    OsView mapping = {};
+    if (
+        !file.open(path) ||
+        !file.size(size) ||
+        size < sizeof(CacheHeader) ||
+        size > SIZE_MAX ||
+        !file.map(0, static_cast<size_t>(size), mapping)
+        )
+    {
+        return false;
+    }
+    file.close();
+    const BYTE* const view = mapping.data;
+
+    const CacheHeader* hdr = p2p<const CacheHeader*>(view);
+    bool ok = (
+        hdr->magic == CACHE_MAGIC &&
+        hdr->version == CACHE_VERSION &&
+        hdr->line_info_size == sizeof(LineInfo)
+        );
+    const size_t total = static_cast<size_t>(size);
+    size_t pos = padded(sizeof(CacheHeader));
+    LineInfos line_info;
+    LineText line_text;
+    m_lock.lock();
+    for (UINT i = 0; ok && i < hdr->num_entries; ++i)
+    {
+        const CacheRecord* rec = p2p<const CacheRecord*>(view + pos);
+        ok = total - pos >= sizeof(CacheRecord);
+        const size_t lines_size = ok ? rec->num_lines * sizeof(LineInfo) : 0;
+        const size_t len = ok ? size_t(rec->path_len) + rec->text_len : 0;
+        const size_t rec_size = padded(
+            sizeof(CacheRecord) + lines_size + len * sizeof(WCHAR)
+            );
+        ok = ok && total - pos >= rec_size;
+        if (!ok)
+        {
+            break;
+        }
+        const BYTE* p = view + pos + sizeof(CacheRecord);
+        const LineInfo* lines = p2p<const LineInfo*>(p);
+        PCWSTR const name = p2p<PCWSTR>(p + lines_size);
+        line_info.clear();
+        line_info.insert(line_info.end(), lines, lines + rec->num_lines);
+        line_text.clear();
+        line_text.insert(
+            line_text.end(),
+            name + rec->path_len,
+            name + rec->path_len + rec->text_len
+            );
+        const Yast file_name(name, rec->path_len);
+        const FileStamp stamp = { rec->size, rec->write_time };
+        const UINT idx = find(
+            file_name,
+            entry_hash(file_name, rec->query),
+            rec->query
+            );
+        if (idx != NONE)
+        {
+            remove(idx);
+        }
+        add(
+            file_name,
+            rec->query,
+            stamp,
+            static_cast<size_t>(rec->matches),
+            line_info,
+            line_text,
+            static_cast<TextEncoding>(rec->encoding)
+            );
+        pos += rec_size;
+    }
+    m_modified = false;
+    m_lock.unlock();
+    OsFile::unmap(mapping);
+    TRACE("result cache '%S': %s\n", path.str(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultCache::store(const Yast& path)
+{
+    const Yast new_path(path + L".new");
+    OsFile file;
+    if (!file.create(new_path))
+    {
+        return false;
+    }
+
+    m_lock.lock();
+    BlockWriter out(file);
+    const CacheHeader hdr = {
+        CACHE_MAGIC,
+        CACHE_VERSION,
+        static_cast<UINT>(m_count),
+        sizeof(LineInfo)
+        };
+    out.write(&hdr, sizeof(hdr));
+    out.pad();
+    for (UINT idx = m_tail; idx != NONE; idx = m_entries[idx].prev)
+    {
+        const Entry& entry = m_entries[idx];
+        const CacheRecord rec = {
+            entry.query,
+            entry.stamp.size,
+            entry.stamp.write_time,
+            entry.matches,
+            static_cast<UINT>(entry.line_info.size()),
+            static_cast<UINT>(entry.line_text.size()),
+            entry.path.length(),
+            static_cast<UINT>(entry.encoding)
+            };
+        out.write(&rec, sizeof(rec));
+        if (entry.line_info.size())
+        {
+            out.write(
+                &entry.line_info[0],
+                entry.line_info.size() * sizeof(LineInfo)
+                );
+        }
+        out.write(entry.path.str(), entry.path.length() * sizeof(WCHAR));
+        if (entry.line_text.size())
+        {
+            out.write(
+                &entry.line_text[0],
+                entry.line_text.size() * sizeof(WCHAR)
+                );
+        }
+        out.pad();
+    }
+    bool ok = out.flush();
+    if (ok)
+    {
+        m_modified = false;
+    }
+    m_lock.unlock();
+
+    file.close();
+    ok = ok && os_rename(new_path, path);
+    if (!ok)
+    {
+        os_delete_file(new_path);
+    }
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT ResultCache::find(const Yast& path, ULONGLONG hash, ULONGLONG query)
+{
+    UINT idx = m_buckets[hash & (m_buckets.size() - 1)];
+    while (idx != NONE)
+    {
+        const Entry& entry = m_entries[idx];
+        if (entry.hash == hash && entry.query == query && entry.path == path)
+        {
+            break;
+        }
+        idx = entry.chain;
+    }
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::unlink(UINT idx)
+{
+    Entry& entry = m_entries[idx];
+    if (entry.prev != NONE)
+    {
+        m_entries[entry.prev].next = entry.next;
+    }
+    else
+    {
+        m_head = entry.next;
+    }
+    if (entry.next != NONE)
+    {
+        m_entries[entry.next].prev = entry.prev;
+    }
+    else
+    {
+        m_tail = entry.prev;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::link_front(UINT idx)
+{
+    Entry& entry = m_entries[idx];
+    entry.prev = NONE;
+    entry.next = m_head;
+    if (m_head != NONE)
+    {
+        m_entries[m_head].prev = idx;
+    }
+    else
+    {
+        m_tail = idx;
+    }
+    m_head = idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::remove(UINT idx)
+{
+    Entry& entry = m_entries[idx];
+    unlink(idx);
+    UINT* link = &m_buckets[entry.hash & (m_buckets.size() - 1)];
+    while (*link != idx)
+    {
+        link = &m_entries[*link].chain;
+    }
+    *link = entry.chain;
+
+    m_used -= entry.bytes;
+    m_count--;
+    entry.path = Yast();
+    entry.line_info = LineInfos();
+    entry.line_text = LineText();
+    m_free.push_back(idx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::rehash(size_t num_buckets)
+{
+    m_buckets.resize(num_buckets);
+    for (UINT& bucket : m_buckets)
+    {
+        bucket = NONE;
+    }
+    for (UINT idx = m_head; idx != NONE; idx = m_entries[idx].next)
+    {
+        Entry& entry = m_entries[idx];
+        UINT& bucket = m_buckets[entry.hash & (num_buckets - 1)];
+        entry.chain = bucket;
+        bucket = idx;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultCache::add(
+    const Yast& path,
+    ULONGLONG query,
+    const FileStamp& stamp,
+    size_t matches,
+    const LineInfos& line_info,
+    const LineText& line_text,
+    TextEncoding encoding
+    )
+{
+    // Has to be called with m_lock being held.
+    const size_t bytes = (
+        sizeof(Entry) +
+        path.length() * sizeof(WCHAR) +
+        line_info.size() * sizeof(LineInfo) +
+        line_text.size() * sizeof(WCHAR)
+        );
+    if (bytes > m_capacity / MAX_ENTRY_PART)
+    {
+        return;
+    }
+    while (m_used + bytes > m_capacity && m_tail != NONE)
+    {
+        remove(m_tail);
+    }
+
+    UINT idx;
+    if (m_free.size())
+    {
+        idx = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        idx = static_cast<UINT>(m_entries.size());
+        m_entries.resize(m_entries.size() + 1);
+    }
+    Entry& entry = m_entries[idx];
+    entry.path = path;
+    entry.hash = entry_hash(path, query);
+    entry.query = query;
+    entry.stamp = stamp;
+    entry.matches = matches;
+    entry.bytes = bytes;
+    entry.line_info = line_info;
+    entry.line_text = line_text;
+    entry.encoding = encoding;
+    UINT& bucket = m_buckets[entry.hash & (m_buckets.size() - 1)];
+    entry.chain = bucket;
+    bucket = idx;
+    link_front(idx);
+
+    m_used += bytes;
+    m_count++;
+    m_modified = true;
+    if (m_count > m_buckets.size())
+    {
+        rehash(2 * m_buckets.size());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "rgrep_util.h"
+#include "platform.h"
+
+struct SearchResult;
+
+// What identifies the content of a file without reading it.
+struct FileStamp
+{
+    ULONGLONG size;
+    ULONGLONG write_time;
+
+    static FileStamp from(const OsDirEntry& info)
+    {
+        return FileStamp { info.size, info.write_time };
+    }
+};
+
+//
+// Remembers what searching a file has found, including that nothing was
+// found. An entry is identified by the path and a hash of the query, and
+// it is only used as long as the FileStamp of the file is unchanged. So a
+// repeated search of an unchanged tree does not read any file. The memory
+// used by the entries is limited; the least recently used ones are
+// dropped first. All methods may be called by several threads at once.
+//
+// The entries can be stored in a file and loaded again. That file is only
+// a snapshot of the entries in memory, that is written at the end of a
+// search: it is read through a mapped view, but every entry is copied to
+// memory by load() and the view is released again. It is not a second
+// tier for the entries that get dropped, those are lost. The file contains
+// the entries in the order of their last use, so loading a file that is
+// larger than the capacity keeps the most recent ones.
+//
+class ResultCache
+{
+public:
+    ResultCache();
+    ~ResultCache();
+
+    void set_capacity(size_t bytes);
+
+    // Fills line_info, line_text, encoding and path of result, if the file
+    // has been searched with the same query before and is unchanged.
+    // matches is 0 if nothing was found then.
+    bool lookup(
+        const Yast& path,
+        const FileStamp& stamp,
+        ULONGLONG query,
+        SearchResult& result,
+        size_t& matches
+        );
+
+    // Like lookup, but without copying anything or marking the entry as
+    // used.
+    bool contains(
+        const Yast& path,
+        const FileStamp& stamp,
+        ULONGLONG query
+        );
+
+    // Only the lines of result are used and only if matches is not 0.
+    void insert(
+        const Yast& path,
+        const FileStamp& stamp,
+        ULONGLONG query,
+        const SearchResult& result,
+        size_t matches
+        );
+
+    void clear();
+
+    bool is_empty();
+
+    // Whether entries have been added since the last load or store.
+    bool is_modified();
+
+    bool load(const Yast& path);
+    bool store(const Yast& path);
+
+private:
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    struct Entry
+    {
+        Yast            path;
+        ULONGLONG       hash;           // of path and query
+        ULONGLONG       query;
+        FileStamp       stamp;
+        size_t          matches;
+        size_t          bytes;          // memory used by this entry
+        LineInfos       line_info;
+        LineText        line_text;
+        TextEncoding    encoding;
+        UINT            prev;           // more recently used
+        UINT            next;           // less recently used
+        UINT            chain;          // next entry in the same bucket
+    };
+
+    static const UINT NONE = ~0u;
+
+    UINT find(const Yast& path, ULONGLONG hash, ULONGLONG query);
+    void unlink(UINT idx);
+    void link_front(UINT idx);
+    void remove(UINT idx);
+    void rehash(size_t num_buckets);
+    void add(
+        const Yast& path,
+        ULONGLONG query,
+        const FileStamp& stamp,
+        size_t matches,
+        const LineInfos& line_info,
+        const LineText& line_text,
+        TextEncoding encoding
+        );
+
+    OsRwLock        m_lock;
+    cvector<Entry>  m_entries;
+    cvector<UINT>   m_free;             // unused entries
+    cvector<UINT>   m_buckets;          // first entry per hash bucket
+    UINT            m_head;             // most recently used
+    UINT            m_tail;             // least recently used
+    size_t          m_count;
+    size_t          m_used;             // bytes
+    size_t          m_capacity;         // bytes
+    bool            m_modified;
+};
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "result_store.h"
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TextArena::add_chunk(size_t len)
+{
+    wchar_t** chunks = static_cast<wchar_t**>(
+        realloc(m_chunks, (m_num_chunks + 1) * sizeof(wchar_t*))
+        );
+    if (chunks == nullptr)
+    {
+        return false;
+    }
+    m_chunks = chunks;
+    wchar_t* chunk = static_cast<wchar_t*>(malloc(len * sizeof(wchar_t)));
+    if (chunk == nullptr)
+    {
+        return false;
+    }
+    m_chunks[m_num_chunks++] = chunk;
+    m_bytes += len * sizeof(wchar_t);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t TextArena::append(const wchar_t* text, unsigned& len)
+{
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (len > CHUNK_LEN)
+    {
+        // The text starts at the beginning of its own chunk, so at() finds
+        // it like any other. The current chunk stays the same.
+        if (!add_chunk(len))
+        {
+            len = 0;
+            return 0;
+        }
+        memcpy(m_chunks[m_num_chunks - 1], text, len * sizeof(wchar_t));
+        return (m_num_chunks - 1) * CHUNK_LEN;
+    }
+    if (len > CHUNK_LEN - m_used)
+    {
+        if (!add_chunk(CHUNK_LEN))
+        {
+            len = 0;
+            return 0;
+        }
+        m_current = m_num_chunks - 1;
+        m_used = 0;
+    }
+    const size_t pos = m_current * CHUNK_LEN + m_used;
+    memcpy(m_chunks[m_current] + m_used, text, len * sizeof(wchar_t));
+    m_used += len;
+    return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TextArena::clear()
+{
+    for (size_t i = 0; i < m_num_chunks; ++i)
+    {
+        free(m_chunks[i]);
+    }
+    free(m_chunks);
+    m_chunks = nullptr;
+    m_num_chunks = m_current = 0;
+    m_used = CHUNK_LEN;
+    m_bytes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultStore::clear()
+{
+    m_files.clear();
+    m_file.clear();
+    m_line.clear();
+    m_text_pos.clear();
+    m_text_len.clear();
+    m_pattern.clear();
+    m_text.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t ResultStore::bytes() const
+{
+    return (
+        m_files.bytes() +
+        m_file.bytes() +
+        m_line.bytes() +
+        m_text_pos.bytes() +
+        m_text_len.bytes() +
+        m_pattern.bytes() +
+        m_text.bytes()
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unsigned ResultStore::add_file(
+    const wchar_t* path,
+    unsigned path_len,
+    unsigned path_prefix_len,
+    int encoding
+    )
+{
+    // The zero is copied too, so that path() can be passed on as it is.
+    unsigned len = path_len + 1;
+    const size_t pos = m_text.append(path, len);
+    if (len != path_len + 1 || !m_files.reserve_one())
+    {
+        return NO_FILE;
+    }
+    m_files.push_back(File { pos, path_prefix_len, encoding });
+    return static_cast<unsigned>(m_files.size() - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultStore::add_row(
+    unsigned long long line,
+    unsigned pattern,
+    const wchar_t* text,
+    unsigned len
+    )
+{
+    // All columns get the same size, so the row is either added to all of
+    // them or to none.
+    if (
+        !m_file.reserve_one() ||
+        !m_line.reserve_one() ||
+        !m_text_pos.reserve_one() ||
+        !m_text_len.reserve_one() ||
+        !m_pattern.reserve_one()
+        )
+    {
+        return false;
+    }
+    unsigned copied = len;
+    const size_t pos = m_text.append(text, copied);
+    if (copied != len)
+    {
+        return false;
+    }
+    m_file.push_back(static_cast<unsigned>(m_files.size() - 1));
+    m_line.push_back(line);
+    m_text_pos.push_back(pos);
+    m_text_len.push_back(len);
+    m_pattern.push_back(pattern);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+// Only the C standard library is used, so that the store can be tested on
+// its own (see test\test_result_store.cpp).
+#include <stddef.h>
+#include <stdlib.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Append-only storage for the text of many lines. It is allocated in large
+// chunks, so that there is no allocation per line. Text that has been
+// appended never moves until the arena gets cleared. A single text is never
+// split between chunks. One that is longer than CHUNK_LEN gets a chunk of
+// its own, that is just as long as the text.
+class TextArena
+{
+public:
+    TextArena() :
+        m_chunks(nullptr),
+        m_num_chunks(0),
+        m_current(0),
+        m_used(CHUNK_LEN),
+        m_bytes(0)
+    {
+    }
+
+    ~TextArena()
+    {
+        clear();
+    }
+
+    // Returns the position of the copy for at(). len is set to zero, if
+    // there is no memory left. Empty text has no position and must not be
+    // looked up.
+    size_t append(const wchar_t* text, unsigned& len);
+
+    const wchar_t* at(size_t pos) const
+    {
+        return m_chunks[pos / CHUNK_LEN] + pos % CHUNK_LEN;
+    }
+
+    void clear();
+
+    // memory taken by the chunks
+    size_t bytes() const
+    {
+        return m_bytes;
+    }
+
+    static const unsigned CHUNK_LEN = 1 << 20;
+
+private:
+    TextArena(const TextArena&) = delete;
+    TextArena& operator=(const TextArena&) = delete;
+
+    bool add_chunk(size_t len);
+
+    wchar_t** m_chunks;
+    size_t m_num_chunks;
+    size_t m_current;           // the chunk that short texts are put into
+    unsigned m_used;            // characters used in the current chunk
+    size_t m_bytes;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A column of the store. It only holds plain values and grows by doubling.
+template <class T>
+class StoreColumn
+{
+public:
+    StoreColumn() : m_items(nullptr), m_size(0), m_capacity(0)
+    {
+    }
+
+    ~StoreColumn()
+    {
+        free(m_items);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    const T& operator[](size_t idx) const
+    {
+        return m_items[idx];
+    }
+
+    // Makes room for one more item. Returns false, if there is no memory.
+    bool reserve_one()
+    {
+        if (m_size < m_capacity)
+        {
+            return true;
+        }
+        const size_t capacity = m_capacity ? m_capacity * 2 : 1024;
+        T* items = static_cast<T*>(realloc(m_items, capacity * sizeof(T)));
+        if (items == nullptr)
+        {
+            return false;
+        }
+        m_items = items;
+        m_capacity = capacity;
+        return true;
+    }
+
+    size_t bytes() const
+    {
+        return m_capacity * sizeof(T);
+    }
+
+    // Only allowed after reserve_one has succeeded.
+    void push_back(const T& item)
+    {
+        m_items[m_size++] = item;
+    }
+
+    void clear()
+    {
+        free(m_items);
+        m_items = nullptr;
+        m_size = m_capacity = 0;
+    }
+
+private:
+    StoreColumn(const StoreColumn&) = delete;
+    StoreColumn& operator=(const StoreColumn&) = delete;
+
+    T* m_items;
+    size_t m_size;
+    size_t m_capacity;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Stores the rows of the result list column by column, so that a row is
+// found by its index in constant time and only needs a few bytes besides
+// its text. Everything that is the same for all rows of a file (path,
+// encoding) is stored once per file and referenced by the file id of the
+// row. The store knows nothing about the GUI, which asks it for the rows
+// that are currently visible.
+//
+class ResultStore
+{
+public:
+    void clear();
+
+    // Starts a new file, that the rows added next belong to. path has to be
+    // terminated by a zero. The encoding is a TextEncoding, that is only
+    // kept for the caller. Returns the file id or NO_FILE, if there is no
+    // memory left.
+    unsigned add_file(
+        const wchar_t* path,
+        unsigned path_len,
+        unsigned path_prefix_len,
+        int encoding
+        );
+
+    // Adds a row to the file that has been added last. The text is copied
+    // to the store. Returns false, if there is no memory left.
+    bool add_row(
+        unsigned long long line,
+        unsigned pattern,
+        const wchar_t* text,
+        unsigned len
+        );
+
+    size_t num_rows() const
+    {
+        return m_line.size();
+    }
+
+    unsigned num_files() const
+    {
+        return static_cast<unsigned>(m_files.size());
+    }
+
+    unsigned file_id(size_t row) const
+    {
+        return m_file[row];
+    }
+
+    unsigned long long line_number(size_t row) const
+    {
+        return m_line[row];
+    }
+
+    unsigned pattern(size_t row) const
+    {
+        return m_pattern[row];
+    }
+
+    // Returns nullptr for an empty text.
+    const wchar_t* text(size_t row, unsigned& len) const
+    {
+        len = m_text_len[row];
+        return len ? m_text.at(m_text_pos[row]) : nullptr;
+    }
+
+    const wchar_t* path(unsigned file) const
+    {
+        return m_text.at(m_files[file].path_pos);
+    }
+
+    // The path without the prefix that all paths of the search share.
+    const wchar_t* display_name(unsigned file) const
+    {
+        return path(file) + m_files[file].path_prefix_len;
+    }
+
+    int encoding(unsigned file) const
+    {
+        return m_files[file].encoding;
+    }
+
+    // Memory taken by the rows, the files and their text.
+    size_t bytes() const;
+
+    static const unsigned NO_FILE = ~0u;
+
+private:
+    struct File
+    {
+        size_t          path_pos;       // in m_text, including the zero
+        unsigned        path_prefix_len;
+        int             encoding;
+    };
+
+    StoreColumn<File>               m_files;
+    StoreColumn<unsigned>           m_file;
+    StoreColumn<unsigned long long> m_line;
+    StoreColumn<size_t>             m_text_pos;
+    StoreColumn<unsigned>           m_text_len;
+    StoreColumn<unsigned>           m_pattern;
+    TextArena                       m_text;
+};
+
+////////////////////////////////////////////////////////////////////////////////
@@ -27,7 +27,7 @@
 
 #include "pch.h"
 #include "rgrep_dlg.h"
-#include "shoddy_cmdl_parser.h"
+#include "rgrep_cli.h"
 
 void entry_point()
 {
@@ -36,6 +36,10 @@ void entry_point()
     int argc = 0;
     PWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
     ShoddyCmdlParser parser(argc, argv);
+    if (parser.has_key(L"cli"))
+    {
+        ExitProcess(static_cast<UINT>(run_cli(parser)));
+    }
 
     GrepDlg dlg(parser.get_val(L"path"));
     Yast str_font_size(parser.get_val(L"fontsize"));
@@ -0,0 +1,828 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+#include "pch.h"
+#include "rgrep_bench.h"
+#include "search_thread.h"
+#include "dir_iter.h"
+#include <new>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int EXIT_OK = 0;
+static const int EXIT_ERROR = 2;
+
+static const WCHAR USAGE[] =
+    L"usage: rgrep -cli -bench workers <options of a search>\n"
+    L"       rgrep -cli -bench rx [-gb <size of the text>]\n"
+    L"       rgrep -cli -bench stream -path <dir> [-gb <size of the file>]\n"
+    L"       rgrep -cli -bench encoding\n"
+    L"       rgrep -cli -bench index <options of a search>\n"
+    L"       rgrep -cli -bench walk -path <dir> [-walkers <n>]\n"
+    L"       rgrep -cli -bench load -path <dir>\n";
+
+// A size hint, that makes TextFile::load map a file without trying to read
+// it first, like it did before small files were read.
+static const ULONGLONG MAP_ALWAYS = TextFile::SIZE_UNKNOWN - 1;
+
+// default size of the text for -bench rx and the size of its chunks
+static const UINT RX_GB = 4;
+static const size_t RX_CHUNK = 64 * 1024 * 1024;
+
+// Words of a typical source file. Each of RX_PATTERNS matches some of them.
+static const char* const WORDS[] = {
+    "int", "return", "if", "else", "for", "while", "const", "static",
+    "num_files", "num_lines", "m_buffer", "open", "read", "write", "close",
+    "value", "index", "count", "size_t", "2025-01-31", "0x7fff", "=", "+",
+    "(", ")", "{", "}", ";", "//", "the", "file", "is",
+    "gr\xc3\xb6\xc3\x9f" "e", "na\xc3\xafve",
+};
+
+// default size of the file for -bench stream
+static const UINT STREAM_GB = 10;
+
+// The file of -bench stream has this in its last line and nowhere else.
+static const char STREAM_MARKER[] = "rgrep_bench_marker\n";
+static const WCHAR STREAM_FILE[] = L"rgrep_bench_stream.txt";
+
+// Sizes of the texts for -bench encoding. Each one is classified as often
+// as it takes to get through ENCODING_TOTAL bytes.
+static const size_t ENCODING_SIZES[] = {
+    4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024
+};
+static const size_t ENCODING_TOTAL = 1024 * 1024 * 1024;
+
+static const PCWSTR RX_PATTERNS[][2] = {
+    {L"identifier", L"\\bnum_\\w+"},
+    {L"alternation", L"open|read|write|close"},
+    {L"class", L"[0-9]{4}-[0-9]{2}-[0-9]{2}"},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Measures the milliseconds since it was constructed.
+class Stopwatch
+{
+public:
+    Stopwatch() : m_start(os_ticks())
+    {
+    }
+
+    // never 0, so that it can be divided by
+    uint32_t ms() const
+    {
+        const uint32_t ms = os_ticks() - m_start;
+        return ms ? ms : 1;
+    }
+
+private:
+    uint32_t m_start;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static UINT per_second(uint64_t count, uint32_t ms)
+{
+    return static_cast<UINT>(count * 1000 / ms);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int usage()
+{
+    StdOut err(true);
+    err.write(USAGE, ARRAYSIZE(USAGE) - 1);
+    return EXIT_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs the search with 1, 2, 4, ... workers up to one per logical
+// processor and prints the time of each run and its speedup over a single
+// worker. A first run that is not measured brings the files into the
+// cache, so that the scaling of the search is measured and not that of
+// the disk.
+static int bench_workers(ShoddyCmdlParser& parser, StdOut& out)
+{
+    SearchParams params;
+    if (!prepare_params(parser, params))
+    {
+        return usage();
+    }
+    const UINT max_workers = os_num_cpus();
+    UINT num_searched;
+    params.num_workers = max_workers;
+    if (run_search(params, nullptr, num_searched) == EXIT_ERROR)
+    {
+        return EXIT_ERROR;
+    }
+
+    static const WCHAR header[] = L"workers        ms     files/s  speedup\n";
+    out.write(header, ARRAYSIZE(header) - 1);
+    Yast line;
+    uint32_t single_ms = 0;
+    UINT workers = 1;
+    for (;;)
+    {
+        params.num_workers = workers;
+        const Stopwatch watch;
+        if (run_search(params, nullptr, num_searched) == EXIT_ERROR)
+        {
+            return EXIT_ERROR;
+        }
+        const uint32_t ms = watch.ms();
+        single_ms = (workers == 1) ? ms : single_ms;
+        const UINT speedup = static_cast<UINT>(uint64_t(single_ms) * 100 / ms);
+        line.format(
+            L"%7u %9u %11u %5u.%02u\n",
+            workers,
+            ms,
+            per_second(num_searched, ms),
+            speedup / 100,
+            speedup % 100
+            );
+        out.write(line);
+        out.flush();
+        if (workers == max_workers)
+        {
+            return EXIT_OK;
+        }
+        workers = (2 * workers < max_workers) ? 2 * workers : max_workers;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Fills text with at least len bytes of lines, that are made of WORDS in an
+// order that looks random, but is the same for every run. rnd is the state
+// of that order. Passing it to the next call continues the text.
+static void make_text(cvector<char>& text, size_t len, uint32_t& rnd)
+{
+    text.clear();
+    text.reserve(len + 64);
+    UINT words_in_line = 0;
+    while (text.size() < len)
+    {
+        rnd = rnd * 1103515245 + 12345;
+        const char* word = WORDS[(rnd >> 16) % ARRAYSIZE(WORDS)];
+        text.insert(text.end(), word, word + strlen(word));
+        words_in_line = (words_in_line + 1) % 12;
+        text.push_back(words_in_line ? ' ' : '\n');
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// None of RX_PATTERNS matches an empty string, so the next search can
+// start at the end of the last match.
+template <class SUBJECT>
+static size_t count_matches(const rrx& rx, const SUBJECT& subject)
+{
+    rrx::matcher m;
+    range found;
+    size_t count = 0;
+    size_t pos = 0;
+    while (rx.search(m, found, subject, pos))
+    {
+        count++;
+        pos = found.end;
+    }
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Searches -gb GB of generated text for each of RX_PATTERNS, once as UTF-16
+// and once as UTF-8 (if the pattern can search bytes directly), with the
+// interpreter and with the JIT. The text is generated in chunks of
+// RX_CHUNK bytes, that are searched in turn. The throughput is in MB of the
+// UTF-8 text per second. It measures the matching only: generating and
+// converting the chunks is not counted.
+static int bench_rx(ShoddyCmdlParser& parser, StdOut& out)
+{
+    UINT gb = RX_GB;
+    if (parser.has_key(L"gb"))
+    {
+        gb = os_parse_int(parser.get_val(L"gb").str());
+    }
+    if (gb == 0)
+    {
+        return usage();
+    }
+
+    // [pattern][engine], the interpreter first
+    const size_t NUM_PATTERNS = ARRAYSIZE(RX_PATTERNS);
+    rrx::ptr rxs[NUM_PATTERNS][2];
+    for (size_t i = 0; i < NUM_PATTERNS; i++)
+    {
+        rxs[i][0] = rrx::compile(RX_PATTERNS[i][1], rrx::NO_JIT);
+        rxs[i][1] = rrx::compile(RX_PATTERNS[i][1]);
+        if (!rxs[i][0] || !rxs[i][1])
+        {
+            return EXIT_ERROR;
+        }
+    }
+
+    // [pattern][form][engine], UTF-16 first
+    uint32_t ms[NUM_PATTERNS][2][2] = {};
+    ULONGLONG matches[NUM_PATTERNS][2] = {};
+    const ULONGLONG total = ULONGLONG(gb) << 30;
+    cvector<char> text;
+    uint32_t rnd = 1;
+    for (ULONGLONG done = 0; done < total; done += text.size())
+    {
+        make_text(text, RX_CHUNK, rnd);
+        const UINT len = static_cast<UINT>(text.size());
+        const Yast text16(len, &text[0], CP_UTF8);
+        const rrx::bytes text8 = {&text[0], len, true, true};
+        for (size_t i = 0; i < NUM_PATTERNS; i++)
+        {
+            for (int form = 0; form < 2; form++)
+            {
+                for (int engine = 0; engine < 2; engine++)
+                {
+                    const rrx& rx = *rxs[i][engine];
+                    if (form && !rx.searches_bytes(true))
+                    {
+                        continue;
+                    }
+                    const Stopwatch watch;
+                    const size_t count = (
+                        form ?
+                        count_matches(rx, text8) :
+                        count_matches(rx, text16)
+                        );
+                    ms[i][form][engine] += watch.ms();
+                    matches[i][form] += engine ? 0 : count;
+                }
+            }
+        }
+    }
+
+    static const WCHAR header[] =
+        L"pattern      form   interp MB/s    jit MB/s     matches\n";
+    out.write(header, ARRAYSIZE(header) - 1);
+    Yast jit;
+    Yast line;
+    for (size_t i = 0; i < NUM_PATTERNS; i++)
+    {
+        for (int form = 0; form < 2; form++)
+        {
+            if (form && !rxs[i][0]->searches_bytes(true))
+            {
+                continue;
+            }
+            if (rxs[i][1]->uses_jit())
+            {
+                jit.format(L"%u", per_second(total >> 20, ms[i][form][1]));
+            }
+            else
+            {
+                jit = L"-";
+            }
+            line.format(
+                L"%-12s %-6s %11u %11s %11I64u\n",
+                RX_PATTERNS[i][0],
+                form ? L"utf-8" : L"utf-16",
+                per_second(total >> 20, ms[i][form][0]),
+                jit.str(),
+                matches[i][form]
+                );
+            out.write(line);
+        }
+    }
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Writes a file of -gb GB to -path and searches it for STREAM_MARKER. The
+// file is too large to be loaded, so it is searched in windows (see
+// TextFile::open_stream). The match has to be reported in the line that
+// is printed before the search. The file is deleted at the end.
+static int bench_stream(ShoddyCmdlParser& parser, StdOut& out)
+{
+    const Yast dir(parser.get_val(L"path"));
+    UINT gb = STREAM_GB;
+    if (parser.has_key(L"gb"))
+    {
+        gb = os_parse_int(parser.get_val(L"gb").str());
+    }
+    if (dir.is_empty() || !os_is_dir(dir) || gb == 0)
+    {
+        return usage();
+    }
+    const Yast path(dir + OS_SEP_STR + STREAM_FILE);
+
+    // The file consists of one block of complete lines, that is written
+    // again and again.
+    cvector<char> block;
+    uint32_t rnd = 1;
+    make_text(block, TextFile::STREAM_WINDOW, rnd);
+    size_t block_len = block.size();
+    while (block[block_len - 1] != '\n')
+    {
+        block_len--;
+    }
+    block.resize(block_len);
+    ULONGLONG block_lines = 0;
+    for (char c : block)
+    {
+        block_lines += (c == '\n');
+    }
+    const ULONGLONG num_blocks = (ULONGLONG(gb) << 30) / block_len;
+    const UINT marker_len = ARRAYSIZE(STREAM_MARKER) - 1;
+    const ULONGLONG file_size = num_blocks * block_len + marker_len;
+
+    OsFile file;
+    if (!file.create(path))
+    {
+        return EXIT_ERROR;
+    }
+    const Stopwatch write_watch;
+    bool ok = true;
+    for (ULONGLONG i = 0; ok && i < num_blocks; i++)
+    {
+        ok = file.write(&block[0], block_len);
+    }
+    ok = ok && file.write(STREAM_MARKER, marker_len);
+    file.close();
+    if (!ok)
+    {
+        os_delete_file(path);
+        return EXIT_ERROR;
+    }
+    Yast line;
+    line.format(
+        L"written:  %I64u bytes in %u ms, the marker is in line %I64u\n",
+        file_size,
+        write_watch.ms(),
+        num_blocks * block_lines + 1
+        );
+    out.write(line);
+    out.flush();
+
+    SearchParams params;
+    params.search_path = dir;
+    params.rx_search = rrx::compile(
+        Yast(marker_len - 1, STREAM_MARKER, CP_ACP),
+        rrx::LITERAL
+        );
+    params.rx_search_utf16 = nullptr;
+    params.inc_globs.compile(STREAM_FILE);
+    params.num_workers = 0;
+    params.num_walkers = 0;
+    params.window_overlap = 8;
+    params.prefetch_depth = 0;
+    params.prefetch_budget = 0;
+    params.search_subdirs = false;
+    params.search_binary = false;
+    params.do_replace = false;
+    params.create_backups = false;
+    params.use_index = false;
+    params.use_ignore_files = false;
+    params.cache_size = 0;
+    UINT num_searched;
+    const Stopwatch watch;
+    const int res = run_search(params, &out, num_searched);
+    const uint32_t ms = watch.ms();
+    os_delete_file(path);
+    // run_search returns 0 only if the marker has been found
+    if (res != EXIT_OK)
+    {
+        return EXIT_ERROR;
+    }
+    line.format(
+        L"searched: %u MB/s in %u ms\n",
+        static_cast<UINT>((file_size * 1000 / ms) >> 20),
+        ms
+        );
+    out.write(line);
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// guess_encoding as it was before it sampled the zeros and validated
+// UTF-8 by itself: every word is checked for zeros and the whole text is
+// converted once to see whether it is valid UTF-8. The BOMs are left out,
+// because looking at them takes no time.
+static TextEncoding full_guess_encoding(const BYTE* data, size_t size)
+{
+    const uint16_t* p16 = p2p<const uint16_t*>(data);
+    const uint16_t* const end = p16 + (size / sizeof(uint16_t));
+    int z8 = 0;
+    int z16 = 0;
+    while (p16 < end)
+    {
+        const uint16_t test = *p16++;
+        if (test == 0 && ++z16 > 2)
+        {
+            return TE_BINARY;
+        }
+        z8 += ((test & 0xff) == 0) + ((test >> 8) == 0);
+    }
+    if ((z8 > 3) && ((size & 1) == 0))
+    {
+        return TE_UTF16_LE;
+    }
+    const size_t res = os_to_utf16(
+        CP_UTF8,
+        p2p<PCSTR>(data),
+        size,
+        nullptr,
+        0,
+        true
+        );
+    return (res == 0) ? TE_ANSI : TE_UTF8;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Classifies generated UTF-8 texts of ENCODING_SIZES with guess_encoding
+// and with full_guess_encoding, and prints the MB/s of both.
+static int bench_encoding(ShoddyCmdlParser& parser, StdOut& out)
+{
+    cvector<char> text;
+    uint32_t rnd = 1;
+    make_text(text, ENCODING_SIZES[ARRAYSIZE(ENCODING_SIZES) - 1], rnd);
+    const BYTE* const data = p2p<const BYTE*>(&text[0]);
+
+    static const WCHAR header[] =
+        L"     size     full MB/s  sampled MB/s\n";
+    out.write(header, ARRAYSIZE(header) - 1);
+    Yast line;
+    for (size_t size : ENCODING_SIZES)
+    {
+        const size_t rounds = ENCODING_TOTAL / size;
+        UINT num_full = 0;
+        const Stopwatch full_watch;
+        for (size_t i = 0; i < rounds; i++)
+        {
+            num_full += (full_guess_encoding(data, size) == TE_UTF8);
+        }
+        const uint32_t full_ms = full_watch.ms();
+        UINT num_sampled = 0;
+        const Stopwatch sampled_watch;
+        for (size_t i = 0; i < rounds; i++)
+        {
+            num_sampled += (guess_encoding(data, size, true) == TE_UTF8);
+        }
+        const uint32_t sampled_ms = sampled_watch.ms();
+
+        // A text that has been cut in the middle of a character is not
+        // valid UTF-8. The results have to agree nevertheless.
+        if (num_full != num_sampled)
+        {
+            return EXIT_ERROR;
+        }
+        line.format(
+            L"%9u %13u %13u\n",
+            static_cast<UINT>(size),
+            per_second(ENCODING_TOTAL >> 20, full_ms),
+            per_second(ENCODING_TOTAL >> 20, sampled_ms)
+            );
+        out.write(line);
+        out.flush();
+    }
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Builds the TrigramIndex of -path (replacing the one that is there) and
+// times that, opening it for the literal that the search requires and the
+// search itself with and without the index. The searches are preceded by
+// one that is not measured, to have the same files in the cache for both.
+static int bench_index(ShoddyCmdlParser& parser, StdOut& out)
+{
+    SearchParams params;
+    if (!prepare_params(parser, params))
+    {
+        return usage();
+    }
+    const volatile long canceled = 0;
+    const Stopwatch build_watch;
+    if (!TrigramIndex::build(params.search_path, &canceled))
+    {
+        return EXIT_ERROR;
+    }
+    const uint32_t build_ms = build_watch.ms();
+    OsDirEntry entry;
+    if (!os_get_entry(TrigramIndex::index_path(params.search_path), entry))
+    {
+        return EXIT_ERROR;
+    }
+    Yast line;
+    line.format(
+        L"build:        %9u ms, %I64u bytes\n",
+        build_ms,
+        entry.size
+        );
+    out.write(line);
+
+    bool ignore_case;
+    const Yast& literal = params.rx_search->required_text(ignore_case);
+    TrigramIndex index;
+    const Stopwatch open_watch;
+    const bool usable = index.open(params.search_path, literal, ignore_case);
+    line.format(
+        L"open:         %9u ms%s\n",
+        open_watch.ms(),
+        usable ? L"" : L", the pattern has no trigram to look up"
+        );
+    out.write(line);
+    out.flush();
+
+    UINT num_searched;
+    if (run_search(params, nullptr, num_searched) == EXIT_ERROR)
+    {
+        return EXIT_ERROR;
+    }
+    for (int use_index = 0; use_index < 2; use_index++)
+    {
+        params.use_index = (use_index != 0);
+        const Stopwatch watch;
+        if (run_search(params, nullptr, num_searched) == EXIT_ERROR)
+        {
+            return EXIT_ERROR;
+        }
+        line.format(
+            L"search %-6s%9u ms, %u files searched\n",
+            use_index ? L"index:" : L"full:",
+            watch.ms(),
+            num_searched
+            );
+        out.write(line);
+        out.flush();
+    }
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// While s_count_allocs is set, every call of operator new is counted in
+// s_num_allocs (see walk). Memory that is taken with malloc or straight
+// from the heap functions is not counted.
+static volatile long s_count_allocs = 0;
+static volatile long s_num_allocs = 0;
+
+void* operator new(size_t size)
+{
+    if (s_count_allocs)
+    {
+        os_increment(&s_num_allocs);
+    }
+    void* const p = malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// -bench walk searches with these. Neither is expected to match anything,
+// so every directory is entered and no file is searched.
+static const WCHAR WALK_EXCLUDE[] = L"^rgrep_bench_none$";
+static const WCHAR WALK_INCLUDE[] = L"\\.rgrep_bench_none$";
+
+// Walks the tree below dir like a search does, sequentially (num_walkers
+// == 0) or with a ParallelDirWalker, with exclude and include patterns,
+// the ignore files and the counting of the files. Prints the files per
+// second and the calls of operator new per file, unless out is nullptr.
+static void walk(StdOut* out, const Yast& dir, UINT num_walkers)
+{
+    SearchParams params;
+    params.search_path = dir;
+    params.rx_search = rrx::compile(L"rgrep_bench_none", rrx::LITERAL);
+    params.rx_search_utf16 = nullptr;
+    params.rx_exclude = rrx::compile(WALK_EXCLUDE, rrx::IGNORE_CASE);
+    params.rx_include = rrx::compile(WALK_INCLUDE, rrx::IGNORE_CASE);
+    params.num_workers = 0;
+    params.num_walkers = num_walkers;
+    params.window_overlap = 8;
+    params.prefetch_depth = 0;
+    params.prefetch_budget = 0;
+    params.search_subdirs = true;
+    params.search_binary = false;
+    params.do_replace = false;
+    params.create_backups = false;
+    params.use_index = false;
+    params.use_ignore_files = true;
+    params.cache_size = 0;
+    UINT num_searched;
+    UINT num_files = 0;
+    os_exchange(&s_num_allocs, 0);
+    os_exchange(&s_count_allocs, 1);
+    const Stopwatch watch;
+    run_search(params, nullptr, num_searched, &num_files);
+    const uint32_t ms = watch.ms();
+    os_exchange(&s_count_allocs, 0);
+    if (!out)
+    {
+        return;
+    }
+    const ULONGLONG allocs = static_cast<ULONGLONG>(s_num_allocs);
+    const ULONGLONG per_file = num_files ? allocs * 100 / num_files : 0;
+    Yast line;
+    line.format(
+        L"%7u %9u %11u %11u %8u.%02u\n",
+        num_walkers,
+        ms,
+        per_second(num_files, ms),
+        num_files,
+        static_cast<UINT>(per_file / 100),
+        static_cast<UINT>(per_file % 100)
+        );
+    out->write(line);
+    out->flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Walks -path sequentially and with -walkers walkers (one per logical
+// processor by default) the way a search does. A first walk that is not
+// measured brings the directories into the cache.
+static int bench_walk(ShoddyCmdlParser& parser, StdOut& out)
+{
+    const Yast dir(parser.get_val(L"path"));
+    UINT num_walkers = os_num_cpus();
+    if (parser.has_key(L"walkers"))
+    {
+        num_walkers = os_parse_int(parser.get_val(L"walkers").str());
+    }
+    if (dir.is_empty() || !os_is_dir(dir) || num_walkers == 0)
+    {
+        return usage();
+    }
+    if (num_walkers > ParallelDirWalker::MAX_WALKERS)
+    {
+        num_walkers = ParallelDirWalker::MAX_WALKERS;
+    }
+    walk(nullptr, dir, 0);
+
+    static const WCHAR header[] =
+        L"walkers        ms     files/s       files allocs/file\n";
+    out.write(header, ARRAYSIZE(header) - 1);
+    walk(&out, dir, 0);
+    walk(&out, dir, num_walkers);
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Loads all files below -path with one TextFile, first with their real
+// sizes as hints and then with MAP_ALWAYS, and prints the files/s and MB/s
+// of both. The bytes are kept as they are, so only reading or mapping is
+// measured and not the conversion. All files are loaded once before, to
+// bring them into the cache.
+static int bench_load(ShoddyCmdlParser& parser, StdOut& out)
+{
+    const Yast dir(parser.get_val(L"path"));
+    if (dir.is_empty() || !os_is_dir(dir))
+    {
+        return usage();
+    }
+    YastVector paths;
+    cvector<ULONGLONG> sizes;
+    ULONGLONG total = 0;
+    DirectoryIterator diter(dir);
+    bool is_dir;
+    while (diter.next(is_dir, true))
+    {
+        if (!is_dir)
+        {
+            paths.push_back(Yast(diter.path_str(), diter.path_len()));
+            sizes.push_back(diter.get_info()->size);
+            total += diter.get_info()->size;
+        }
+    }
+
+    TextFile file;
+    for (const Yast& path : paths)
+    {
+        file.load(path, true, true, true);
+        file.unload();
+    }
+
+    static const WCHAR header[] = L"loader        ms     files/s      MB/s\n";
+    out.write(header, ARRAYSIZE(header) - 1);
+    Yast line;
+    for (int map_always = 0; map_always < 2; map_always++)
+    {
+        const Stopwatch watch;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            const ULONGLONG hint = map_always ? MAP_ALWAYS : sizes[i];
+            file.load(paths[i], true, true, true, hint);
+            file.unload();
+        }
+        const uint32_t ms = watch.ms();
+        line.format(
+            L"%-6s %9u %11u %9u\n",
+            map_always ? L"map" : L"read",
+            ms,
+            per_second(paths.size(), ms),
+            per_second(total >> 20, ms)
+            );
+        out.write(line);
+        out.flush();
+    }
+    return EXIT_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+typedef int (*BENCH_PROC)(ShoddyCmdlParser& parser, StdOut& out);
+
+struct Bench
+{
+    PCWSTR      name;
+    BENCH_PROC  proc;
+};
+
+static const Bench BENCHES[] = {
+    {L"workers", bench_workers},
+    {L"rx", bench_rx},
+    {L"stream", bench_stream},
+    {L"encoding", bench_encoding},
+    {L"index", bench_index},
+    {L"walk", bench_walk},
+    {L"load", bench_load},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+int run_bench(ShoddyCmdlParser& parser, StdOut& out)
+{
+    const Yast name(parser.get_val(L"bench"));
+    for (const Bench& bench : BENCHES)
+    {
+        if (os_strcmpi(name.str(), bench.name) == 0)
+        {
+            return bench.proc(parser, out);
+        }
+    }
+    return usage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,519 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "pch.h"
+#include "rgrep_cli.h"
+#include "search_thread.h"
+#include "trigram_index.h"
+#include "dir_iter.h"
+#include "rgrep_bench.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int EXIT_FOUND = 0;
+static const int EXIT_NOT_FOUND = 1;
+static const int EXIT_ERROR = 2;
+
+static const WCHAR USAGE[] =
+    L"usage: rgrep -cli -path <dir> (-regex <rx> | -text <literal>)\n"
+    L"             [-icase] [-word] [-subdirs] [-binary]\n"
+    L"             [-include <wildcards separated by '|'>]\n"
+    L"             [-exclude <rx for directories>] [-workers <n>]\n"
+    L"             [-walkers <n>] [-index] [-cache] [-gitignore]\n"
+    L"             [-prefetch <files>] [-prefetch_mb <n>]\n"
+    L"             [-min_size <n>[k|m|g]] [-max_size <n>[k|m|g]]\n"
+    L"             [-after <yyyy-mm-dd>] [-before <yyyy-mm-dd>]\n"
+    L"             [-skip <h|s|o|r...>]\n"
+    L"       rgrep -cli -build_index -path <dir>\n"
+    L"       rgrep -cli -watch_index -path <dir>\n"
+    L"       rgrep -cli -bench <name> ...\n";
+
+// memory for the ResultCache with -cache
+static const size_t CACHE_SIZE = 256 * 1024 * 1024;
+
+// defaults for reading files ahead of the workers
+static const UINT PREFETCH_DEPTH = 8;
+static const UINT PREFETCH_MB = 64;
+
+// How often the changes collected by the watcher are put into the index.
+static const DWORD WATCH_INTERVAL = 250;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+StdOut::StdOut(bool error) : m_stream(error)
+{
+    m_buf.reserve(FLUSH_LEN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+StdOut::~StdOut()
+{
+    flush();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void StdOut::write(PCWSTR str, UINT len)
+{
+    m_buf.insert(m_buf.end(), str, str + len);
+    if (m_buf.size() >= FLUSH_LEN)
+    {
+        flush();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void StdOut::flush()
+{
+    if (m_buf.size())
+    {
+        m_stream.write(&m_buf[0], m_buf.size());
+    }
+    m_buf.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// Passed to the callbacks of the search thread.
+struct CliContext
+{
+    OsMutex         lock;
+    OsCondVar       cv;
+    bool            signaled;       // guarded by lock
+    bool            done;           // guarded by lock
+
+    CliContext() : signaled(false), done(false)
+    {
+    }
+
+    void signal(bool end)
+    {
+        lock.lock();
+        signaled = true;
+        done = done || end;
+        lock.unlock();
+        cv.wake_one();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void on_results(void* pctxt)
+{
+    static_cast<CliContext*>(pctxt)->signal(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void on_end_search(void* pctxt)
+{
+    static_cast<CliContext*>(pctxt)->signal(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Prints the result like grep does: 'path:line:text'.
+static void print_result(StdOut& out, const SearchResult& result)
+{
+    Yast str;
+    if (result.encoding == TE_BINARY)
+    {
+        str.format(L"Binary file %s matches\n", result.path.str());
+        out.write(str);
+        return;
+    }
+    for (const LineInfo& li : result.line_info)
+    {
+        str.format(L"%s:%I64u:", result.path.str(), li.number);
+        out.write(str);
+        UINT len = li.text_len;
+        if (len)
+        {
+            PCWSTR text = &result.line_text[li.text_pos];
+            if (text[len - 1] == '\r')
+            {
+                --len;
+            }
+            out.write(text, len);
+        }
+        out.write(L"\n", 1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Parses a number of bytes with an optional suffix of k, m or g. An empty
+// text is no limit.
+static bool parse_size(const Yast& text, ULONGLONG& size)
+{
+    size = 0;
+    if (text.is_empty())
+    {
+        return true;
+    }
+    PCWSTR end = nullptr;
+    size = os_parse_uint(text.str(), &end);
+    switch (*end)
+    {
+        case L'k':
+        case L'K':
+            size <<= 10;
+            end++;
+            break;
+        case L'm':
+        case L'M':
+            size <<= 20;
+            end++;
+            break;
+        case L'g':
+        case L'G':
+            size <<= 30;
+            end++;
+            break;
+    }
+    return end != text.str() && *end == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Parses a local date 'yyyy-mm-dd' to the UTC FILETIME of its midnight.
+static bool parse_date(const Yast& text, ULONGLONG& time)
+{
+    time = 0;
+    if (text.is_empty())
+    {
+        return true;
+    }
+    PCWSTR p = text.str();
+    const ULONGLONG year = os_parse_uint(p, &p);
+    if (*p++ != L'-')
+    {
+        return false;
+    }
+    const ULONGLONG month = os_parse_uint(p, &p);
+    if (*p++ != L'-')
+    {
+        return false;
+    }
+    const ULONGLONG day = os_parse_uint(p, &p);
+    return (
+        *p == 0 &&
+        (year | month | day) <= MAXDWORD &&
+        os_local_midnight(
+            static_cast<UINT>(year),
+            static_cast<UINT>(month),
+            static_cast<UINT>(day),
+            time
+            )
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Files with any of these attributes are skipped: h(idden), s(ystem),
+// o(ffline, including files that are only recalled on access) and r(eparse
+// points).
+static bool parse_attributes(const Yast& text, DWORD& attributes)
+{
+    attributes = 0;
+    for (PCWSTR p = text.str(); *p; p++)
+    {
+        switch (*p)
+        {
+            case L'h':
+                attributes |= FILE_ATTRIBUTE_HIDDEN;
+                break;
+            case L's':
+                attributes |= FILE_ATTRIBUTE_SYSTEM;
+                break;
+            case L'o':
+                attributes |= (
+                    FILE_ATTRIBUTE_OFFLINE |
+                    FILE_ATTRIBUTE_RECALL_ON_DATA_ACCESS
+                    );
+                break;
+            case L'r':
+                attributes |= FILE_ATTRIBUTE_REPARSE_POINT;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool prepare_params(ShoddyCmdlParser& parser, SearchParams& params)
+{
+    params.search_path = parser.get_val(L"path");
+    UINT flags = 0;
+    Yast search_text(parser.get_val(L"regex"));
+    if (search_text.is_empty())
+    {
+        search_text = parser.get_val(L"text");
+        flags |= rrx::LITERAL;
+    }
+    if (
+        params.search_path.is_empty() ||
+        !os_is_dir(params.search_path) ||
+        search_text.is_empty()
+        )
+    {
+        return false;
+    }
+    if (parser.has_key(L"icase"))
+    {
+        flags |= rrx::IGNORE_CASE;
+    }
+    if (parser.has_key(L"word"))
+    {
+        flags |= rrx::WHOLE_WORDS;
+    }
+    params.rx_search = rrx::compile(search_text, flags);
+    if (!params.rx_search)
+    {
+        return false;
+    }
+
+    const Yast exclude_text(parser.get_val(L"exclude"));
+    if (!exclude_text.is_empty())
+    {
+        params.rx_exclude = rrx::compile(exclude_text, rrx::IGNORE_CASE);
+        if (!params.rx_exclude)
+        {
+            return false;
+        }
+    }
+    params.inc_globs.compile(parser.get_val(L"include"));
+
+    MetaFilter& meta = params.meta;
+    if (
+        !parse_size(parser.get_val(L"min_size"), meta.min_size) ||
+        !parse_size(parser.get_val(L"max_size"), meta.max_size) ||
+        !parse_date(parser.get_val(L"after"), meta.modified_after) ||
+        !parse_date(parser.get_val(L"before"), meta.modified_before) ||
+        !parse_attributes(parser.get_val(L"skip"), meta.skip_attributes)
+        )
+    {
+        return false;
+    }
+
+    // Binary files are only searched for the forms of a literal that
+    // rx_search finds by itself (see rrx::searches_binary).
+    params.rx_search_utf16 = nullptr;
+    params.num_workers = os_parse_int(parser.get_val(L"workers").str());
+    params.num_walkers = os_parse_int(parser.get_val(L"walkers").str());
+    params.window_overlap = 8;
+    params.prefetch_depth = PREFETCH_DEPTH;
+    if (parser.has_key(L"prefetch"))
+    {
+        params.prefetch_depth = os_parse_int(parser.get_val(L"prefetch").str());
+    }
+    UINT prefetch_mb = PREFETCH_MB;
+    if (parser.has_key(L"prefetch_mb"))
+    {
+        prefetch_mb = os_parse_int(parser.get_val(L"prefetch_mb").str());
+    }
+    params.prefetch_budget = size_t(prefetch_mb) * 1024 * 1024;
+    params.search_subdirs = parser.has_key(L"subdirs");
+    params.search_binary = parser.has_key(L"binary");
+    params.do_replace = false;
+    params.create_backups = false;
+    params.use_index = parser.has_key(L"index");
+    params.use_ignore_files = parser.has_key(L"gitignore");
+
+    // Every run is a process of its own, so the cache is only of use when
+    // it is kept in a file.
+    if (parser.has_key(L"cache"))
+    {
+        params.cache_size = CACHE_SIZE;
+        params.cache_file = app_data_path(L"results.rgc");
+    }
+    else
+    {
+        params.cache_size = 0;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Keeps the index of root up to date until the process is terminated.
+// The watcher is started before the index is built, so that no change
+// gets lost in between.
+static int watch_index(StdOut& out, const Yast& root)
+{
+    const volatile long canceled = 0;
+    DirWatcher watcher;
+    if (
+        !watcher.start(root) ||
+        (!TrigramIndex::exists(root) && !TrigramIndex::build(root, &canceled))
+        )
+    {
+        return EXIT_ERROR;
+    }
+    YastVector changed;
+    Yast msg;
+    for (;;)
+    {
+        os_sleep(WATCH_INTERVAL);
+        // A watcher that failed is started again before the index is
+        // rebuilt, for the same reason as above.
+        const bool failed = watcher.failed();
+        if (failed && !watcher.start(root))
+        {
+            return EXIT_ERROR;
+        }
+        bool ok = true;
+        if (failed || !watcher.take(changed))
+        {
+            ok = TrigramIndex::build(root, &canceled);
+            msg.format(L"index rebuilt: %s\n", ok ? L"ok" : L"FAILED");
+        }
+        else if (changed.size())
+        {
+            ok = TrigramIndex::update(root, changed, &canceled);
+            msg.format(
+                L"index updated (%u changes): %s\n",
+                UINT(changed.size()),
+                ok ? L"ok" : L"FAILED"
+                );
+        }
+        else
+        {
+            continue;
+        }
+        out.write(msg);
+        out.flush();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int run_search(
+    SearchParams& params,
+    StdOut* out,
+    UINT& num_searched,
+    UINT* num_processed
+    )
+{
+    num_searched = 0;
+    CliContext ctxt;
+    params.p_ctxt = &ctxt;
+    params.results_cb = on_results;
+    params.end_search_cb = on_end_search;
+
+    SearchThread thread;
+    if (!thread.start(params))
+    {
+        return EXIT_ERROR;
+    }
+
+    // Everything that has been found is in the queue, before the end of
+    // the search is signaled. So the queue only has to be drained once
+    // more after that.
+    bool found = false;
+    bool done = false;
+    SearchResult result;
+    size_t num_matches;
+    while (!done)
+    {
+        ctxt.lock.lock();
+        while (!ctxt.signaled)
+        {
+            ctxt.cv.wait(ctxt.lock);
+        }
+        ctxt.signaled = false;
+        done = ctxt.done;
+        ctxt.lock.unlock();
+        while (thread.fetch_result(result, num_matches))
+        {
+            found = true;
+            if (out)
+            {
+                print_result(*out, result);
+            }
+        }
+        if (out)
+        {
+            out->flush();
+        }
+    }
+
+    // the thread is still running for a moment after signaling the end
+    thread.wait();
+    UINT processed;
+    Yast current;
+    thread.get_progress(processed, num_searched, current);
+    if (num_processed)
+    {
+        *num_processed = processed;
+    }
+    return found ? EXIT_FOUND : EXIT_NOT_FOUND;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int run_cli(ShoddyCmdlParser& parser)
+{
+    StdOut out(false);
+    if (parser.has_key(L"build_index"))
+    {
+        const volatile long canceled = 0;
+        const Yast root(parser.get_val(L"path"));
+        return TrigramIndex::build(root, &canceled) ? EXIT_FOUND : EXIT_ERROR;
+    }
+    if (parser.has_key(L"watch_index"))
+    {
+        return watch_index(out, parser.get_val(L"path"));
+    }
+
+    if (parser.has_key(L"bench"))
+    {
+        return run_bench(parser, out);
+    }
+
+    SearchParams params;
+    if (!prepare_params(parser, params))
+    {
+        StdOut err(true);
+        err.write(USAGE, ARRAYSIZE(USAGE) - 1);
+        return EXIT_ERROR;
+    }
+    UINT num_searched;
+    return run_search(params, &out, num_searched);
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "shoddy_cmdl_parser.h"
+#include "platform.h"
+
+struct SearchParams;
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Buffered output to the standard output or error (see OsStdStream).
+// rgrep is a GUI application, so it has no console of its own. If the
+// handle has not been redirected, the console of the parent process is
+// used.
+//
+class StdOut
+{
+public:
+    explicit StdOut(bool error);
+    ~StdOut();
+    void write(PCWSTR str, UINT len);
+    void write(const Yast& str)
+    {
+        write(str.str(), str.length());
+    }
+    void flush();
+
+private:
+    StdOut(const StdOut&) = delete;
+    StdOut& operator=(const StdOut&) = delete;
+
+    static const UINT FLUSH_LEN = 32 * 1024;
+
+    cvector<WCHAR>  m_buf;
+    OsStdStream     m_stream;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Runs a search without any GUI and writes the matching lines to stdout
+// as they are found. The search is done by the same SearchThread that the
+// dialog uses. Returns the exit code, which follows the conventions of
+// grep: 0 if something was found, 1 if nothing was found and 2 if the
+// search could not be started. With -build_index, the TrigramIndex of the
+// path is built instead and 0 tells that this succeeded. -watch_index
+// keeps the index of the path up to date as files change and never
+// returns on success.
+//
+int run_cli(ShoddyCmdlParser& parser);
+
+// Fills params from the options of a search. Returns false if they are
+// incomplete or invalid.
+bool prepare_params(ShoddyCmdlParser& parser, SearchParams& params);
+
+// Runs the search of params to its end and prints what is found to out,
+// unless that is nullptr. num_searched receives the number of files that
+// have been searched and num_processed (if given) the number of all files
+// that have been found. Returns the exit code of run_cli.
+int run_search(
+    SearchParams& params,
+    StdOut* out,
+    UINT& num_searched,
+    UINT* num_processed = nullptr
+    );
+
+////////////////////////////////////////////////////////////////////////////////
@@ -40,8 +40,22 @@ GrepDlg::GrepDlg(PCWSTR initial_dir) :
     m_csv_sep(L","),
     m_ctxt_menu(nullptr),
     m_search_flags(0),
+    m_num_workers(0),
+    m_num_walkers(0),
+    m_window_overlap(8),
+    m_prefetch_depth(8),
+    m_prefetch_mb(64),
+    m_cache_mb(64),
+    m_min_size_kb(0),
+    m_max_size_mb(0),
+    m_max_age_days(0),
+    m_skip_attributes(0),
     m_create_backups(false),
+    m_use_index(false),
+    m_use_gitignore(false),
+    m_persist_cache(false),
     m_search_regex(false),
+    m_search_list(false),
     m_include_regex(false),
     m_search_subdirs(false),
     m_search_binary(false),
@@ -68,11 +82,25 @@ bool GrepDlg::LoadSettings(WINDOWPLACEMENT *pwp)
     if (!rkey) return false;
 
     ReadRegDword(rkey, L"search_flags", m_search_flags);
+    ReadRegDword(rkey, L"num_workers", m_num_workers);
+    ReadRegDword(rkey, L"num_walkers", m_num_walkers);
+    ReadRegDword(rkey, L"window_overlap", m_window_overlap);
+    ReadRegDword(rkey, L"prefetch_depth", m_prefetch_depth);
+    ReadRegDword(rkey, L"prefetch_mb", m_prefetch_mb);
+    ReadRegDword(rkey, L"cache_mb", m_cache_mb);
+    ReadRegDword(rkey, L"min_size_kb", m_min_size_kb);
+    ReadRegDword(rkey, L"max_size_mb", m_max_size_mb);
+    ReadRegDword(rkey, L"max_age_days", m_max_age_days);
+    ReadRegDword(rkey, L"skip_attributes", m_skip_attributes);
     ReadRegBool(rkey, L"regex_search", m_search_regex);
+    ReadRegBool(rkey, L"list_search", m_search_list);
     ReadRegBool(rkey, L"create_backups", m_create_backups);
     ReadRegBool(rkey, L"regex_include", m_include_regex);
     ReadRegBool(rkey, L"search_subdirs", m_search_subdirs);
     ReadRegBool(rkey, L"search_binary", m_search_binary);
+    ReadRegBool(rkey, L"use_index", m_use_index);
+    ReadRegBool(rkey, L"use_gitignore", m_use_gitignore);
+    ReadRegBool(rkey, L"persist_cache", m_persist_cache);
     ReadRegString(rkey, L"editor_cmd", m_editor_cmd);
     ReadRegString(rkey, L"viewer_cmd", m_viewer_cmd);
     ReadRegString(rkey, L"csv_sep", m_csv_sep);
@@ -101,11 +129,25 @@ void GrepDlg::SaveSettings()
     if (!rkey) return;
 
     WriteRegDword(rkey, L"search_flags", m_search_flags);
+    WriteRegDword(rkey, L"num_workers", m_num_workers);
+    WriteRegDword(rkey, L"num_walkers", m_num_walkers);
+    WriteRegDword(rkey, L"window_overlap", m_window_overlap);
+    WriteRegDword(rkey, L"prefetch_depth", m_prefetch_depth);
+    WriteRegDword(rkey, L"prefetch_mb", m_prefetch_mb);
+    WriteRegDword(rkey, L"cache_mb", m_cache_mb);
+    WriteRegDword(rkey, L"min_size_kb", m_min_size_kb);
+    WriteRegDword(rkey, L"max_size_mb", m_max_size_mb);
+    WriteRegDword(rkey, L"max_age_days", m_max_age_days);
+    WriteRegDword(rkey, L"skip_attributes", m_skip_attributes);
     WriteRegDword(rkey, L"regex_search", m_search_regex);
+    WriteRegDword(rkey, L"list_search", m_search_list);
     WriteRegDword(rkey, L"create_backups", m_create_backups);
     WriteRegDword(rkey, L"regex_include", m_include_regex);
     WriteRegDword(rkey, L"search_subdirs", m_search_subdirs);
     WriteRegDword(rkey, L"search_binary", m_search_binary);
+    WriteRegDword(rkey, L"use_index", m_use_index);
+    WriteRegDword(rkey, L"use_gitignore", m_use_gitignore);
+    WriteRegDword(rkey, L"persist_cache", m_persist_cache);
     WriteRegString(rkey, L"editor_cmd", m_editor_cmd);
     WriteRegString(rkey, L"viewer_cmd", m_viewer_cmd);
     WriteRegString(rkey, L"csv_sep", m_csv_sep);
@@ -192,8 +234,9 @@ bool GrepDlg::OnInitDialog()
 
     m_ctxt_menu = LoadMenu(Hinstance(), MAKEINTRESOURCE(IDM_RESULT_LIST));
     m_ctxt_menu = GetSubMenu(m_ctxt_menu, 0);
-    CheckButton(IDC_RADIO_REGEX, m_search_regex);
-    CheckButton(IDC_RADIO_LITERAL, !m_search_regex);
+    CheckButton(IDC_RADIO_REGEX, m_search_regex && !m_search_list);
+    CheckButton(IDC_RADIO_LITERAL, !m_search_regex && !m_search_list);
+    CheckButton(IDC_RADIO_LIST, m_search_list);
     CheckButton(IDC_INCLUDE_REGEX, m_include_regex);
     CheckButton(IDC_INCLUDE_WILDCARD, !m_include_regex);
     CheckButton(IDC_CASE_SENSITIVE, 0 == (m_search_flags & rrx::IGNORE_CASE));
@@ -320,11 +363,8 @@ bool GrepDlg::PreTranslateMessage(MSG* pmsg)
             }
             else if (key == 'A' && GetKeyState(VK_CONTROL) < 0)
             {
-                const int cnt = m_result_list.GetItemCount();
-                for (int i = 0; i < cnt; i++)
-                {
-                    m_result_list.SetItemState(i, LVIS_SELECTED, LVIS_SELECTED);
-                }
+                // -1 selects all items of the virtual list at once
+                m_result_list.SetItemState(-1, LVIS_SELECTED, LVIS_SELECTED);
                 return true;
             }
         }
@@ -394,6 +434,7 @@ INT_PTR GrepDlg::OnMessage(UINT msg, WPARAM wp, LPARAM lp)
             return false;
 
         case WM_TIMER:
+            FetchResults();
             UpdateInfo();
             return true;
 
@@ -410,23 +451,15 @@ INT_PTR GrepDlg::OnMessage(UINT msg, WPARAM wp, LPARAM lp)
             }
             return false;
 
-        case WM_APP_FOUND_MATCH:
-            m_num_file_matches += 1;
-            m_num_matches += static_cast<UINT>(wp);
-            AddResult(i2p<SearchResult*>(lp));
-            return true;
-
-        case WM_APP_PROGRESS:
-            if (wp)
-            {
-                m_num_searched++;
-            }
-            m_num_processed++;
-            m_current_file = i2p<PCWSTR>(lp);
+        case WM_APP_RESULTS:
+            FetchResults();
             return true;
 
         case WM_APP_END_SEARCH:
         {
+            // The search thread is done, so everything it found is already
+            // waiting in the queue.
+            FetchResults();
             BaseWnd progress(GetItem(IDC_PROGRESS));
             progress.SendMessage(PBM_SETMARQUEE, 0, 0);
             progress.ModifyStyle(PBS_MARQUEE, 0);
@@ -468,18 +501,12 @@ INT_PTR GrepDlg::OnMessage(UINT msg, WPARAM wp, LPARAM lp)
 
 void GrepDlg::OpenFileFromList(int idx, bool in_explorer)
 {
-    WCHAR line_no[64];
-    LVITEM lvi;
-    lvi.iItem = idx;
-    lvi.iSubItem = COL_LINE;
-    lvi.mask = LVIF_TEXT | LVIF_PARAM;
-    lvi.pszText = line_no;
-    lvi.cchTextMax = ARRAYSIZE(line_no);
-    if (m_result_list.GetItem(lvi))
+    if (idx >= 0 && static_cast<size_t>(idx) < m_store.num_rows())
     {
-        UINT ridx = static_cast<UINT>(lvi.lParam);
-        PCWSTR path = m_results[ridx].path;
-        const bool is_binary = (m_results[ridx].encoding == TE_BINARY);
+        const UINT file = m_store.file_id(idx);
+        const Yast line_no(ItemText(idx, COL_LINE));
+        PCWSTR path = m_store.path(file);
+        const bool is_binary = (m_store.encoding(file) == TE_BINARY);
         PCWSTR cmd = nullptr;
         if (!is_binary && m_editor_cmd.find(L"%path%") >= 0)
         {
@@ -560,17 +587,16 @@ void GrepDlg::CopyToClipboard(ClipSource src)
     int idx = m_result_list.GetNextItem(-1, LVNI_SELECTED);
     while (idx >= 0)
     {
-        size_t ridx = m_result_list.GetItemData(idx);
-        Yast add(m_results[ridx].path);
+        Yast add(m_store.path(m_store.file_id(idx)));
         // src == cs_path is already handled by line above
         if (src == cs_result)
         {
             add.format(
                 L"%s, %s, %s, %s",
-                m_result_list.GetItemText(idx, COL_NAME).str(),
-                m_result_list.GetItemText(idx, COL_ENC).str(),
-                m_result_list.GetItemText(idx, COL_LINE).str(),
-                m_result_list.GetItemText(idx, COL_TEXT).str()
+                ItemText(idx, COL_NAME).str(),
+                ItemText(idx, COL_ENC).str(),
+                ItemText(idx, COL_LINE).str(),
+                ItemText(idx, COL_TEXT).str()
                 );
         }
         else if (src == cs_csv_result)
@@ -578,13 +604,13 @@ void GrepDlg::CopyToClipboard(ClipSource src)
             PCWSTR sep = m_csv_sep.str();
             add.format(
                 L"%s%s%s%s%s%s%s",
-                m_result_list.GetItemText(idx, COL_NAME).str(),
+                ItemText(idx, COL_NAME).str(),
                 sep,
-                m_result_list.GetItemText(idx, COL_ENC).str(),
+                ItemText(idx, COL_ENC).str(),
                 sep,
-                m_result_list.GetItemText(idx, COL_LINE).str(),
+                ItemText(idx, COL_LINE).str(),
                 sep,
-                m_result_list.GetItemText(idx, COL_TEXT).str()
+                ItemText(idx, COL_TEXT).str()
                 );
         }
         else if (src == cs_filename)
@@ -595,7 +621,7 @@ void GrepDlg::CopyToClipboard(ClipSource src)
         }
         else if (src == cs_text)
         {
-            add = m_result_list.GetItemText(idx, COL_TEXT);
+            add = ItemText(idx, COL_TEXT);
         }
         if (src == cs_text || add != last)
         {
@@ -617,6 +643,11 @@ bool GrepDlg::OnNotify(UINT CtrlId, NMHDR *phdr)
 {
     if (CtrlId == IDC_RESULT_LIST)
     {
+        if (phdr->code == LVN_GETDISPINFO)
+        {
+            OnGetDispInfo(p2p<NMLVDISPINFO*>(phdr)->item);
+            return true;
+        }
         NMITEMACTIVATE *pia = p2p<NMITEMACTIVATE*>(phdr);
         if (pia->hdr.code == NM_DBLCLK)
         {
@@ -741,7 +772,9 @@ bool GrepDlg::OnCommand(UINT CmdId, UINT Notification, HWND Ctrl)
 
         case IDC_RADIO_REGEX:
         case IDC_RADIO_LITERAL:
+        case IDC_RADIO_LIST:
             m_search_regex = IsButtonChecked(IDC_RADIO_REGEX);
+            m_search_list = IsButtonChecked(IDC_RADIO_LIST);
             CheckValidSearchText();
             break;
 
@@ -837,12 +870,19 @@ bool GrepDlg::OnCommand(UINT CmdId, UINT Notification, HWND Ctrl)
 
         case IDC_SETTINGS:
         {
-            SettingsDlg sd(this, m_editor_cmd, m_viewer_cmd, m_csv_sep);
+            SettingsDlg sd(
+                this,
+                m_editor_cmd,
+                m_viewer_cmd,
+                m_csv_sep,
+                m_num_workers
+                );
             if (sd.DoModal() == IDOK)
             {
                 m_editor_cmd = sd.get_edit_cmd();
                 m_viewer_cmd = sd.get_view_cmd();
                 m_csv_sep = sd.get_csv_sep();
+                m_num_workers = sd.get_num_workers();
             }
             break;
         }
@@ -954,6 +994,7 @@ void GrepDlg::InitializePosition(WINDOWPLACEMENT* pwp)
         { IDC_MULTI_LINE,           AP_TOPLEFT,    AP_TOPLEFT,     false },
         { IDC_PROGRESS,             AP_TOPLEFT,    AP_TOPRIGHT,    false },
         { IDC_RADIO_LITERAL,        AP_TOPLEFT,    AP_TOPLEFT,     false },
+        { IDC_RADIO_LIST,           AP_TOPLEFT,    AP_TOPLEFT,     false },
         { IDC_RADIO_REGEX,          AP_TOPLEFT,    AP_TOPLEFT,     false },
         { IDC_REPLACE_TEXT,         AP_TOPLEFT,    AP_TOPRIGHT,    false },
         { IDC_REPLACE_TEXT_LABEL,   AP_TOPLEFT,    AP_TOPLEFT,     false },
@@ -1068,6 +1109,47 @@ bool GrepDlg::OkToModifyWithoutBackups(const Yast& search, const Yast& replace)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+//
+// In pattern list mode the search text is either a list of literals
+// separated by '|' or '@' followed by the path of a file, that contains one
+// literal per line.
+//
+static bool load_pattern_list(const Yast& text, YastVector& patterns)
+{
+    YastVector items;
+    if (text.str()[0] == '@')
+    {
+        TextFile tf;
+        const Yast path(text.str() + 1, text.length() - 1);
+        if (!tf.load(path, true, false))
+        {
+            return false;
+        }
+        items = tf.get_content().split(L"\n");
+    }
+    else
+    {
+        items = text.split(L"|");
+    }
+
+    patterns.clear();
+    for (const Yast& item : items)
+    {
+        UINT len = item.length();
+        if (len && item.str()[len - 1] == '\r')
+        {
+            --len;
+        }
+        if (len)
+        {
+            patterns.push_back(Yast(item.str(), len));
+        }
+    }
+    return patterns.size() != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool GrepDlg::PrepareSearchParams(SearchParams& params, bool do_replace)
 {
     CheckValidSearchText();
@@ -1089,8 +1171,20 @@ bool GrepDlg::PrepareSearchParams(SearchParams& params, bool do_replace)
         TRACE("path, text or both are empty\n");
         return false;
     }
-    const UINT flags = m_search_flags | (m_search_regex ? 0: rrx::LITERAL);
-    params.rx_search = rrx::compile(search_text, flags);
+    if (m_search_list)
+    {
+        if (!load_pattern_list(search_text, m_list_patterns))
+        {
+            TRACE("prep no patterns in '%S'\n", search_text.str());
+            return false;
+        }
+        params.rx_search = rrx::compile_list(m_list_patterns, m_search_flags);
+    }
+    else
+    {
+        const UINT flags = m_search_flags | (m_search_regex ? 0: rrx::LITERAL);
+        params.rx_search = rrx::compile(search_text, flags);
+    }
     if (!params.rx_search)
     {
         TRACE("prep '%S' does not compile\n", search_text.str());
@@ -1111,7 +1205,7 @@ bool GrepDlg::PrepareSearchParams(SearchParams& params, bool do_replace)
         params.rx_exclude = rrx::compile(exclude_text, rrx::IGNORE_CASE);
     }
     params.rx_include = nullptr;
-    params.inc_patterns.clear();
+    params.inc_globs.clear();
     if (!include_text.is_empty())
     {
         if (m_include_regex)
@@ -1120,15 +1214,18 @@ bool GrepDlg::PrepareSearchParams(SearchParams& params, bool do_replace)
         }
         else
         {
-            params.inc_patterns = include_text.split(L"|");
-            for (auto& s : params.inc_patterns)
-            {
-                s.to_lower();
-            }
+            params.inc_globs.compile(include_text);
         }
     }
 
-    if (!m_search_regex && m_search_binary)
+    // If rx_search is able to search binary files as they are, it looks
+    // for the UTF-16 form of the literal too.
+    if (
+        !m_search_regex &&
+        !m_search_list &&
+        m_search_binary &&
+        !params.rx_search->searches_binary()
+        )
     {
         Yast search_text_utf16(2 * search_text.length());
         PWSTR pstu = search_text_utf16;
@@ -1154,13 +1251,37 @@ bool GrepDlg::PrepareSearchParams(SearchParams& params, bool do_replace)
     m_ac_inc_files.add_entry(include_text);
 
     params.p_ctxt = this;
-    params.next_cb = OnNext;
-    params.match_found_cb = OnMatch;
+    params.results_cb = OnResults;
     params.end_search_cb = OnEndSearch;
+    params.num_workers = m_num_workers;
+    params.num_walkers = m_num_walkers;
+    params.window_overlap = m_window_overlap;
+    params.prefetch_depth = m_prefetch_depth;
+    params.prefetch_budget = size_t(m_prefetch_mb) * 1024 * 1024;
     params.search_subdirs = m_search_subdirs;
     params.search_binary = m_search_binary;
     params.do_replace = do_replace;
     params.create_backups = m_create_backups;
+    params.use_index = m_use_index;
+    params.use_ignore_files = m_use_gitignore;
+    params.cache_size = size_t(m_cache_mb) * 1024 * 1024;
+    params.meta.min_size = ULONGLONG(m_min_size_kb) * 1024;
+    params.meta.max_size = ULONGLONG(m_max_size_mb) * 1024 * 1024;
+    params.meta.skip_attributes = m_skip_attributes;
+    if (m_max_age_days)
+    {
+        // FILETIME counts in units of 100ns
+        const ULONGLONG DAY = 24ull * 60 * 60 * 10000000;
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        params.meta.modified_after = (
+            ((ULONGLONG(now.dwHighDateTime) << 32) | now.dwLowDateTime) -
+            m_max_age_days * DAY
+            );
+    }
+    params.cache_file = (
+        m_persist_cache ? app_data_path(L"results.rgc") : Yast()
+        );
 
     TRACE("params ok!\n");
     return true;
@@ -1180,13 +1301,31 @@ void GrepDlg::StartSearch(bool do_replace)
     SetFocus(GetDlgItem(IDC_DO_SEARCH));
     SaveSettings();
 
-    m_results.clear();
+    m_store.clear();
+    m_file_icons.clear();
     GetItem(IDC_DO_SEARCH).SetText(L"&Stop");
     BaseWnd progress(GetItem(IDC_PROGRESS));
     progress.ModifyStyle(0, PBS_MARQUEE);
     progress.SendMessage(PBM_SETMARQUEE, 1, 0);
     m_result_list.DeleteAllItems();
 
+    // Which literal matched is only of interest for pattern lists.
+    const bool has_pattern_col = (
+        m_result_list.GetColumnCount() > static_cast<int>(COL_PATTERN)
+        );
+    if (m_search_list && !has_pattern_col)
+    {
+        LVCOLUMN column;
+        column.mask = LVCF_FMT | LVCF_TEXT;
+        column.fmt = LVCFMT_LEFT;
+        column.pszText = const_cast<PWSTR>(L"Pattern");
+        m_result_list.InsertColumn(COL_PATTERN, column);
+    }
+    else if (!m_search_list && has_pattern_col)
+    {
+        m_result_list.SendMessage(LVM_DELETECOLUMN, COL_PATTERN, 0);
+    }
+
     m_num_processed = m_num_searched = 0;
     m_num_matches = m_num_file_matches = 0;
     m_current_file = L"";
@@ -1201,73 +1340,139 @@ void GrepDlg::StartSearch(bool do_replace)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void GrepDlg::AddResult(SearchResult* result)
+void GrepDlg::FetchResults()
 {
-    m_results.push_back(*result);
-    m_result_list.SendMessage(WM_SETREDRAW, false, 0);
+    m_thread.get_progress(m_num_processed, m_num_searched, m_current_file);
+
+    SearchResult result;
+    size_t num_matches;
+    const size_t old_rows = m_store.num_rows();
+    while (m_thread.fetch_result(result, num_matches))
+    {
+        m_num_file_matches += 1;
+        m_num_matches += static_cast<UINT>(num_matches);
+        AddResult(result);
+    }
 
-    PCWSTR disp_name = result->path.str() + result->path_prefix_len;
-    PCWSTR enc = L"?";
-    switch (result->encoding)
+    // The list is virtual, it only needs to know how many rows there are.
+    // It asks for the visible ones itself (see OnGetDispInfo).
+    if (m_store.num_rows() != old_rows)
     {
-        case TE_BINARY: enc = L"bin"; break;
-        case TE_ANSI: enc = L"ansi"; break;
-        case TE_UTF16_LE:
-        case TE_UTF16_LE_BOM: enc = L"utf16"; break;
-        case TE_UTF8:
-        case TE_UTF8_BOM: enc = L"utf8"; break;
+        m_result_list.SendMessage(
+            LVM_SETITEMCOUNT,
+            m_store.num_rows(),
+            LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL
+            );
     }
+}
 
-    Yast li_str;
-    LVITEM lvi;
-    lvi.mask = LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM;
-    lvi.pszText = (
-        static_cast<PWSTR>(result->path) + result->path_prefix_len
+////////////////////////////////////////////////////////////////////////////////
+
+void GrepDlg::AddResult(SearchResult& result)
+{
+    const UINT file = m_store.add_file(
+        result.path.str(),
+        result.path.length(),
+        result.path_prefix_len,
+        result.encoding
         );
-    lvi.iImage = SysIconIdx::file(disp_name);
-    lvi.lParam = m_results.size() - 1;
-    lvi.iSubItem = COL_NAME;
-    lvi.iItem = m_result_list.GetItemCount();
-    for (const auto& li: result->line_info)
+    if (file != ResultStore::NO_FILE)
+    {
+        m_file_icons.push_back(SysIconIdx::file(m_store.display_name(file)));
+        for (const LineInfo& li : result.line_info)
+        {
+            const bool added = m_store.add_row(
+                li.number,
+                li.pattern,
+                li.text_len ? &result.line_text[li.text_pos] : nullptr,
+                li.text_len
+                );
+            if (!added)
+            {
+                break;
+            }
+        }
+    }
+    result = SearchResult();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast GrepDlg::ItemText(size_t row, UINT col)
+{
+    Yast str;
+    const UINT file = m_store.file_id(row);
+    if (col == COL_NAME)
     {
-        int idx = m_result_list.InsertItem(lvi);
-        if (idx < 0)
+        str = m_store.display_name(file);
+    }
+    else if (col == COL_ENC)
+    {
+        switch (static_cast<TextEncoding>(m_store.encoding(file)))
         {
-            continue;
+            case TE_BINARY: str = L"bin"; break;
+            case TE_ANSI: str = L"ansi"; break;
+            case TE_UTF16_LE:
+            case TE_UTF16_LE_BOM: str = L"utf16"; break;
+            case TE_UTF8:
+            case TE_UTF8_BOM: str = L"utf8"; break;
+            default: str = L"?"; break;
         }
-        m_result_list.SetItemText(idx, COL_ENC, enc);
-        li_str.format(L"%u", li.number);
-        m_result_list.SetItemText(idx, COL_LINE, li_str.str());
-        li_str = li.text;
-        PWSTR p = static_cast<PWSTR>(li_str);
-        PWSTR const end = p + li_str.length();
-        while(p < end)
+    }
+    else if (col == COL_LINE)
+    {
+        str.format(L"%I64u", m_store.line_number(row));
+    }
+    else if (col == COL_TEXT)
+    {
+        UINT len;
+        PCWSTR text = m_store.text(row, len);
+        if (text != nullptr)
         {
-            if (*p == '\r' || *p == '\n' || *p == '\t')
+            str = Yast(text, len);
+            PWSTR p = static_cast<PWSTR>(str);
+            PWSTR const end = p + str.length();
+            while(p < end)
             {
-                *p = L' ';
+                if (*p == '\r' || *p == '\n' || *p == '\t')
+                {
+                    *p = L' ';
+                }
+                p++;
             }
-            p++;
         }
-        m_result_list.SetItemText(idx, COL_TEXT, li_str.str());
-        lvi.iItem++;
     }
-
-    m_result_list.SendMessage(WM_SETREDRAW, true, 0);
-    RedrawWindow(
-        m_result_list,
-        nullptr,
-        nullptr,
-        RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN
-        );
+    else if (col == COL_PATTERN)
+    {
+        // The column only exists while the results of a pattern list are
+        // shown.
+        const UINT pattern = m_store.pattern(row);
+        if (pattern < m_list_patterns.size())
+        {
+            str = m_list_patterns[pattern];
+        }
+    }
+    return str;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void GrepDlg::OnNext(void *pCtxt, bool was_searched, PCWSTR name)
+void GrepDlg::OnGetDispInfo(LVITEM& item)
 {
-    GrepDlg *self = static_cast<GrepDlg*>(pCtxt);
-    self->SendMessage(WM_APP_PROGRESS, was_searched, p2lp(name));
+    if (item.iItem < 0 || static_cast<size_t>(item.iItem) >= m_store.num_rows())
+    {
+        return;
+    }
+    const UINT col = static_cast<UINT>(item.iSubItem);
+    if ((item.mask & LVIF_IMAGE) && col == COL_NAME)
+    {
+        item.iImage = m_file_icons[m_store.file_id(item.iItem)];
+    }
+    if ((item.mask & LVIF_TEXT) && item.cchTextMax > 0)
+    {
+        const Yast text(ItemText(item.iItem, col));
+        lstrcpyn(item.pszText, text.str(), item.cchTextMax);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1280,10 +1485,10 @@ void GrepDlg::OnEndSearch(void *pCtxt)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void GrepDlg::OnMatch(void *pCtxt, size_t num_matches, SearchResult& result)
+void GrepDlg::OnResults(void *pCtxt)
 {
     GrepDlg *self = static_cast<GrepDlg*>(pCtxt);
-    self->SendMessage(WM_APP_FOUND_MATCH, num_matches, p2lp(&result));
+    self->PostMessage(WM_APP_RESULTS, 0, 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
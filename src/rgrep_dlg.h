@@ -33,6 +33,7 @@
 #include "rgrep_rx.h"
 #include "auto_complete_cb.h"
 #include "search_thread.h"
+#include "result_store.h"
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -47,7 +48,8 @@ public:
 
 private:
     SearchThread        m_thread;
-    SearchResults       m_results;
+    ResultStore         m_store;
+    cvector<int>        m_file_icons;
     ResizeDlgLayout     m_layout;
     ListCtrl            m_result_list;
     AutoCompleteCombo   m_ac_path;
@@ -60,15 +62,30 @@ private:
     Yast                m_initial_path;
     Yast                m_csv_sep;
     Yast                m_current_file;
+    YastVector          m_list_patterns;
     HMENU               m_ctxt_menu;
     HWND                m_last_focus;
     UINT                m_search_flags;
+    UINT                m_num_workers;
+    UINT                m_num_walkers;
+    UINT                m_window_overlap;
+    UINT                m_prefetch_depth;   // 0 -> no reading ahead
+    UINT                m_prefetch_mb;
+    UINT                m_cache_mb;         // 0 -> no ResultCache
+    UINT                m_min_size_kb;      // see MetaFilter, 0 -> no limit
+    UINT                m_max_size_mb;
+    UINT                m_max_age_days;
+    UINT                m_skip_attributes;  // FILE_ATTRIBUTE_*
     UINT                m_num_processed;
     UINT                m_num_searched;
     UINT                m_num_matches;
     UINT                m_num_file_matches;
     bool                m_create_backups;
+    bool                m_use_index;
+    bool                m_use_gitignore;
+    bool                m_persist_cache;
     bool                m_search_regex;
+    bool                m_search_list;
     bool                m_include_regex;
     bool                m_search_subdirs;
     bool                m_search_binary;
@@ -84,7 +101,10 @@ private:
 
     bool PrepareSearchParams(SearchParams& params, bool do_replace);
     void StartSearch(bool do_replace);
-    void AddResult(SearchResult* result);
+    void FetchResults();
+    void AddResult(SearchResult& result);
+    Yast ItemText(size_t row, UINT col);
+    void OnGetDispInfo(LVITEM& item);
 
     void InitializePosition(WINDOWPLACEMENT* pwp);
     void InitializeResultList();
@@ -115,20 +135,19 @@ private:
 
     // Callbacks from search thread
     // These need to switch to the GUI thread.
-    static void OnNext(void *pCtxt, bool was_searched, PCWSTR name);
     static void OnEndSearch(void *pCtxt);
-    static void OnMatch(void *pCtxt, size_t num_matches, SearchResult& result);
+    static void OnResults(void *pCtxt);
 
-    static const UINT WM_APP_FOUND_MATCH = WM_APP + 0;
-    static const UINT WM_APP_PROGRESS    = WM_APP + 1;
-    static const UINT WM_APP_END_SEARCH  = WM_APP + 2;
-    static const UINT WM_APP_HACK_INIT   = WM_APP + 3;
+    static const UINT WM_APP_RESULTS     = WM_APP + 0;
+    static const UINT WM_APP_END_SEARCH  = WM_APP + 1;
+    static const UINT WM_APP_HACK_INIT   = WM_APP + 2;
 
     static const UINT LABEL_TIMER = 1;
     static const UINT COL_NAME = 0;
     static const UINT COL_ENC  = 1;
     static const UINT COL_LINE = 2;
     static const UINT COL_TEXT = 3;
+    static const UINT COL_PATTERN = 4;  // only for pattern lists
 
     static const UINT SYSM_PCRE = 1;
 };
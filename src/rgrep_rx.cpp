@@ -27,38 +27,514 @@
 
 #include "pch.h"
 #include "rgrep_rx.h"
+#include "literal_finder.h"
+#include "platform.h"
 #include "pcre2_16/pcre2.h"
 
 // We are going to pass PWSTR to PCRE, so it be better configured for
-// a code unit width of 16.
+// a code unit width of 16. The 8 bit functions are called explicitly by
+// their names with the suffix '_8'.
 static_assert(PCRE2_CODE_UNIT_WIDTH == 16, "unexpected width");
 static_assert(sizeof(PCRE2_UCHAR) == sizeof(WCHAR), "unexpected size");
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class rrx::matcher::state
+{
+public:
+    pcre2_match_data *m_match;
+    pcre2_match_context *m_context;
+    PCWSTR m_checked;               // subject that passed the UTF check
+    size_t m_checked_len;
+    size_t m_checked_from;          // the check started at this offset
+    pcre2_match_data_8 *m_match8;   // only created for 8 bit subjects
+    pcre2_match_context_8 *m_context8;
+    PCRE2_SPTR8 m_checked8;
+    size_t m_checked8_len;
+    size_t m_checked8_from;
+    bool m_bad_utf;
+#ifdef SUPPORT_JIT
+    pcre2_jit_stack *m_jit_stack;
+    pcre2_jit_stack_8 *m_jit_stack8;
+#endif
+
+    // We are only interested in the range of the whole match, so a single
+    // pair of offsets is enough - regardless of the pattern.
+    state() :
+        m_match(pcre2_match_data_create(1, nullptr)),
+        m_context(nullptr),
+        m_checked(nullptr),
+        m_checked_len(0),
+        m_checked_from(0),
+        m_match8(nullptr),
+        m_context8(nullptr),
+        m_checked8(nullptr),
+        m_checked8_len(0),
+        m_checked8_from(0),
+        m_bad_utf(false)
+#ifdef SUPPORT_JIT
+        , m_jit_stack(nullptr)
+        , m_jit_stack8(nullptr)
+#endif
+    {
+    }
+
+    ~state()
+    {
+        if (m_match) pcre2_match_data_free(m_match);
+        if (m_context) pcre2_match_context_free(m_context);
+        if (m_match8) pcre2_match_data_free_8(m_match8);
+        if (m_context8) pcre2_match_context_free_8(m_context8);
+#ifdef SUPPORT_JIT
+        if (m_jit_stack) pcre2_jit_stack_free(m_jit_stack);
+        if (m_jit_stack8) pcre2_jit_stack_free_8(m_jit_stack8);
+#endif
+    }
+
+    pcre2_match_data_8* match_data8()
+    {
+        if (m_match8 == nullptr)
+        {
+            m_match8 = pcre2_match_data_create_8(1, nullptr);
+        }
+        return m_match8;
+    }
+
+    // Every matcher has its own match context, that is only created when
+    // needed. The offset limit is set for every match, since the same
+    // context is used with different patterns.
+    pcre2_match_context* context(size_t limit)
+    {
+        if (m_context == nullptr)
+        {
+            m_context = pcre2_match_context_create(nullptr);
+#ifdef SUPPORT_JIT
+            m_jit_stack = pcre2_jit_stack_create(
+                JIT_STACK_START,
+                JIT_STACK_MAX,
+                nullptr
+                );
+            if (m_context && m_jit_stack)
+            {
+                pcre2_jit_stack_assign(m_context, nullptr, m_jit_stack);
+            }
+#endif
+        }
+        if (m_context)
+        {
+            pcre2_set_offset_limit(m_context, limit);
+        }
+        return m_context;
+    }
+
+    pcre2_match_context_8* context8(size_t limit)
+    {
+        if (m_context8 == nullptr)
+        {
+            m_context8 = pcre2_match_context_create_8(nullptr);
+#ifdef SUPPORT_JIT
+            m_jit_stack8 = pcre2_jit_stack_create_8(
+                JIT_STACK_START,
+                JIT_STACK_MAX,
+                nullptr
+                );
+            if (m_context8 && m_jit_stack8)
+            {
+                pcre2_jit_stack_assign_8(m_context8, nullptr, m_jit_stack8);
+            }
+#endif
+        }
+        if (m_context8)
+        {
+            pcre2_set_offset_limit_8(m_context8, limit);
+        }
+        return m_context8;
+    }
+
+#ifdef SUPPORT_JIT
+    // The default JIT stack of 32K lives on the machine stack and is too
+    // small for some patterns. So every matcher gets its own one, that is
+    // able to grow.
+    static const size_t JIT_STACK_START = 32 * 1024;
+    static const size_t JIT_STACK_MAX = 1024 * 1024;
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 class rrx::pimpl
 {
 public:
     pcre2_code *m_code;
-    pcre2_match_data *m_match;
+    pcre2_code_8 *m_code_utf8;
+    pcre2_code_8 *m_code_ansi;      // nullptr if ANSI has to be converted
+    bool m_jit;
+    bool m_jit_utf8;
+    bool m_jit_ansi;
+
+    // Used instead of PCRE for searching, if the regex is a LITERAL and
+    // they are valid.
+    LiteralFinder<WCHAR> m_literal16;
+    LiteralFinder<char> m_literal8;
+    BinaryFinder m_binary;
+
+    // A literal that every match has to contain. If they are valid, PCRE
+    // is only started where it occurs.
+    LiteralFinder<WCHAR> m_required16;
+    LiteralFinder<char> m_required8;
+    bool m_single_line;             // no match can span lines
+
+    // The LITERAL itself or the required literal (see rrx::required_text).
+    Yast m_required_text;
+    bool m_ignore_case;
+
+    ULONGLONG m_hash;               // see rrx::hash
 
-    pimpl() : m_code(nullptr), m_match(nullptr)
+    // Used instead of PCRE for a list of literals (see compile_list).
+    MultiLiteralFinder<WCHAR> m_list16;
+    MultiLiteralFinder<char> m_list8;
+    bool m_list_ansi;               // m_list8 can search ANSI subjects too
+    bool m_list_marks;              // PCRE searches the list, marks tell
+                                    // the index (see compile_alternation)
+
+    pimpl() :
+        m_code(nullptr),
+        m_code_utf8(nullptr),
+        m_code_ansi(nullptr),
+        m_jit(false),
+        m_jit_utf8(false),
+        m_jit_ansi(false),
+        m_single_line(false),
+        m_ignore_case(false),
+        m_hash(0),
+        m_list_ansi(false),
+        m_list_marks(false)
     {
     }
 
     ~pimpl()
     {
         if (m_code) pcre2_code_free(m_code);
-        if (m_match) pcre2_match_data_free(m_match);
+        if (m_code_utf8) pcre2_code_free_8(m_code_utf8);
+        if (m_code_ansi) pcre2_code_free_8(m_code_ansi);
     }
 
     bool compile(const Yast& regex, UINT flags);
-    bool search(range& found, const Yast& subject, size_t offset) const;
+    void compile8(const Yast& actual_rx, uint32_t options, bool jit);
+    bool compile_list(const YastVector& literals, UINT flags);
+    bool compile_alternation(const YastVector& literals, UINT flags);
+    int match(
+        matcher::state& ms,
+        PCWSTR str,
+        size_t len,
+        size_t offset,
+        size_t limit
+        ) const;
+    int match(
+        matcher::state& ms,
+        const bytes& subject,
+        size_t offset,
+        size_t limit
+        ) const;
+    bool search(
+        matcher::state& ms,
+        range& found,
+        PCWSTR str,
+        size_t len,
+        size_t offset
+        ) const;
+    bool search(
+        matcher::state& ms,
+        range& found,
+        const bytes& subject,
+        size_t offset
+        ) const;
     Yast replace(const Yast& subject, const Yast& replacement) const;
+    Yast replace_list(const Yast& subject, const Yast& replacement) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static bool one_of(WCHAR c, PCWSTR set)
+{
+    for (; *set; ++set)
+    {
+        if (c == *set)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool is_ascii_alnum(WCHAR c)
+{
+    return (
+        (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9')
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Escapes that might match a line end.
+static const PCWSTR MULTI_LINE_ESCAPES = L"sWDHvRnXCNpPxoc0123456789";
+static const PCWSTR HEX_DIGITS = L"0123456789abcdefABCDEF";
+
+////////////////////////////////////////////////////////////////////////////////
+
+static PCWSTR skip_class(PCWSTR p, PCWSTR end, bool& single_line)
+{
+    // p points behind the opening '['
+    if (p < end && *p == '^')
+    {
+        single_line = false;
+        ++p;
+    }
+    if (p < end && *p == ']')
+    {
+        ++p;
+    }
+    while (p < end && *p != ']')
+    {
+        if (*p == '\\' && p + 1 < end)
+        {
+            single_line &= !one_of(p[1], MULTI_LINE_ESCAPES);
+            p += 2;
+        }
+        else if (*p == '[' && p + 1 < end && one_of(p[1], L":.="))
+        {
+            // POSIX class like [:space:]
+            const WCHAR term = p[1];
+            single_line = false;
+            for (p += 2; p + 1 < end && !(p[0] == term && p[1] == ']'); ++p);
+            p += 2;
+        }
+        else
+        {
+            single_line &= (*p != '\n');
+            ++p;
+        }
+    }
+    return (p < end) ? p + 1 : end;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static PCWSTR skip_escape_arg(WCHAR e, PCWSTR p, PCWSTR end)
+{
+    // p points behind an escape like '\x', that might have an argument
+    if (p < end && *p == '{' && one_of(e, L"xopPgkN"))
+    {
+        while (p < end && *p++ != '}');
+    }
+    else if (p < end && (*p == '<' || *p == '\'') && one_of(e, L"gk"))
+    {
+        const WCHAR term = (*p == '<') ? '>' : '\'';
+        for (++p; p < end && *p++ != term;);
+    }
+    else if (e == 'x')
+    {
+        for (int i = 0; i < 2 && p < end && one_of(*p, HEX_DIGITS); ++i, ++p);
+    }
+    else if (e == 'c' || e == 'p' || e == 'P')
+    {
+        p += (p < end) ? 1 : 0;
+    }
+    else if ((e >= '0' && e <= '9') || e == 'g')
+    {
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+'))
+        {
+            ++p;
+        }
+    }
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Determines the longest string that every match of regex has to contain.
+// Only characters at the top level of regex are taken into account.
+// Anything else (groups, classes, escapes with a special meaning) just
+// separates the candidates. Alternatives at the top level and option
+// settings make it give up. It also finds out, whether a match might span
+// lines. Both is done conservatively: Rather miss a literal than report
+// a wrong one.
+//
+static Yast required_literal(const Yast& regex, UINT flags, bool& single_line)
+{
+    const bool ignore_case = (flags & rrx::IGNORE_CASE) != 0;
+    single_line = (flags & rrx::DOT_ALL) == 0;
+
+    PCWSTR p = regex.str();
+    PCWSTR const end = p + regex.length();
+    cvector<WCHAR> run;
+    cvector<WCHAR> best;
+    UINT depth = 0;
+    bool in_quote = false;
+    while (p < end)
+    {
+        const bool top_level = (depth == 0);
+        const WCHAR c = *p++;
+        WCHAR lit = 0;              // the character, if c starts a literal
+        bool quantifier = false;
+        bool optional = false;
+        if (in_quote)
+        {
+            if (c == '\\' && p < end && *p == 'E')
+            {
+                in_quote = false;
+                ++p;
+                continue;
+            }
+            lit = c;
+        }
+        else switch (c)
+        {
+            case '\\':
+            {
+                if (p == end)
+                {
+                    return Yast();
+                }
+                const WCHAR e = *p++;
+                if (e == 'Q' || e == 'E')
+                {
+                    in_quote = (e == 'Q');
+                    continue;
+                }
+                if (is_ascii_alnum(e))
+                {
+                    single_line &= !one_of(e, MULTI_LINE_ESCAPES);
+                    p = skip_escape_arg(e, p, end);
+                }
+                else
+                {
+                    lit = e;
+                }
+                break;
+            }
+
+            case '(':
+                // (*VERB) might change the meaning of a line end,
+                // (?i) and the like the meaning of the following literals
+                single_line &= !(p < end && *p == '*');
+                if (p + 1 < end && *p == '?' && one_of(p[1], L"imnsxJU-^)#"))
+                {
+                    return Yast();
+                }
+                ++depth;
+                break;
+
+            case ')':
+                depth -= (depth > 0) ? 1 : 0;
+                break;
+
+            case '|':
+                if (depth == 0)
+                {
+                    return Yast();
+                }
+                break;
+
+            case '[':
+                p = skip_class(p, end, single_line);
+                break;
+
+            case '*':
+            case '?':
+                quantifier = optional = true;
+                break;
+
+            case '+':
+                quantifier = true;
+                break;
+
+            case '{':
+            {
+                // {n}, {n,} or {n,m}; anything else is not taken literally
+                PCWSTR q = p;
+                bool zero = true;
+                for (; q < end && *q >= '0' && *q <= '9'; ++q)
+                {
+                    zero &= (*q == '0');
+                }
+                if (q == p)
+                {
+                    break;
+                }
+                if (q < end && *q == ',')
+                {
+                    for (++q; q < end && *q >= '0' && *q <= '9'; ++q);
+                }
+                if (q < end && *q == '}')
+                {
+                    p = q + 1;
+                    quantifier = true;
+                    optional = zero;
+                }
+                break;
+            }
+
+            case '.':
+            case '^':
+            case '$':
+                break;
+
+            default:
+                lit = c;
+                break;
+        }
+
+        single_line &= (lit != '\n');
+        if (!top_level)
+        {
+            continue;
+        }
+
+        // Only ASCII letters can be compared caselessly without PCRE. 'k'
+        // and 's' are special, since they match KELVIN SIGN and LATIN
+        // SMALL LETTER LONG S too.
+        if (
+            lit != 0 &&
+            (!ignore_case || (lit < 0x80 && !one_of(lit, L"kKsS")))
+            )
+        {
+            run.push_back(lit);
+            continue;
+        }
+
+        // Everything else ends the current run. A quantifier that allows
+        // zero repetitions removes the last character from the run.
+        if (quantifier && optional && run.size() != 0)
+        {
+            run.pop_back();
+        }
+        if (run.size() > best.size())
+        {
+            best = run;
+        }
+        run.clear();
+    }
+    if (run.size() > best.size())
+    {
+        best = run;
+    }
+
+    // Searching for a single character would hardly pay off.
+    return (
+        (best.size() >= 2) ?
+        Yast(&best[0], static_cast<UINT>(best.size())) :
+        Yast()
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool rrx::pimpl::compile(const Yast& regex, UINT flags)
 {
     // While most of the options could be transfered to PCRE as options bits,
@@ -76,6 +552,17 @@ bool rrx::pimpl::compile(const Yast& regex, UINT flags)
     if (flags & DOT_ALL) options |= PCRE2_DOTALL;
     if (flags & MULTI_LINE) options |= PCRE2_MULTILINE;
 
+    bool single_line = false;
+    Yast required;
+    if (!(flags & LITERAL))
+    {
+        required = required_literal(regex, flags, single_line);
+        if (!required.is_empty() && single_line)
+        {
+            options |= PCRE2_USE_OFFSET_LIMIT;
+        }
+    }
+
     Yast actual_rx(regex);
     if (flags & LITERAL)
     {
@@ -99,7 +586,57 @@ bool rrx::pimpl::compile(const Yast& regex, UINT flags)
     if (code)
     {
         m_code = code;
-        m_match = pcre2_match_data_create_from_pattern(m_code, nullptr);
+        const bool jit = (flags & NO_JIT) == 0;
+#ifdef SUPPORT_JIT
+        // If JIT compilation fails, we simply keep using the interpreter.
+        m_jit = jit && pcre2_jit_compile(m_code, PCRE2_JIT_COMPLETE) == 0;
+        TRACE("rrx: jit %s\n", m_jit ? "ok" : "FAILED");
+#endif
+        compile8(actual_rx, options, jit);
+        m_ignore_case = (flags & IGNORE_CASE) != 0;
+        if (!required.is_empty())
+        {
+            const bool ignore_case = (flags & IGNORE_CASE) != 0;
+            CharFromW utf8(CP_UTF8, nullptr);
+            utf8 = required.str();
+            m_required16.init(
+                required.str(),
+                required.length(),
+                ignore_case,
+                false
+                );
+            m_required8.init(utf8.str(), utf8.length(), ignore_case, false);
+            m_single_line = single_line;
+            m_required_text = required;
+            TRACE("rrx: required '%S'\n", required.str());
+        }
+        if (flags & LITERAL)
+        {
+            // PCRE is still needed for replacing.
+            const bool ignore_case = (flags & IGNORE_CASE) != 0;
+            const bool whole_words = (flags & WHOLE_WORDS) != 0;
+            CharFromW utf8(CP_UTF8, nullptr);
+            utf8 = regex.str();
+            m_literal16.init(
+                regex.str(),
+                regex.length(),
+                ignore_case,
+                whole_words
+                );
+            m_literal8.init(
+                utf8.str(),
+                utf8.length(),
+                ignore_case,
+                whole_words
+                );
+            m_binary.init(
+                regex.str(),
+                regex.length(),
+                ignore_case,
+                whole_words
+                );
+            m_required_text = regex;
+        }
         return true;
     }
     else
@@ -112,23 +649,529 @@ bool rrx::pimpl::compile(const Yast& regex, UINT flags)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool rrx::pimpl::search(range& found, const Yast& subject, size_t offset) const
+void rrx::pimpl::compile8(
+    const Yast& actual_rx,
+    uint32_t options,
+    bool jit
+    )
 {
-    const int res = pcre2_match(
-        m_code,
-        subject.str(),
-        subject.length(),
-        offset,
-        0,
-        m_match,
+    // Compiling for 8 bit subjects is optional. If it fails, those subjects
+    // are converted to UTF-16 and searched with m_code.
+    int error_code;
+    size_t error_offset;
+    CharFromW utf8(CP_UTF8, nullptr);
+    utf8 = actual_rx.str();
+    m_code_utf8 = pcre2_compile_8(
+        p2p<PCRE2_SPTR8>(utf8.str()),
+        utf8.length(),
+        options,
+        &error_code,
+        &error_offset,
         nullptr
         );
-    const bool ok = res >= 1;
+#ifdef SUPPORT_JIT
+    m_jit_utf8 = (
+        jit &&
+        m_code_utf8 &&
+        pcre2_jit_compile_8(m_code_utf8, PCRE2_JIT_COMPLETE) == 0
+        );
+#endif
+
+    // ANSI subjects can only be searched as they are, if every character
+    // is a single byte and the pattern consists of ASCII characters only.
+    // Then each byte is simply treated as one character.
+    if (!os_ansi_is_single_byte())
+    {
+        return;
+    }
+    PCWSTR const rx = actual_rx.str();
+    for (UINT i = 0; i < actual_rx.length(); ++i)
+    {
+        if (rx[i] >= 0x80)
+        {
+            return;
+        }
+    }
+    m_code_ansi = pcre2_compile_8(
+        p2p<PCRE2_SPTR8>(utf8.str()),   // ASCII is the same in any case
+        utf8.length(),
+        options & ~(PCRE2_UTF | PCRE2_NO_UTF_CHECK),
+        &error_code,
+        &error_offset,
+        nullptr
+        );
+#ifdef SUPPORT_JIT
+    m_jit_ansi = (
+        jit &&
+        m_code_ansi &&
+        pcre2_jit_compile_8(m_code_ansi, PCRE2_JIT_COMPLETE) == 0
+        );
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::pimpl::compile_list(const YastVector& literals, UINT flags)
+{
+    const bool ignore_case = (flags & IGNORE_CASE) != 0;
+    const bool whole_words = (flags & WHOLE_WORDS) != 0;
+    CharFromW utf8(CP_UTF8, nullptr);
+    bool ascii = true;
+    for (const Yast& lit : literals)
+    {
+        utf8 = lit.str();
+        m_list16.add(lit.str(), lit.length());
+        m_list8.add(utf8.str(), utf8.length());
+        ascii = ascii && (utf8.length() == lit.length());
+    }
+    if (!m_list16.build(ignore_case, whole_words))
+    {
+        // The automaton got too large or cannot fold some characters.
+        TRACE("rrx: list of literals is searched with PCRE\n");
+        return compile_alternation(literals, flags);
+    }
+
+    // As in compile8, searching 8 bit subjects directly is optional.
+    m_list_ansi = (
+        m_list8.build(ignore_case, whole_words) &&
+        ascii &&
+        os_ansi_is_single_byte()
+        );
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void append(cvector<WCHAR>& out, PCWSTR str, size_t len)
+{
+    out.insert(out.end(), str, str + len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::pimpl::compile_alternation(const YastVector& literals, UINT flags)
+{
+    // Every literal is quoted and followed by a mark, that tells its index.
+    // PCRE takes the first alternative that matches, so the literals are
+    // ordered by decreasing length to find the longest one - just like
+    // m_list16 does. Literals of the same length keep their order.
+    if (literals.size() == 0)
+    {
+        return false;
+    }
+    for (const Yast& lit : literals)
+    {
+        if (lit.is_empty())
+        {
+            return false;
+        }
+    }
+
+    cvector<WCHAR> alt;
+    append(alt, L"(?:", 3);
+    UINT len = ~0u;
+    for (;;)
+    {
+        UINT next = 0;
+        for (const Yast& lit : literals)
+        {
+            const UINT l = lit.length();
+            next = (l < len && l > next) ? l : next;
+        }
+        if (next == 0)
+        {
+            break;
+        }
+        len = next;
+        for (UINT idx = 0; idx < literals.size(); ++idx)
+        {
+            if (literals[idx].length() != len)
+            {
+                continue;
+            }
+            if (alt.size() > 3)
+            {
+                alt.push_back('|');
+            }
+
+            // A backslash could end the quote, so it is escaped outside.
+            PCWSTR const lit = literals[idx].str();
+            append(alt, L"\\Q", 2);
+            for (UINT i = 0; i < len; ++i)
+            {
+                if (lit[i] == '\\')
+                {
+                    append(alt, L"\\E\\\\\\Q", 6);
+                }
+                else
+                {
+                    alt.push_back(lit[i]);
+                }
+            }
+            append(alt, L"\\E(*:", 5);
+            WCHAR digits[10];
+            int n = 0;
+            UINT i = idx;
+            do
+            {
+                digits[n++] = static_cast<WCHAR>('0' + i % 10);
+                i /= 10;
+            } while (i != 0);
+            while (n > 0)
+            {
+                alt.push_back(digits[--n]);
+            }
+            alt.push_back(')');
+        }
+    }
+    alt.push_back(')');
+
+    const Yast regex(&alt[0], static_cast<UINT>(alt.size()));
+    if (!compile(regex, flags & (IGNORE_CASE | WHOLE_WORDS)))
+    {
+        return false;
+    }
+    m_list_marks = true;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+static UINT mark_index(const C* mark)
+{
+    // see compile_alternation
+    UINT idx = 0;
+    while (mark && *mark)
+    {
+        idx = idx * 10 + (*mark++ - '0');
+    }
+    return idx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A match of a pattern, that cannot span lines, has to be in the same line
+// as the required literal.
+
+template <class C>
+static size_t line_begin(const C* str, size_t from, size_t pos)
+{
+    while (pos > from && str[pos - 1] != '\n')
+    {
+        --pos;
+    }
+    return pos;
+}
+
+template <class C>
+static size_t line_end(const C* str, size_t len, size_t pos)
+{
+    while (pos < len && str[pos] != '\n')
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int rrx::pimpl::match(
+    matcher::state& ms,
+    PCWSTR str,
+    size_t len,
+    size_t offset,
+    size_t limit
+    ) const
+{
+    // pcre2_match checks the subject from offset up to its end for valid
+    // UTF-16 on every call. Searching a subject for all matches would then
+    // be quadratic. So the check is only done once for a subject and
+    // skipped for the following calls at or behind that offset.
+    const bool checked = (
+        str == ms.m_checked &&
+        len == ms.m_checked_len &&
+        offset >= ms.m_checked_from
+        );
+    int res;
+#ifdef SUPPORT_JIT
+    if (m_jit && checked)
+    {
+        res = pcre2_jit_match(
+            m_code,
+            str,
+            len,
+            offset,
+            0,
+            ms.m_match,
+            ms.context(limit)
+            );
+        if (res == PCRE2_ERROR_JIT_STACKLIMIT)
+        {
+            // fall back to the interpreter
+            res = pcre2_match(
+                m_code,
+                str,
+                len,
+                offset,
+                PCRE2_NO_UTF_CHECK | PCRE2_NO_JIT,
+                ms.m_match,
+                ms.context(limit)
+                );
+        }
+    }
+    else
+#endif
+    {
+        // pcre2_match uses the JIT code itself, if there is any.
+        res = pcre2_match(
+            m_code,
+            str,
+            len,
+            offset,
+            checked ? PCRE2_NO_UTF_CHECK : 0,
+            ms.m_match,
+            ms.context(limit)
+            );
+    }
+    if (!checked)
+    {
+        const bool valid = (res >= 0 || res == PCRE2_ERROR_NOMATCH);
+        ms.m_checked = valid ? str : nullptr;
+        ms.m_checked_len = valid ? len : 0;
+        ms.m_checked_from = offset;
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::pimpl::search(
+    matcher::state& ms,
+    range& found,
+    PCWSTR str,
+    size_t len,
+    size_t offset
+    ) const
+{
+    found.pattern = 0;
+    if (m_list16.is_valid())
+    {
+        return m_list16.find(str, len, offset, found);
+    }
+    if (m_literal16.is_valid())
+    {
+        return m_literal16.find(str, len, offset, found);
+    }
+
+    if (offset == 0)
+    {
+        // a new subject, that has not been checked yet
+        ms.m_checked = nullptr;
+    }
+
+    int res = PCRE2_ERROR_NOMATCH;
+    if (!m_required16.is_valid())
+    {
+        res = match(ms, str, len, offset, PCRE2_UNSET);
+    }
+    else
+    {
+        // Only start PCRE, if the required literal is present. If matches
+        // cannot span lines, PCRE only has to look at the lines that
+        // contain it.
+        range hit;
+        while (m_required16.find(str, len, offset, hit))
+        {
+            if (!m_single_line)
+            {
+                res = match(ms, str, len, offset, PCRE2_UNSET);
+                break;
+            }
+            const size_t begin = line_begin(str, offset, hit.begin);
+            const size_t end = line_end(str, len, hit.end);
+            res = match(ms, str, len, begin, end);
+            if (res != PCRE2_ERROR_NOMATCH)
+            {
+                break;
+            }
+            offset = end + 1;
+        }
+    }
+
+    // Zero means that there was a match, but the ovector was too small to
+    // hold the captured substrings. That is fine, since we are only
+    // interested in the first pair.
+    const bool ok = res >= 0;
+    if (ok)
+    {
+        size_t *ov = pcre2_get_ovector_pointer(ms.m_match);
+        found.begin = ov[0];
+        found.end = ov[1];
+        if (m_list_marks)
+        {
+            found.pattern = mark_index(pcre2_get_mark(ms.m_match));
+        }
+    }
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int rrx::pimpl::match(
+    matcher::state& ms,
+    const bytes& subject,
+    size_t offset,
+    size_t limit
+    ) const
+{
+    const pcre2_code_8* const code = subject.utf8 ? m_code_utf8 : m_code_ansi;
+    pcre2_match_data_8* const md = ms.m_match8;
+
+    // Only UTF-8 has to be checked. This is done as for UTF-16 above,
+    // unless the caller has already done it.
+    PCRE2_SPTR8 const str = p2p<PCRE2_SPTR8>(subject.str);
+    const size_t len = subject.length;
+    const bool checked = (
+        !subject.utf8 ||
+        subject.checked || (
+            str == ms.m_checked8 &&
+            len == ms.m_checked8_len &&
+            offset >= ms.m_checked8_from
+            )
+        );
+    int res;
+#ifdef SUPPORT_JIT
+    const bool jit = subject.utf8 ? m_jit_utf8 : m_jit_ansi;
+    if (jit && checked)
+    {
+        res = pcre2_jit_match_8(
+            code,
+            str,
+            len,
+            offset,
+            0,
+            md,
+            ms.context8(limit)
+            );
+        if (res == PCRE2_ERROR_JIT_STACKLIMIT)
+        {
+            // fall back to the interpreter
+            res = pcre2_match_8(
+                code,
+                str,
+                len,
+                offset,
+                PCRE2_NO_UTF_CHECK | PCRE2_NO_JIT,
+                md,
+                ms.context8(limit)
+                );
+        }
+    }
+    else
+#endif
+    {
+        res = pcre2_match_8(
+            code,
+            str,
+            len,
+            offset,
+            checked ? PCRE2_NO_UTF_CHECK : 0,
+            md,
+            ms.context8(limit)
+            );
+    }
+    if (!checked)
+    {
+        const bool valid = (res >= 0 || res == PCRE2_ERROR_NOMATCH);
+        ms.m_checked8 = valid ? str : nullptr;
+        ms.m_checked8_len = valid ? len : 0;
+        ms.m_checked8_from = offset;
+        ms.m_bad_utf = (
+            res <= PCRE2_ERROR_UTF8_ERR1 &&
+            res >= PCRE2_ERROR_UTF8_ERR21
+            );
+    }
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::pimpl::search(
+    matcher::state& ms,
+    range& found,
+    const bytes& subject,
+    size_t offset
+    ) const
+{
+    found.pattern = 0;
+    if (m_list8.is_valid() && (subject.utf8 || m_list_ansi))
+    {
+        // The subject is not checked for valid UTF-8 in this case.
+        ms.m_bad_utf = false;
+        return m_list8.find(subject.str, subject.length, offset, found);
+    }
+
+    const pcre2_code_8* const code = subject.utf8 ? m_code_utf8 : m_code_ansi;
+    pcre2_match_data_8* const md = ms.match_data8();
+    if (code == nullptr || md == nullptr)
+    {
+        return false;
+    }
+    if (m_literal8.is_valid())
+    {
+        // The subject is not checked for valid UTF-8 in this case.
+        ms.m_bad_utf = false;
+        return m_literal8.find(subject.str, subject.length, offset, found);
+    }
+
+    PCSTR const str = subject.str;
+    const size_t len = subject.length;
+    if (offset == 0)
+    {
+        // a new subject, that has not been checked yet (see matcher::reset
+        // for subjects that are not searched from their beginning)
+        ms.m_checked8 = nullptr;
+        ms.m_bad_utf = false;
+    }
+
+    int res = PCRE2_ERROR_NOMATCH;
+    if (!m_required8.is_valid())
+    {
+        res = match(ms, subject, offset, PCRE2_UNSET);
+    }
+    else
+    {
+        // see above
+        range hit;
+        while (m_required8.find(str, len, offset, hit))
+        {
+            if (!m_single_line)
+            {
+                res = match(ms, subject, offset, PCRE2_UNSET);
+                break;
+            }
+            const size_t begin = line_begin(str, offset, hit.begin);
+            const size_t end = line_end(str, len, hit.end);
+            res = match(ms, subject, begin, end);
+            if (res != PCRE2_ERROR_NOMATCH)
+            {
+                break;
+            }
+            offset = end + 1;
+        }
+    }
+
+    const bool ok = res >= 0;
     if (ok)
     {
-        size_t *ov = pcre2_get_ovector_pointer(m_match);
+        size_t *ov = pcre2_get_ovector_pointer_8(md);
         found.begin = ov[0];
         found.end = ov[1];
+        if (m_list_marks)
+        {
+            found.pattern = mark_index(pcre2_get_mark_8(md));
+        }
     }
     return ok;
 }
@@ -137,6 +1180,11 @@ bool rrx::pimpl::search(range& found, const Yast& subject, size_t offset) const
 
 Yast rrx::pimpl::replace(const Yast& subject, const Yast& replacement) const
 {
+    if (m_list16.is_valid() || m_list_marks)
+    {
+        return replace_list(subject, replacement);
+    }
+
     const uint32_t opt = (
         PCRE2_NO_UTF_CHECK |                // do not check 'replacement'
         PCRE2_SUBSTITUTE_GLOBAL |           // replace more than once
@@ -163,7 +1211,7 @@ Yast rrx::pimpl::replace(const Yast& subject, const Yast& replacement) const
             sub_len,
             0,
             opt,
-            m_match,
+            nullptr,                        // use private match data
             nullptr,
             replacement,
             rep_len,
@@ -186,6 +1234,73 @@ Yast rrx::pimpl::replace(const Yast& subject, const Yast& replacement) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+Yast rrx::pimpl::replace_list(
+    const Yast& subject,
+    const Yast& replacement
+    ) const
+{
+    PCWSTR const str = subject.str();
+    PCWSTR const rep = replacement.str();
+    const size_t len = subject.length();
+    cvector<WCHAR> out;
+    out.reserve(len);
+    matcher::state ms;
+    range match;
+    size_t pos = 0;
+    while (search(ms, match, str, len, pos))
+    {
+        out.insert(out.end(), str + pos, str + match.begin);
+        out.insert(out.end(), rep, rep + replacement.length());
+        pos = match.end;
+    }
+    out.insert(out.end(), str + pos, str + len);
+    return (
+        out.size() ?
+        Yast(&out[0], static_cast<UINT>(out.size())) :
+        Yast()
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+rrx::matcher::matcher() : m_state(new state())
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+rrx::matcher::matcher(matcher&& other) : m_state(other.m_state)
+{
+    other.m_state = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+rrx::matcher::~matcher()
+{
+    delete m_state;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::matcher::bad_utf() const
+{
+    return m_state->m_bad_utf;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void rrx::matcher::reset()
+{
+    m_state->m_checked = nullptr;
+    m_state->m_checked_len = 0;
+    m_state->m_checked8 = nullptr;
+    m_state->m_checked8_len = 0;
+    m_state->m_bad_utf = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 rrx::rrx() : m_pimpl(new pimpl())
 {
 }
@@ -205,16 +1320,139 @@ rrx::ptr rrx::compile(const Yast& regex, UINT flags)
     if (!self->m_pimpl->compile(regex, flags))
     {
         delete self;
-        self = nullptr;
+        return ptr();
+    }
+    // NO_JIT does not change what is found.
+    const UINT match_flags = flags & ~NO_JIT;
+    ULONGLONG hash = fnv1a(&match_flags, sizeof(match_flags));
+    hash = fnv1a(regex.str(), regex.length() * sizeof(WCHAR), hash);
+    self->m_pimpl->m_hash = hash;
+    return ptr(self);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+rrx::ptr rrx::compile_list(const YastVector& literals, UINT flags)
+{
+    rrx *self = new rrx();
+    if (!self->m_pimpl->compile_list(literals, flags))
+    {
+        delete self;
+        return ptr();
     }
+
+    // The length of every literal is hashed too, so that a list cannot
+    // collide with a single regex made of the same characters.
+    ULONGLONG hash = fnv1a(&flags, sizeof(flags));
+    for (const Yast& lit : literals)
+    {
+        const UINT len = lit.length();
+        hash = fnv1a(&len, sizeof(len), hash);
+        hash = fnv1a(lit.str(), len * sizeof(WCHAR), hash);
+    }
+    self->m_pimpl->m_hash = hash;
     return ptr(self);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool rrx::search(range& found, const Yast& subject, size_t offset) const
+bool rrx::search(
+    matcher& m,
+    range& found,
+    const Yast& subject,
+    size_t offset
+    ) const
+{
+    return m_pimpl->search(
+        *m.m_state,
+        found,
+        subject.str(),
+        subject.length(),
+        offset
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::search(
+    matcher& m,
+    range& found,
+    PCWSTR subject,
+    size_t len,
+    size_t offset
+    ) const
+{
+    return m_pimpl->search(*m.m_state, found, subject, len, offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::searches_bytes(bool utf8) const
+{
+    if (m_pimpl->m_list16.is_valid())
+    {
+        return m_pimpl->m_list8.is_valid() && (utf8 || m_pimpl->m_list_ansi);
+    }
+    return (utf8 ? m_pimpl->m_code_utf8 : m_pimpl->m_code_ansi) != nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::search(
+    matcher& m,
+    range& found,
+    const bytes& subject,
+    size_t offset
+    ) const
+{
+    return m_pimpl->search(*m.m_state, found, subject, offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const Yast& rrx::required_text(bool& ignore_case) const
 {
-    return m_pimpl->search(found, subject, offset);
+    ignore_case = m_pimpl->m_ignore_case;
+    return m_pimpl->m_required_text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::uses_jit() const
+{
+    return m_pimpl->m_jit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ULONGLONG rrx::hash() const
+{
+    return m_pimpl->m_hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::searches_binary() const
+{
+    return m_pimpl->m_binary.is_valid();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool rrx::search_binary(
+    range& found,
+    PCSTR subject,
+    size_t len,
+    size_t offset
+    ) const
+{
+    found.pattern = 0;
+    return m_pimpl->m_binary.find(
+        p2p<const BYTE*>(subject),
+        len,
+        offset,
+        found
+        );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
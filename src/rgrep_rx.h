@@ -53,28 +53,164 @@ public:
     // subject (not just at subject beginning and end).
     static const UINT MULTI_LINE    = 1 << 4;
 
+    // Match with the interpreter, even if the JIT is available. This is
+    // only meant for comparing the two.
+    static const UINT NO_JIT        = 1 << 5;
+
     using ptr = std::shared_ptr<rrx>;
 
+    //
+    // A compiled rrx is never modified after compilation, so it can be
+    // shared by any number of threads. The state of a running match is
+    // kept in a matcher instead. A matcher can be used with any rrx, but
+    // only by one thread at a time. So every thread needs its own one.
+    //
+    class matcher
+    {
+    public:
+        matcher();
+        matcher(matcher&& other);
+        ~matcher();
+
+        // Whether the last search that had to check its 8 bit subject
+        // failed, because the subject is no valid UTF-8.
+        bool bad_utf() const;
+
+        // Forgets which subject has already been checked for valid UTF.
+        // This has to be called before searching a new 8 bit subject,
+        // if the first search does not start at offset 0.
+        void reset();
+
+    private:
+        matcher(const matcher&) = delete;
+        matcher& operator=(const matcher&) = delete;
+
+        friend class rrx;
+        class state;
+        state *m_state;
+    };
+
+    //
+    // An 8 bit subject, that is either encoded in UTF-8 or in the ANSI
+    // code page.
+    //
+    struct bytes
+    {
+        PCSTR str;
+        size_t length;
+        bool utf8;
+        bool checked;   // known to be valid UTF-8, so PCRE skips its check
+    };
+
     //
     // Constructs a new rrx by compiling the given regular expression.
     // If the compilation fails, nullptr is returned.
     //
     static ptr compile(const Yast& regex, UINT flags = 0);
 
+    //
+    // Constructs a new rrx, that searches for any of the given literals
+    // at once. Only IGNORE_CASE and WHOLE_WORDS are taken into account.
+    // Of the literals that match at the same position, the longest one is
+    // found and range::pattern tells its index. When replacing, the
+    // replacement is inserted as it is. Lists that are too large for the
+    // automaton are searched with PCRE instead. If the list is empty or
+    // contains an empty literal, nullptr is returned.
+    //
+    static ptr compile_list(const YastVector& literals, UINT flags = 0);
+
     //
     // Returns the first position at or behind offset, where this
-    // pattern matches in a given string.
+    // pattern matches in a given string. The subject is only checked for
+    // valid UTF-16 when starting at offset 0. Searching on in the same
+    // subject with the same matcher relies on that earlier check.
+    //
+    bool search(
+        matcher& m,
+        range& found,
+        const Yast& subject,
+        size_t offset = 0
+        ) const;
+
+    //
+    // Same as above for len code units at subject, that need not be
+    // terminated by 0. Names of directory entries are searched like this
+    // without copying them.
+    //
+    bool search(
+        matcher& m,
+        range& found,
+        PCWSTR subject,
+        size_t len,
+        size_t offset = 0
+        ) const;
+
+    //
+    // Whether 8 bit subjects in UTF-8 (utf8 == true) or in the ANSI code
+    // page can be searched directly. If not, they have to be converted to
+    // UTF-16 first.
+    //
+    bool searches_bytes(bool utf8) const;
+
+    //
+    // Same as above for an 8 bit subject. The positions are byte offsets.
+    // If the subject is no valid UTF-8, nothing is found and the matcher
+    // reports bad_utf(). A subject marked as checked must be valid.
+    //
+    bool search(
+        matcher& m,
+        range& found,
+        const bytes& subject,
+        size_t offset = 0
+        ) const;
+
+    //
+    // Whether binary subjects can be searched directly. This is only
+    // possible for a LITERAL, that is looked for in two forms at once: with
+    // every character as a single byte (if they are all below 256) and in
+    // UTF-16LE. Otherwise binary subjects have to be converted to UTF-16
+    // by storing every byte as a character.
+    //
+    bool searches_binary() const;
+
+    //
+    // Same as above for a binary subject. The positions are byte offsets.
+    //
+    bool search_binary(
+        range& found,
+        PCSTR subject,
+        size_t len,
+        size_t offset = 0
+        ) const;
+
+    //
+    // A literal that is part of every match, or an empty string if there
+    // is none (like for a list of literals). ignore_case tells, whether it
+    // may occur in any case. Files without it need not be searched at all.
+    //
+    const Yast& required_text(bool& ignore_case) const;
+
+    //
+    // Whether UTF-16 subjects are matched by JIT code. That depends on
+    // the build (SUPPORT_JIT), NO_JIT and whether the JIT could compile
+    // the pattern.
+    //
+    bool uses_jit() const;
+
+    //
+    // A hash of the pattern and the flags it has been compiled with. Equal
+    // hashes stand for the same matches (see ResultCache).
     //
-    bool search(range& found, const Yast& subject, size_t offset = 0) const;
+    ULONGLONG hash() const;
 
     //
     // Returns all the positions where this pattern matches in a given string.
     //
-    ranges findall(const Yast& subject) const
+    ranges findall(matcher& m, const Yast& subject) const
     {
         ranges result;
         range match;
-        for (size_t pos = 0; search(match, subject, pos); pos = match.end)
+        for (size_t pos = 0; search(m, match, subject, pos); pos = match.end)
         {
             result.push_back(match);
         }
@@ -27,36 +27,81 @@
 
 #include "pch.h"
 #include "rgrep_util.h"
+#include "platform.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RU_USE_SSE2 1
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 
-static TextEncoding check_zeros(const BYTE* data, size_t size)
-{
-    const uint16_t* p16 = reinterpret_cast<const uint16_t*>(data);
-    const uint16_t* const end = p16 + (size / sizeof(uint16_t));
+// Binary files are recognized by their zeros, which usually show up right
+// at the beginning. So only a bounded head and the tail of a file are
+// sampled, instead of reading all of it.
+static const size_t ZERO_SAMPLE_HEAD = 64 * 1024;
+static const size_t ZERO_SAMPLE_TAIL = 4 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
 
-    // scan buffer for zeros
-    int z8 = 0;
-    int z16 = 0;
-    while (p16 < end)
+// Counts zero bytes (z8) and zero 16 bit words (z16). size is rounded down
+// to whole words.
+static void count_zeros(const BYTE* data, size_t size, UINT& z8, UINT& z16)
+{
+    size_t pos = 0;
+#ifdef RU_USE_SSE2
+    // A comparison yields -1 for every zero, that is subtracted from 8 bit
+    // counters. Those are summed up before they could overflow. A zero
+    // word is counted in both of its bytes.
+    const __m128i zero = _mm_setzero_si128();
+    while (pos + sizeof(__m128i) <= size)
     {
-        uint16_t test = *p16++;
-        if (test == 0)
+        const size_t left = (size - pos) / sizeof(__m128i);
+        const size_t blocks = (left < 255) ? left : 255;
+        __m128i acc8 = zero;
+        __m128i acc16 = zero;
+        for (size_t b = 0; b < blocks; ++b, pos += sizeof(__m128i))
         {
-            ++z16;
-            if (z16 > 2)   // arbitrary value
-            {
-                return TE_BINARY;
-            }
-        }
-        if ((test & 0xff) == 0)
-        {
-            ++z8;
-        }
-        if ((test >> 8) == 0)
-        {
-            ++z8;
+            const __m128i v = _mm_loadu_si128(p2p<const __m128i*>(data + pos));
+            acc8 = _mm_sub_epi8(acc8, _mm_cmpeq_epi8(v, zero));
+            acc16 = _mm_sub_epi8(acc16, _mm_cmpeq_epi16(v, zero));
         }
+        const __m128i sum8 = _mm_sad_epu8(acc8, zero);
+        const __m128i sum16 = _mm_sad_epu8(acc16, zero);
+        z8 += _mm_cvtsi128_si32(sum8) + _mm_cvtsi128_si32(
+            _mm_srli_si128(sum8, 8)
+            );
+        z16 += (_mm_cvtsi128_si32(sum16) + _mm_cvtsi128_si32(
+            _mm_srli_si128(sum16, 8)
+            )) / 2;
+    }
+#endif
+    for (; pos + 1 < size; pos += 2)
+    {
+        z8 += (data[pos] == 0) + (data[pos + 1] == 0);
+        z16 += (data[pos] == 0 && data[pos + 1] == 0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static TextEncoding check_zeros(const BYTE* data, size_t size)
+{
+    UINT z8 = 0;
+    UINT z16 = 0;
+    if (size <= ZERO_SAMPLE_HEAD + ZERO_SAMPLE_TAIL)
+    {
+        count_zeros(data, size, z8, z16);
+    }
+    else
+    {
+        // The tail has to start at an even offset to see the same words.
+        const size_t tail = (size - ZERO_SAMPLE_TAIL) & ~size_t(1);
+        count_zeros(data, ZERO_SAMPLE_HEAD, z8, z16);
+        count_zeros(data + tail, size - tail, z8, z16);
+    }
+    if (z16 > 2)    // arbitrary value
+    {
+        return TE_BINARY;
     }
     if (data[0] == 0xff && data[1] == 0xfe)
     {
@@ -90,7 +135,12 @@ static TextEncoding check_bom(const BYTE* data, size_t size)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-TextEncoding guess_encoding(const BYTE* data, size_t size, bool prefer_utf8)
+TextEncoding guess_encoding(
+    const BYTE* data,
+    size_t size,
+    bool prefer_utf8,
+    bool check_utf8
+    )
 {
     if (size < 2)
     {
@@ -110,25 +160,90 @@ TextEncoding guess_encoding(const BYTE* data, size_t size, bool prefer_utf8)
     {
         return TE_ANSI;
     }
-    const int res = MultiByteToWideChar(
-        CP_UTF8,
-        MB_ERR_INVALID_CHARS,
-        p2p<PCSTR>(data),
-        static_cast<int>(size),
-        nullptr,
-        0
-        );
-    return (res == 0) ? TE_ANSI : TE_UTF8;
+    return (!check_utf8 || is_utf8(data, size)) ? TE_UTF8 : TE_ANSI;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool is_utf8(const BYTE* data, size_t size)
+{
+    size_t pos = 0;
+    while (pos < size)
+    {
+#ifdef RU_USE_SSE2
+        // Skip ASCII a block at a time. Most text consists of runs of it.
+        while (
+            pos + sizeof(__m128i) <= size &&
+            _mm_movemask_epi8(
+                _mm_loadu_si128(p2p<const __m128i*>(data + pos))
+                ) == 0
+            )
+        {
+            pos += sizeof(__m128i);
+        }
+        if (pos == size)
+        {
+            break;
+        }
+#endif
+        const BYTE lead = data[pos];
+        if (lead < 0x80)
+        {
+            ++pos;
+            continue;
+        }
+
+        // Overlong forms, surrogates and code points beyond U+10FFFF are
+        // rejected by restricting the range of the second byte (like
+        // MultiByteToWideChar with MB_ERR_INVALID_CHARS).
+        size_t trail;
+        BYTE lo = 0x80;
+        BYTE hi = 0xbf;
+        if (lead >= 0xc2 && lead <= 0xdf)
+        {
+            trail = 1;
+        }
+        else if (lead >= 0xe0 && lead <= 0xef)
+        {
+            trail = 2;
+            lo = (lead == 0xe0) ? 0xa0 : lo;
+            hi = (lead == 0xed) ? 0x9f : hi;
+        }
+        else if (lead >= 0xf0 && lead <= 0xf4)
+        {
+            trail = 3;
+            lo = (lead == 0xf0) ? 0x90 : lo;
+            hi = (lead == 0xf4) ? 0x8f : hi;
+        }
+        else
+        {
+            return false;
+        }
+        if (size - pos <= trail || data[pos + 1] < lo || data[pos + 1] > hi)
+        {
+            return false;
+        }
+        for (size_t i = 2; i <= trail; ++i)
+        {
+            if ((data[pos + i] & 0xc0) != 0x80)
+            {
+                return false;
+            }
+        }
+        pos += trail + 1;
+    }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 bool wild_match(PCWSTR tame, PCWSTR wild)
 {
+    // Where to go on after the last '*', if the rest does not match.
     PCWSTR wm_tame = nullptr;
     PCWSTR wm_wild = nullptr;
 
-    for (;;)
+    while (*tame)
     {
         if (*wild == '*')
         {
@@ -137,55 +252,128 @@ bool wild_match(PCWSTR tame, PCWSTR wild)
             {
                 return true;
             }
-            if (*wild != '?')
-            {
-                while (*tame != *wild)
-                {
-                    if (!(*(++tame)))
-                    {
-                        return false;
-                    }
-                }
-            }
             wm_wild = wild;
             wm_tame = tame;
         }
-        else if (*tame != *wild && *wild != '?')
+        else if (*wild == *tame || *wild == '?')
+        {
+            tame++;
+            wild++;
+        }
+        else if (wm_wild)
+        {
+            // let the '*' match one more character
+            wild = wm_wild;
+            tame = ++wm_tame;
+        }
+        else
         {
-            if (wm_wild)
-            {
-                if (wild != wm_wild)
-                {
-                    wild = wm_wild;
-                    if (*tame != *wild)
-                    {
-                        tame = ++wm_tame;
-                        continue;
-                    }
-                    else
-                    {
-                        wild++;
-                    }
-                }
-                if (*tame)
-                {
-                    tame++;
-                    continue;
-                }
-            }
             return false;
         }
-
-        tame++;
+    }
+    while (*wild == '*')
+    {
         wild++;
-        if (*tame == 0)
+    }
+    return (*wild == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ULONGLONG fnv1a(const void* data, size_t size, ULONGLONG hash)
+{
+    const BYTE* bytes = p2p<const BYTE*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast app_data_path(PCWSTR name)
+{
+    WCHAR buf[MAX_PATH];
+    const size_t res = os_app_data_dir(buf, ARRAYSIZE(buf));
+    if (res == 0)
+    {
+        return Yast();
+    }
+    Yast path(buf, static_cast<UINT>(res));
+    path += OS_SEP_STR L"rgrep";
+    os_create_dir(path);
+    path += OS_SEP_STR;
+    path += name;
+    return path;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void StringSet::insert(const Yast& str)
+{
+    if (contains(str.str(), str.length()))
+    {
+        return;
+    }
+    // keep the load factor below one half
+    if ((m_strings.size() + 1) * 2 > m_slots.size())
+    {
+        rehash(m_slots.size() ? m_slots.size() * 2 : 64);
+    }
+    m_strings.push_back(str);
+    const size_t mask = m_slots.size() - 1;
+    size_t slot = fnv1a(str.str(), str.length() * sizeof(WCHAR)) & mask;
+    while (m_slots[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+    m_slots[slot] = static_cast<UINT>(m_strings.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool StringSet::contains(PCWSTR str, UINT len) const
+{
+    if (m_slots.size() == 0)
+    {
+        return false;
+    }
+    const size_t mask = m_slots.size() - 1;
+    size_t slot = fnv1a(str, len * sizeof(WCHAR)) & mask;
+    while (m_slots[slot])
+    {
+        const Yast& candidate = m_strings[m_slots[slot] - 1];
+        if (
+            candidate.length() == len &&
+            memcmp(candidate.str(), str, len * sizeof(WCHAR)) == 0
+            )
         {
-            while (*wild == '*')
-            {
-                wild++;
-            }
-            return (*wild == 0);
+            return true;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void StringSet::rehash(size_t num_slots)
+{
+    m_slots.clear();
+    m_slots.resize(num_slots);
+    const size_t mask = num_slots - 1;
+    for (size_t i = 0; i < m_strings.size(); i++)
+    {
+        const Yast& str = m_strings[i];
+        size_t slot = fnv1a(str.str(), str.length() * sizeof(WCHAR)) & mask;
+        while (m_slots[slot])
+        {
+            slot = (slot + 1) & mask;
         }
+        m_slots[slot] = static_cast<UINT>(i + 1);
     }
 }
 
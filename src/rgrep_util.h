@@ -34,15 +34,28 @@ struct range
 {
     size_t begin;
     size_t end;
+    UINT pattern;   // index of the matching literal (see rrx::compile_list)
 };
 #include "container.h"
 using ranges = cvector<range>;
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// description of lines of a text file
-struct LineInfo { UINT number; Yast text; };
+// description of lines of a text file (number is 64 bits wide, since
+// files that are searched in windows may have more than 4G lines, pattern
+// is taken from the first range that starts in the line). The text of the
+// line is not held by the info itself, it consists of text_len characters
+// at text_pos in a buffer that is shared by many lines (a LineText or the
+// TextArena of a ResultStore).
+struct LineInfo
+{
+    ULONGLONG number;
+    size_t text_pos;
+    UINT text_len;
+    UINT pattern;
+};
 using LineInfos = cvector<LineInfo>;
+using LineText = cvector<WCHAR>;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -57,7 +70,19 @@ enum TextEncoding
     TE_UTF16_LE,
     TE_UTF16_LE_BOM
 };
-TextEncoding guess_encoding(const BYTE* data, size_t size, bool prefer_utf8);
+
+// Zeros are only counted in samples of data (its head and tail). If
+// check_utf8 is false, data without any hint for another encoding is taken
+// for UTF-8 (if prefer_utf8 is true) and has to be checked by the caller.
+TextEncoding guess_encoding(
+    const BYTE* data,
+    size_t size,
+    bool prefer_utf8,
+    bool check_utf8 = true
+    );
+
+// Whether data is valid UTF-8.
+bool is_utf8(const BYTE* data, size_t size);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -65,3 +90,42 @@ TextEncoding guess_encoding(const BYTE* data, size_t size, bool prefer_utf8);
 bool wild_match(PCWSTR tame, PCWSTR wild);
 
 ////////////////////////////////////////////////////////////////////////////////
+
+// FNV-1a. A hash is continued by passing the result of the previous call.
+static const ULONGLONG FNV_BASIS = 14695981039346656037ull;
+ULONGLONG fnv1a(const void* data, size_t size, ULONGLONG hash = FNV_BASIS);
+
+// Returns "%LOCALAPPDATA%\rgrep\<name>" and creates the directory if
+// necessary. Returns an empty string, if LOCALAPPDATA is not set.
+Yast app_data_path(PCWSTR name);
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A set of strings, that can be looked up by a pointer and a length, so
+// that the caller needs no Yast for a lookup. Hashed with fnv1a.
+class StringSet
+{
+public:
+    StringSet()
+    {
+    }
+
+    void insert(const Yast& str);
+    bool contains(PCWSTR str, UINT len) const;
+
+    bool is_empty() const
+    {
+        return m_strings.size() == 0;
+    }
+
+private:
+    StringSet(const StringSet&) = delete;
+    StringSet& operator=(const StringSet&) = delete;
+
+    void rehash(size_t num_slots);
+
+    cvector<Yast> m_strings;
+    cvector<UINT> m_slots;      // index into m_strings plus 1, 0 is free
+};
+
+////////////////////////////////////////////////////////////////////////////////
@@ -29,9 +29,103 @@
 #include "search_thread.h"
 #include "dir_iter.h"
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+bool MetaFilter::accepts(const OsDirEntry& info) const
+{
+    if (info.attributes & skip_attributes)
+    {
+        return false;
+    }
+    const FileStamp stamp = FileStamp::from(info);
+    return (
+        stamp.size >= min_size &&
+        (max_size == 0 || stamp.size <= max_size) &&
+        stamp.write_time >= modified_after &&
+        (modified_before == 0 || stamp.write_time < modified_before)
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResultQueue::ResultQueue() : m_head(0), m_tail(0)
+{
+    m_entries.resize(CAPACITY);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ResultQueue::reset()
+{
+    for (Entry& entry : m_entries)
+    {
+        entry.result = SearchResult();
+    }
+    m_head = m_tail = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultQueue::push(SearchResult& result, size_t matches)
+{
+    const long tail = m_tail;
+    if (tail - m_head >= CAPACITY)
+    {
+        return false;
+    }
+    Entry& entry = m_entries[tail & (CAPACITY - 1)];
+    entry.result = std::move(result);
+    entry.matches = matches;
+
+    // The interlocked operation is a full barrier. So the consumer cannot
+    // see the new tail before it can see the entry.
+    os_exchange(&m_tail, tail + 1);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ResultQueue::pop(SearchResult& result, size_t& matches)
+{
+    const long head = m_head;
+    if (head == m_tail)
+    {
+        return false;
+    }
+    // do not read the entry before having read the tail
+    os_barrier();
+    Entry& entry = m_entries[head & (CAPACITY - 1)];
+    result = std::move(entry.result);
+    matches = entry.matches;
+
+    // hand the entry back to the producer
+    os_exchange(&m_head, head + 1);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
 SearchThread::SearchThread() :
+    m_produced(0),
+    m_prefetched(0),
+    m_prefetch_bytes(0),
+    m_taken(0),
+    m_delivered(0),
+    m_query(0),
+    m_walk_next(nullptr),
+    m_ignore_parents(nullptr),
+    m_prefix_len(0),
+    m_producer_done(false),
+    m_delivering(false),
+    m_use_cache(false),
+    m_num_processed(0),
+    m_num_searched(0),
+    m_want_current_file(0),
+    m_notify_pending(0),
     m_running(0),
     m_canceled(0)
 {
@@ -41,6 +135,9 @@ SearchThread::SearchThread() :
 
 SearchThread::~SearchThread()
 {
+    // The thread uses the object until it returns.
+    cancel();
+    wait();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -50,20 +147,16 @@ bool SearchThread::start(SearchParams& params)
     if (!m_running && !m_canceled)
     {
         m_params = params;
+        m_results.reset();
+        m_current_file.clear();
+        m_num_processed = m_num_searched = 0;
+        m_want_current_file = m_notify_pending = 0;
 
-        DWORD tid;
-        HANDLE hThread = CreateThread(
-            nullptr,
-            0,
-            thread_proc,
-            this,
-            0,
-            &tid
-            );
-        if (hThread)
+        // The thread of the previous search may still be returning.
+        wait();
+        if (m_thread.start(thread_proc, this))
         {
-            InterlockedExchange(&m_running, true);
-            CloseHandle(hThread);
+            os_exchange(&m_running, true);
             return true;
         }
     }
@@ -74,7 +167,15 @@ bool SearchThread::start(SearchParams& params)
 
 void SearchThread::cancel()
 {
-    InterlockedExchange(&m_canceled, true);
+    os_exchange(&m_canceled, true);
+
+    // Taking the lock makes sure that nobody is between checking
+    // m_canceled and going to sleep, when we wake everybody up.
+    m_lock.lock();
+    m_lock.unlock();
+    m_cv_space.wake_all();
+    m_cv_work.wake_all();
+    m_cv_prefetch.wake_all();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -86,108 +187,930 @@ bool SearchThread::is_running()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-DWORD SearchThread::thread_proc(void* pctxt)
+void SearchThread::wait()
+{
+    if (m_thread.is_started())
+    {
+        m_thread.join();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::fetch_result(SearchResult& result, size_t& matches)
+{
+    // Clear the flag first: Results that are pushed while we are draining
+    // the queue have to lead to a new notification.
+    os_exchange(&m_notify_pending, 0);
+    return m_results.pop(result, matches);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::get_progress(
+    UINT& processed,
+    UINT& searched,
+    Yast& current_file
+    )
+{
+    processed = static_cast<UINT>(m_num_processed);
+    searched = static_cast<UINT>(m_num_searched);
+    m_file_lock.lock_shared();
+    current_file = m_current_file;
+    m_file_lock.unlock_shared();
+
+    // Only copy the name of the current file when somebody asks for it.
+    os_exchange(&m_want_current_file, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::thread_proc(void* pctxt)
 {
     SearchThread* self = p2p<SearchThread*>(pctxt);
     const SearchParams& params = self->m_params;
 
-    YastSet backup_files;
+    self->m_filters.clear();
+    self->m_filters.push_back(FilterContext());
+
+    // With an index of the search path, files that cannot contain the
+    // literal required by the pattern are not even opened.
+    if (params.use_index)
+    {
+        bool ignore_case;
+        const Yast& literal = params.rx_search->required_text(ignore_case);
+        self->m_index.open(params.search_path, literal, ignore_case);
+    }
+
+    // The ignore files are read while the tree is walked. Those of the
+    // directories above the search path, up to the top of its repository,
+    // apply as well.
+    self->m_ignore.clear();
+    self->m_ignore_parents = (
+        params.use_ignore_files ?
+        self->m_ignore.enter_parents(params.search_path) :
+        nullptr
+        );
+
+    // Files that have not changed since they were searched with the same
+    // query are not read again. Replacing modifies the files, so it does
+    // not use the cache.
+    self->m_use_cache = params.cache_size != 0 && !params.do_replace;
+    if (self->m_use_cache)
+    {
+        self->m_cache.set_capacity(params.cache_size);
+        if (params.cache_file != self->m_cache_file)
+        {
+            self->m_cache.clear();
+            self->m_cache.load(params.cache_file);
+            self->m_cache_file = params.cache_file;
+        }
+        self->m_query = self->query_hash();
+    }
+
+    // Replacing modifies the files while they are being enumerated and
+    // creates backup files next to them. That has to stay strictly
+    // sequential, so it is done by walk_sequential without any workers.
+    const bool parallel = (
+        !params.do_replace &&
+        self->start_workers(self->num_workers())
+        );
+    if (parallel && params.search_subdirs && params.num_walkers)
+    {
+        self->walk_parallel(params.num_walkers);
+    }
+    else
+    {
+        self->walk_sequential(parallel);
+    }
+    if (parallel)
+    {
+        self->stop_workers();
+    }
+
+    self->m_index.close();
+    self->m_ignore.clear();
+    if (
+        self->m_use_cache &&
+        !params.cache_file.is_empty() &&
+        self->m_cache.is_modified()
+        )
+    {
+        self->m_cache.store(params.cache_file);
+    }
+
+    params.end_search_cb(params.p_ctxt);
+    os_exchange(&self->m_canceled, false);
+    os_exchange(&self->m_running, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::walk_sequential(bool parallel)
+{
+    const SearchParams& params = m_params;
+    FilterContext& filters = m_filters[0];
+
+    StringSet backup_files;
     DirectoryIterator diter(params.search_path);
-    const UINT prefix_len = diter.prefix_len();
+    m_prefix_len = diter.prefix_len();
+
+    SearchContext serial;
+
+    // The ignore rules for the entries of every depth of the iterator.
+    cvector<const IgnoreRules*> scopes;
+    const bool use_ignore = params.use_ignore_files && m_prefix_len != 0;
+    if (use_ignore)
+    {
+        scopes.push_back(
+            m_ignore.enter(m_ignore_parents, diter.path_str(), m_prefix_len)
+            );
+    }
+
+    // Only the files that get searched need their path as a Yast. All others
+    // are handled with the buffer of the iterator.
     bool is_dir;
-    Yast full_name;
     bool go_down = params.search_subdirs;
-    while (diter.next(full_name, is_dir, go_down) && !self->m_canceled)
+    while (diter.next(is_dir, go_down) && !m_canceled)
     {
-        if (backup_files.find(full_name) != backup_files.end())
+        PCWSTR const full_name = diter.path_str();
+        if (
+            !backup_files.is_empty() &&
+            backup_files.contains(full_name, diter.path_len())
+            )
         {
             // do NOT search or count backup files!
             continue;
         }
-        Yast name_only(diter.get_info()->cFileName);
+        PCWSTR const name_only = diter.get_info()->name;
+        const IgnoreRules* scope = nullptr;
+        if (use_ignore)
+        {
+            scope = scopes[diter.depth() - 1];
+            if (IgnoreRules::is_ignored(scope, full_name, name_only, is_dir))
+            {
+                go_down = false;
+                continue;
+            }
+        }
         if (is_dir)
         {
-            go_down = params.search_subdirs && !self->excl_dir(name_only);
+            go_down = (
+                params.search_subdirs &&
+                !excl_dir(filters, name_only)
+                );
+            if (go_down && use_ignore)
+            {
+                const UINT depth = diter.depth();
+                if (scopes.size() <= depth)
+                {
+                    scopes.resize(depth + 1);
+                }
+                scopes[depth] = m_ignore.enter(
+                    scope,
+                    full_name,
+                    diter.path_len()
+                    );
+            }
         }
         else
         {
-            const bool include = self->incl_file(name_only);
-            PCWSTR name = include ? full_name : nullptr;
-            params.next_cb(params.p_ctxt, include, name);
+            const bool include = (
+                incl_file(filters, *diter.get_info()) &&
+                m_index.may_match(full_name + m_prefix_len, *diter.get_info())
+                );
+            count_file(full_name, include);
             if (include)
             {
-                self->search_file(full_name, prefix_len, backup_files);
+                const Yast path(full_name, diter.path_len());
+                const FileStamp stamp = FileStamp::from(*diter.get_info());
+                if (parallel)
+                {
+                    enqueue(path, stamp);
+                    continue;
+                }
+                const size_t matches = search_cached(
+                    serial,
+                    path,
+                    stamp,
+                    backup_files
+                    );
+                if (matches)
+                {
+                    report(serial.result, matches);
+                }
             }
         }
     }
+}
 
-    params.end_search_cb(params.p_ctxt);
-    InterlockedExchange(&self->m_canceled, false);
-    InterlockedExchange(&self->m_running, false);
-    return 0;
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::worker_proc(void* pctxt)
+{
+    SearchContext& ctxt = *p2p<SearchContext*>(pctxt);
+    SearchThread* self = ctxt.owner;
+    const size_t window_size = self->m_window.size();
+
+    // Workers never replace, so they will never create backup files.
+    StringSet no_backups;
+
+    self->m_lock.lock();
+    for (;;)
+    {
+        while (self->m_taken == self->m_produced && !self->m_producer_done)
+        {
+            self->m_cv_work.wait(self->m_lock);
+        }
+        if (self->m_taken == self->m_produced)
+        {
+            break;
+        }
+        Slot& slot = self->m_window[self->m_taken++ % window_size];
+        Yast path(std::move(slot.path));
+        const FileStamp stamp = slot.stamp;
+        const void* const prefetch = slot.prefetch;
+        const size_t prefetch_size = slot.prefetch_size;
+        slot.prefetch = nullptr;
+        slot.prefetch_size = 0;
+        self->m_lock.unlock();
+        // taking a file makes room for reading another one ahead
+        self->m_cv_prefetch.wake_one();
+
+        const size_t matches = (
+            self->m_canceled ?
+            0 :
+            self->search_cached(ctxt, path, stamp, no_backups)
+            );
+        TextFile::end_prefetch(prefetch, prefetch_size);
+
+        self->m_lock.lock();
+        self->m_prefetch_bytes -= prefetch_size;
+        if (matches)
+        {
+            slot.result = std::move(ctxt.result);
+        }
+        slot.matches = matches;
+        slot.done = true;
+        self->deliver_ready();
+    }
+    self->m_lock.unlock();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool SearchThread::excl_dir(const Yast& name)
+//
+// Reads the files ahead, that have been queued but not yet taken by a
+// worker, so that the disk is busy while the workers are matching. At most
+// prefetch_depth files and prefetch_budget bytes are being read ahead at
+// any time. The views are handed to the workers with the slots and released
+// by them after searching.
+//
+void SearchThread::prefetch_proc(void* pctxt)
 {
-    range r;
-    return (
-        m_params.rx_exclude != nullptr &&
-        m_params.rx_exclude->search(r, name)
+    SearchThread* self = p2p<SearchThread*>(pctxt);
+    const SearchParams& params = self->m_params;
+    const size_t window_size = self->m_window.size();
+
+    self->m_lock.lock();
+    while (!self->m_canceled)
+    {
+        // Files that have already been taken are not worth it anymore.
+        if (self->m_prefetched < self->m_taken)
+        {
+            self->m_prefetched = self->m_taken;
+        }
+        if (self->m_prefetched == self->m_produced && self->m_producer_done)
+        {
+            break;
+        }
+        if (
+            self->m_prefetched == self->m_produced ||
+            self->m_prefetched - self->m_taken >= params.prefetch_depth ||
+            self->m_prefetch_bytes >= params.prefetch_budget
+            )
+        {
+            self->m_cv_prefetch.wait(self->m_lock);
+            continue;
+        }
+
+        const size_t seq = self->m_prefetched++;
+        Slot& slot = self->m_window[seq % window_size];
+        const Yast path(slot.path);
+        const FileStamp stamp = slot.stamp;
+        size_t size = params.prefetch_budget - self->m_prefetch_bytes;
+        if (stamp.size < size)
+        {
+            size = static_cast<size_t>(stamp.size);
+        }
+        self->m_prefetch_bytes += size;
+        self->m_lock.unlock();
+
+        // Files whose results are cached are not going to be read at all.
+        const void* view = nullptr;
+        if (
+            !self->m_use_cache ||
+            !self->m_cache.contains(path, stamp, self->m_query)
+            )
+        {
+            view = TextFile::prefetch(path, size);
+        }
+
+        self->m_lock.lock();
+        if (view && seq >= self->m_taken)
+        {
+            slot.prefetch = view;
+            slot.prefetch_size = size;
+        }
+        else
+        {
+            // nothing to hand over or the worker has been faster
+            self->m_prefetch_bytes -= size;
+            if (view)
+            {
+                self->m_lock.unlock();
+                TextFile::end_prefetch(view, size);
+                self->m_lock.lock();
+            }
+        }
+    }
+    self->m_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::walk_parallel(UINT num_walkers)
+{
+    ParallelDirWalker walker(
+        m_params.search_path,
+        m_params.use_ignore_files ? on_walk_enter : nullptr,
+        on_walk_dir,
+        on_walk_file,
+        on_walk_leave,
+        this,
+        &m_canceled
         );
+    m_prefix_len = walker.prefix_len();
+    if (num_walkers > ParallelDirWalker::MAX_WALKERS)
+    {
+        num_walkers = ParallelDirWalker::MAX_WALKERS;
+    }
+
+    // There is already one set of filters for the sequential case.
+    while (m_filters.size() < num_walkers)
+    {
+        m_filters.push_back(FilterContext());
+    }
+
+    WalkDir* root = new WalkDir;
+    root->parent = nullptr;
+    root->rules = m_ignore_parents;
+    root->next = 0;
+    root->listed = false;
+    m_walk_dirs.push_back(root);
+    m_walk_next = root;
+    walker.run(num_walkers, root);
+
+    for (WalkDir* dir : m_walk_dirs)
+    {
+        delete dir;
+    }
+    m_walk_dirs.clear();
+    m_walk_next = nullptr;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool SearchThread::incl_file(const Yast& name)
+const void* SearchThread::on_walk_enter(
+    void* pctxt,
+    UINT walker,
+    const void* scope,
+    PCWSTR dir,
+    UINT dir_len
+    )
 {
-    if (m_params.rx_include)
+    // Only the walker of the directory uses its rules, so they can be
+    // changed without the lock.
+    SearchThread* self = p2p<SearchThread*>(pctxt);
+    WalkDir* wdir = static_cast<WalkDir*>(const_cast<void*>(scope));
+    wdir->rules = self->m_ignore.enter(wdir->rules, dir, dir_len);
+    return scope;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::on_walk_dir(
+    void* pctxt,
+    UINT walker,
+    const void* scope,
+    PCWSTR path,
+    const OsDirEntry& info,
+    const void*& sub_scope
+    )
+{
+    SearchThread* self = p2p<SearchThread*>(pctxt);
+    WalkDir* wdir = static_cast<WalkDir*>(const_cast<void*>(scope));
+    if (
+        self->m_params.use_ignore_files &&
+        IgnoreRules::is_ignored(wdir->rules, path, info.name, true)
+        )
     {
-        range r;
-        return m_params.rx_include->search(r, name);
+        return false;
+    }
+    if (self->excl_dir(self->m_filters[walker], info.name))
+    {
+        return false;
+    }
+
+    WalkDir* sub = new WalkDir;
+    sub->parent = wdir;
+    sub->rules = wdir->rules;
+    sub->next = 0;
+    sub->listed = false;
+    sub_scope = sub;
+
+    self->m_walk_lock.lock();
+    self->m_walk_dirs.push_back(sub);
+    wdir->items.push_back(WalkItem());
+    wdir->items.back().sub = sub;
+    if (wdir == self->m_walk_next)
+    {
+        self->flush_walk();
+    }
+    self->m_walk_lock.unlock();
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::on_walk_file(
+    void* pctxt,
+    UINT walker,
+    const void* scope,
+    PCWSTR path,
+    const OsDirEntry& info
+    )
+{
+    SearchThread* self = p2p<SearchThread*>(pctxt);
+    WalkDir* wdir = static_cast<WalkDir*>(const_cast<void*>(scope));
+    if (
+        self->m_params.use_ignore_files &&
+        IgnoreRules::is_ignored(wdir->rules, path, info.name, false)
+        )
+    {
+        // like the files of an excluded directory: neither searched nor
+        // counted
+        return;
+    }
+    const bool include = (
+        self->incl_file(self->m_filters[walker], info) &&
+        self->m_index.may_match(path + self->m_prefix_len, info)
+        );
+    self->count_file(path, include);
+    if (!include)
+    {
+        return;
+    }
+
+    self->m_walk_lock.lock();
+    if (wdir == self->m_walk_next && wdir->items.empty())
+    {
+        // Nothing that has been found before is still waiting.
+        self->enqueue(Yast(path), FileStamp::from(info));
+    }
+    else
+    {
+        wdir->items.push_back(WalkItem());
+        WalkItem& item = wdir->items.back();
+        item.path = path;
+        item.stamp = FileStamp::from(info);
+        item.sub = nullptr;
+        if (wdir == self->m_walk_next)
+        {
+            self->flush_walk();
+        }
+    }
+    self->m_walk_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::on_walk_leave(
+    void* pctxt,
+    UINT walker,
+    const void* scope
+    )
+{
+    SearchThread* self = p2p<SearchThread*>(pctxt);
+    WalkDir* wdir = static_cast<WalkDir*>(const_cast<void*>(scope));
+    self->m_walk_lock.lock();
+    wdir->listed = true;
+    if (wdir == self->m_walk_next)
+    {
+        self->flush_walk();
     }
-    else if (m_params.inc_patterns.size())
+    self->m_walk_lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::flush_walk()
+{
+    // Has to be called with m_walk_lock being held, which stays held while
+    // waiting for space in the window. So the walkers cannot run ahead of
+    // the workers by more than what is waiting in directories that have
+    // not been listed completely.
+    WalkDir* dir = m_walk_next;
+    while (dir != nullptr && !m_canceled)
     {
-        // Set 'include' according to the type of the first pattern.
-        bool include = m_params.inc_patterns[0].str()[0] == '-';
-        Yast cmp(name);
-        cmp.to_lower();
-        for (const Yast& pat : m_params.inc_patterns)
+        if (dir->next < dir->items.size())
         {
-            PCWSTR pstr = pat.str();
-            if (pstr[0]  == '-')
+            const WalkItem& item = dir->items[dir->next++];
+            if (item.sub)
             {
-                include = include && !wild_match(cmp, pstr + 1);
+                dir = item.sub;
             }
             else
             {
-                include = include || wild_match(cmp, pstr);
+                enqueue(item.path, item.stamp);
             }
         }
-        return include;
+        else if (dir->listed)
+        {
+            dir->items = cvector<WalkItem>();
+            dir = dir->parent;
+        }
+        else
+        {
+            // The walker of dir is going to add more items.
+            dir->items.clear();
+            dir->next = 0;
+            break;
+        }
     }
-    return true;
+    m_walk_next = dir;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT SearchThread::num_workers()
+{
+    UINT count = m_params.num_workers;
+    if (count == 0)
+    {
+        count = os_num_cpus();
+    }
+    if (count < 1)
+    {
+        count = 1;
+    }
+    return (count < MAX_WORKERS) ? count : MAX_WORKERS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::start_workers(UINT count)
+{
+    m_produced = m_taken = m_delivered = 0;
+    m_prefetched = m_prefetch_bytes = 0;
+    m_producer_done = m_delivering = false;
+    m_window.clear();
+    m_window.resize(count * WINDOW_PER_WORKER);
+    m_contexts.clear();
+    m_contexts.resize(count);
+
+    // Shrinking m_contexts below does not move the contexts that have
+    // already been handed to a thread.
+    UINT started = 0;
+    for (SearchContext& ctxt : m_contexts)
+    {
+        ctxt.owner = this;
+        if (!ctxt.thread.start(worker_proc, &ctxt))
+        {
+            break;
+        }
+        started++;
+    }
+    TRACE("started %u of %u workers\n", started, count);
+    m_contexts.resize(started);
+
+    if (
+        started &&
+        m_params.prefetch_depth &&
+        m_params.prefetch_budget &&
+        TextFile::can_prefetch()
+        )
+    {
+        m_prefetcher.start(prefetch_proc, this);
+    }
+    return started != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::stop_workers()
+{
+    m_lock.lock();
+    m_producer_done = true;
+    m_lock.unlock();
+    m_cv_work.wake_all();
+    m_cv_prefetch.wake_all();
+
+    for (SearchContext& ctxt : m_contexts)
+    {
+        ctxt.thread.join();
+    }
+    if (m_prefetcher.is_started())
+    {
+        m_prefetcher.join();
+    }
+    m_contexts.clear();
+    m_window.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::enqueue(const Yast& path, const FileStamp& stamp)
+{
+    m_lock.lock();
+    const size_t window_size = m_window.size();
+    while (m_produced - m_delivered >= window_size && !m_canceled)
+    {
+        m_cv_space.wait(m_lock);
+    }
+    if (!m_canceled)
+    {
+        Slot& slot = m_window[m_produced++ % window_size];
+        slot.path = path;
+        slot.stamp = stamp;
+        slot.prefetch = nullptr;
+        slot.prefetch_size = 0;
+        slot.matches = 0;
+        slot.done = false;
+    }
+    m_lock.unlock();
+    m_cv_work.wake_one();
+    m_cv_prefetch.wake_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::deliver_ready()
+{
+    // Has to be called with m_lock being held. Only one thread at a time
+    // reports results. If another thread is already doing that, it will
+    // also pick up the slot that has just been completed.
+    if (m_delivering)
+    {
+        return;
+    }
+    m_delivering = true;
+
+    const size_t window_size = m_window.size();
+    while (m_delivered < m_produced)
+    {
+        Slot& slot = m_window[m_delivered % window_size];
+        if (!slot.done)
+        {
+            break;
+        }
+        if (slot.matches && !m_canceled)
+        {
+            // The slot cannot be reused before m_delivered has been
+            // incremented. So it is safe to release the lock while
+            // waiting for space in the result queue.
+            m_lock.unlock();
+            report(slot.result, slot.matches);
+            m_lock.lock();
+        }
+        slot.result = SearchResult();
+        slot.done = false;
+        m_delivered++;
+        m_cv_space.wake_one();
+    }
+    m_delivering = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::report(SearchResult& result, size_t matches)
+{
+    // Only one thread at a time is reporting (either the sequential
+    // producer or the worker that is delivering), so there is only a
+    // single producer for m_results.
+    while (!m_results.push(result, matches))
+    {
+        // The GUI drains the queue at least on every timer tick.
+        if (m_canceled)
+        {
+            return;
+        }
+        os_sleep(1);
+    }
+    if (os_exchange(&m_notify_pending, 1) == 0)
+    {
+        m_params.results_cb(m_params.p_ctxt);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void SearchThread::count_file(PCWSTR path, bool include)
+{
+    os_increment(&m_num_processed);
+    if (include)
+    {
+        os_increment(&m_num_searched);
+        if (m_want_current_file && os_exchange(&m_want_current_file, 0))
+        {
+            m_file_lock.lock();
+            m_current_file = Yast(path);
+            m_file_lock.unlock();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::excl_dir(FilterContext& filters, PCWSTR name)
+{
+    range r;
+    return (
+        m_params.rx_exclude != nullptr &&
+        m_params.rx_exclude->search(
+            filters.matcher,
+            r,
+            name,
+            os_strlen(name)
+            )
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::incl_file(
+    FilterContext& filters,
+    const OsDirEntry& info
+    )
+{
+    // The metadata costs nothing to check, so it goes first.
+    if (!m_params.meta.accepts(info))
+    {
+        return false;
+    }
+    PCWSTR const name = info.name;
+    if (m_params.rx_include)
+    {
+        range r;
+        return m_params.rx_include->search(
+            filters.matcher,
+            r,
+            name,
+            os_strlen(name)
+            );
+    }
+    return m_params.inc_globs.matches(name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ULONGLONG SearchThread::query_hash() const
+{
+    // Everything besides the patterns, that changes what is found.
+    const ULONGLONG hashes[] = {
+        m_params.rx_search->hash(),
+        m_params.rx_search_utf16 ? m_params.rx_search_utf16->hash() : 0,
+        m_params.search_binary,
+        m_params.window_overlap
+        };
+    return fnv1a(hashes, sizeof(hashes));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t SearchThread::search_cached(
+    SearchContext& ctxt,
+    const Yast& path,
+    const FileStamp& stamp,
+    StringSet& backup_files
+    )
+{
+    if (!m_use_cache)
+    {
+        return search_file(ctxt, path, stamp.size, backup_files);
+    }
+    size_t matches = 0;
+    if (m_cache.lookup(path, stamp, m_query, ctxt.result, matches))
+    {
+        ctxt.result.path_prefix_len = m_prefix_len;
+        return matches;
+    }
+    matches = search_file(ctxt, path, stamp.size, backup_files);
+    if (!m_canceled)
+    {
+        m_cache.insert(path, stamp, m_query, ctxt.result, matches);
+    }
+    return matches;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void SearchThread::search_file(
+size_t SearchThread::search_file(
+    SearchContext& ctxt,
     const Yast& path,
-    UINT prefix_len,
-    YastSet& backup_files
+    ULONGLONG size_hint,
+    StringSet& backup_files
     )
 {
     const bool prefer_utf8 = true;
-    TextFile tf;
-    if (tf.load(path, prefer_utf8, m_params.search_binary))
+    TextFile& tf = ctxt.text_file;
+    SearchResult& result = ctxt.result;
+
+    // Plain references to the shared patterns, so that no reference
+    // counting happens while searching.
+    const rrx& rx_search = *m_params.rx_search;
+    const rrx* const rx_search_utf16 = m_params.rx_search_utf16.get();
+
+    // When replacing, the whole content is needed as UTF-16 anyway.
+    // Otherwise UTF-8, ANSI and binary files are searched as they are, if
+    // the pattern allows that.
+    const bool keep_bytes = !m_params.do_replace;
+    if (
+        tf.load(
+            path,
+            prefer_utf8,
+            m_params.search_binary,
+            keep_bytes,
+            size_hint
+            )
+        )
     {
-        const Yast& subject = tf.get_content();
+        if (
+            tf.has_bytes() && (
+                tf.bytes_are_binary() ?
+                !rx_search.searches_binary() :
+                !rx_search.searches_bytes(tf.bytes_are_utf8())
+                )
+            )
+        {
+            tf.widen();
+        }
+
         ranges match_ranges;
         range match;
+        if (tf.has_bytes() && tf.bytes_are_binary())
+        {
+            // This finds the UTF-16 form of the literal as well, so
+            // rx_search_utf16 is not needed.
+            for (
+                size_t pos = 0;
+                !m_canceled && rx_search.search_binary(
+                    match,
+                    tf.get_bytes(),
+                    tf.get_bytes_len(),
+                    pos
+                    );
+                pos = match.end
+                )
+            {
+                match_ranges.push_back(match);
+            }
+        }
+        else if (tf.has_bytes())
+        {
+            const rrx::bytes bytes = {
+                tf.get_bytes(),
+                tf.get_bytes_len(),
+                tf.bytes_are_utf8(),
+                tf.bytes_are_checked()
+                };
+            for (
+                size_t pos = 0;
+                !m_canceled && rx_search.search(
+                    ctxt.matcher,
+                    match,
+                    bytes,
+                    pos
+                    );
+                pos = match.end
+                )
+            {
+                match_ranges.push_back(match);
+            }
+            if (ctxt.matcher.bad_utf())
+            {
+                // The encoding was guessed wrong. Search the content that
+                // Windows is able to convert to UTF-16 (see below).
+                tf.widen();
+            }
+        }
+
+        const Yast& subject = tf.get_content();
         for (
             size_t pos = 0;
-            !m_canceled && m_params.rx_search->search(match, subject, pos);
+            !tf.has_bytes() &&
+            !m_canceled &&
+            rx_search.search(ctxt.matcher, match, subject, pos);
             pos = match.end
             )
         {
@@ -202,12 +1125,15 @@ void SearchThread::search_file(
             match_ranges.size() != 0
             );
 
-        // search for literal utf16 in binary files
-        if (m_params.rx_search_utf16 != nullptr)
+        // Search for literal utf16 in binary files. Files that were kept
+        // as bytes are either text without zeros or binary files, that have
+        // been searched for the UTF-16 form already.
+        if (rx_search_utf16 != nullptr && !tf.has_bytes())
         {
             for (
                 size_t pos = 0;
-                !m_canceled && m_params.rx_search_utf16->search(
+                !m_canceled && rx_search_utf16->search(
+                    ctxt.matcher,
                     match,
                     subject,
                     pos
@@ -222,32 +1148,145 @@ void SearchThread::search_file(
         if (match_ranges.size())
         {
             // have to extract match info *before* replacing
-            m_result.path = path;
-            m_result.path_prefix_len = prefix_len;
-            m_result.encoding = tf.get_encoding();
-            m_result.line_info = tf.lines_from_ranges(match_ranges);
+            result.path = path;
+            result.path_prefix_len = m_prefix_len;
+            result.encoding = tf.get_encoding();
+            result.line_text.clear();
+            result.line_info = tf.lines_from_ranges(
+                match_ranges,
+                result.line_text
+                );
+            tf.unload();
 
             if (!m_canceled && try_to_replace)
             {
                 if (!do_replace(tf, backup_files))
                 {
                     // replacing failed -> do not report match info
-                    return;
+                    return 0;
                 }
             }
+            return match_ranges.size();
+        }
+    }
+    else if (keep_bytes && tf.too_large())
+    {
+        return search_stream(ctxt, path);
+    }
+    // Do not keep the file mapped while waiting for the next one.
+    tf.unload();
+    return 0;
+}
 
-            m_params.match_found_cb(
-                m_params.p_ctxt,
-                match_ranges.size(),
-                m_result
-                );
+////////////////////////////////////////////////////////////////////////////////
+
+size_t SearchThread::search_stream(SearchContext& ctxt, const Yast& path)
+{
+    const bool prefer_utf8 = true;
+    TextFile& tf = ctxt.text_file;
+    SearchResult& result = ctxt.result;
+    const rrx& rx_search = *m_params.rx_search;
+
+    if (
+        !tf.open_stream(path, prefer_utf8, m_params.window_overlap) ||
+        !rx_search.searches_bytes(tf.bytes_are_utf8())
+        )
+    {
+        tf.unload();
+        return 0;
+    }
+
+    size_t num_matches = 0;
+    result.line_info.clear();
+    result.line_text.clear();
+    while (!m_canceled && tf.next_window())
+    {
+        ranges match_ranges;
+        search_window(ctxt, match_ranges);
+        if (ctxt.matcher.bad_utf())
+        {
+            // The encoding was guessed wrong. Search this window and the
+            // rest of the file as ANSI, like search_file does.
+            if (!rx_search.searches_bytes(false))
+            {
+                TRACE("rrx: invalid UTF-8 in '%S'\n", path.str());
+                break;
+            }
+            tf.stream_as_ansi();
+            match_ranges.clear();
+            search_window(ctxt, match_ranges);
+        }
+
+        // A line that has already been reported for the previous window
+        // may contain a match that is found in this one too. The text of
+        // such a line is appended again, but that happens rarely.
+        num_matches += match_ranges.size();
+        const LineInfos infos = tf.lines_from_ranges(
+            match_ranges,
+            result.line_text
+            );
+        for (const LineInfo& li : infos)
+        {
+            if (
+                result.line_info.size() == 0 ||
+                li.number > result.line_info.back().number
+                )
+            {
+                result.line_info.push_back(li);
+            }
         }
     }
+    tf.unload();
+
+    if (num_matches)
+    {
+        result.path = path;
+        result.path_prefix_len = m_prefix_len;
+        result.encoding = tf.get_encoding();
+    }
+    return num_matches;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool SearchThread::do_replace(TextFile& txt_file, YastSet& backup_files)
+void SearchThread::search_window(SearchContext& ctxt, ranges& match_ranges)
+{
+    const TextFile& tf = ctxt.text_file;
+    const rrx& rx_search = *m_params.rx_search;
+
+    // Let the matcher see the end of the previous window, so that
+    // '^', '\b' and the like work at the beginning of this one.
+    const UINT context = tf.window_context();
+    const rrx::bytes bytes = {
+        tf.get_bytes() - context,
+        tf.get_bytes_len() + context,
+        tf.bytes_are_utf8(),
+        tf.bytes_are_checked()
+        };
+    const size_t accept = context + tf.window_accept();
+    range match;
+    ctxt.matcher.reset();
+    for (
+        size_t pos = context;
+        !m_canceled &&
+        rx_search.search(ctxt.matcher, match, bytes, pos) &&
+        match.begin < accept;
+        pos = match.end
+        )
+    {
+        match_ranges.push_back(
+            range {
+                match.begin - context,
+                match.end - context,
+                match.pattern
+                }
+            );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SearchThread::do_replace(TextFile& txt_file, StringSet& backup_files)
 {
     const Yast& subject = txt_file.get_content();
     Yast replaced(
@@ -256,9 +1295,9 @@ bool SearchThread::do_replace(TextFile& txt_file, YastSet& backup_files)
     if (!replaced.binary_same(subject))
     {
         const DWORD ATTR_TO_REMOVE = (
-            FILE_ATTRIBUTE_HIDDEN |
-            FILE_ATTRIBUTE_READONLY |
-            FILE_ATTRIBUTE_SYSTEM
+            OS_ATTR_HIDDEN |
+            OS_ATTR_READONLY |
+            OS_ATTR_SYSTEM
             );
         const Yast& path = txt_file.get_path();
         TRACE("Parts of the content have been replaced for\n%S\n", path.str());
@@ -266,15 +1305,15 @@ bool SearchThread::do_replace(TextFile& txt_file, YastSet& backup_files)
         if (m_params.create_backups)
         {
             Yast backup = path + L".bak";
+            OsDirEntry entry;
             if (
-                !CopyFile(path, backup, false) &&
-                GetLastError() == ERROR_ACCESS_DENIED
+                !os_copy_file(path, backup) &&
+                os_get_entry(backup, entry)
                 )
             {
-                DWORD attr = GetFileAttributes(backup);
-                attr &= ~ATTR_TO_REMOVE;
-                SetFileAttributes(backup, attr);
-                if (!CopyFile(path, backup, false))
+                // an old backup, that may not be overwritten
+                os_set_attributes(backup, entry.attributes & ~ATTR_TO_REMOVE);
+                if (!os_copy_file(path, backup))
                 {
                     TRACE("Failed to create backup: %S\n", backup.str());
                     return false;
@@ -284,11 +1323,15 @@ bool SearchThread::do_replace(TextFile& txt_file, YastSet& backup_files)
         }
         if (!txt_file.store(path))
         {
-            DWORD init_attr = GetFileAttributes(path);
-            DWORD tmp_attr = init_attr & ~ATTR_TO_REMOVE;
-            SetFileAttributes(path, tmp_attr);
-            bool ok = txt_file.store(path);
-            SetFileAttributes(path, init_attr);
+            OsDirEntry entry;
+            bool ok = os_get_entry(path, entry);
+            if (ok)
+            {
+                const DWORD init_attr = entry.attributes;
+                os_set_attributes(path, init_attr & ~ATTR_TO_REMOVE);
+                ok = txt_file.store(path);
+                os_set_attributes(path, init_attr);
+            }
             if (!ok)
             {
                 TRACE("Failed to store: %S\n", path.str());
@@ -29,42 +29,117 @@
 
 #include "rgrep_rx.h"
 #include "text_file.h"
+#include "trigram_index.h"
+#include "result_cache.h"
+#include "glob_set.h"
+#include "ignore_rules.h"
+#include "platform.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// The text of all lines of a file is kept in a single buffer. Results are
+// only moved, never copied.
 struct SearchResult
 {
     Yast            path;
     LineInfos       line_info;
+    LineText        line_text;
     TextEncoding    encoding;
     UINT            path_prefix_len;
 };
 
-using SearchResults =cvector<SearchResult>;
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// A ring buffer that passes results from the search to the GUI without any
+// locking. Only a single thread at a time may push and only a single thread
+// may pop.
+//
+class ResultQueue
+{
+public:
+    ResultQueue();
+    void reset();
+    bool push(SearchResult& result, size_t matches);
+    bool pop(SearchResult& result, size_t& matches);
+
+    UINT size()
+    {
+        return static_cast<UINT>(m_tail - m_head);
+    }
+
+    static const long CAPACITY = 1024;  // has to be a power of two
+
+protected:
+    struct Entry
+    {
+        SearchResult    result;
+        size_t          matches;
+    };
+
+    cvector<Entry>  m_entries;
+    volatile long   m_head;             // only written by the consumer
+    volatile long   m_tail;             // only written by the producer
+};
 
 ////////////////////////////////////////////////////////////////////////////////
 
-using NEXT_FILE_CB = void(*)(void *pCtxt, bool was_searched, PCWSTR name);
+// Both callbacks are called from the search thread. RESULTS_READY_CB is only
+// a hint that results are waiting in the queue and must not block.
 using END_SEARCH_CB = void(*)(void *pCtxt);
-using MATCH_FOUND_CB = void(*)(void *pCtxt, size_t matches, SearchResult& res);
+using RESULTS_READY_CB = void(*)(void *pCtxt);
+
+//
+// Conditions on the metadata of a file. They are checked with the data from
+// the enumeration, so a file that does not meet them is never opened. 0
+// means that there is no limit.
+//
+struct MetaFilter
+{
+    ULONGLONG       min_size;
+    ULONGLONG       max_size;
+    ULONGLONG       modified_after;     // FILETIME (UTC) as in FileStamp
+    ULONGLONG       modified_before;
+    DWORD           skip_attributes;    // FILE_ATTRIBUTE_*, see OsDirEntry
+
+    MetaFilter() :
+        min_size(0),
+        max_size(0),
+        modified_after(0),
+        modified_before(0),
+        skip_attributes(0)
+    {
+    }
+
+    bool accepts(const OsDirEntry& info) const;
+};
 
 struct SearchParams
 {
     Yast            search_path;
     Yast            replace_text;
-    YastVector      inc_patterns;
+    GlobSet         inc_globs;
+    MetaFilter      meta;
     rrx::ptr        rx_search;
     rrx::ptr        rx_search_utf16;
     rrx::ptr        rx_exclude;
     rrx::ptr        rx_include;
     void*           p_ctxt;
-    NEXT_FILE_CB    next_cb;
-    MATCH_FOUND_CB  match_found_cb;
+    RESULTS_READY_CB results_cb;
     END_SEARCH_CB   end_search_cb;
+    UINT            num_workers;        // 0 -> one per logical processor
+    UINT            num_walkers;        // 0 -> walk the tree sequentially
+    UINT            window_overlap;     // lines shared by stream windows
+    UINT            prefetch_depth;     // files read ahead, 0 -> none
+    size_t          prefetch_budget;    // bytes being read ahead at most
     bool            search_subdirs;
     bool            search_binary;
     bool            do_replace;
     bool            create_backups;
+    bool            use_index;          // see TrigramIndex
+    bool            use_ignore_files;   // see IgnoreRules
+    size_t          cache_size;         // bytes, 0 -> no ResultCache
+    Yast            cache_file;         // keeps the cache between runs
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -78,19 +153,161 @@ public:
     void cancel();
     bool is_running();
 
+    // Returns when the thread that has been started last has ended.
+    void wait();
+
+    // The following may be called at any time by the thread that started
+    // the search.
+    bool fetch_result(SearchResult& result, size_t& matches);
+    void get_progress(UINT& processed, UINT& searched, Yast& current_file);
+
 protected:
-    SearchParams        m_params;
-    SearchResult        m_result;
-    volatile LONG       m_running;
-    volatile LONG       m_canceled;
-
-    using YastSet = cset<Yast>;
-
-    static DWORD WINAPI thread_proc(void* pctxt);
-    bool excl_dir(const Yast& name);
-    bool incl_file(const Yast& name);
-    void search_file(const Yast& path, UINT prefix_len, YastSet& backup_files);
-    bool do_replace(TextFile& txt_file, YastSet& backup_files);
+
+    // Everything a single searching thread needs for itself. The compiled
+    // patterns are shared by all workers, but each one has its own matcher.
+    struct SearchContext
+    {
+        SearchThread*   owner;
+        OsThread        thread;
+        TextFile        text_file;
+        SearchResult    result;
+        rrx::matcher    matcher;
+    };
+
+    // Every directory walker needs its own matcher for the exclude and
+    // include patterns.
+    struct FilterContext
+    {
+        rrx::matcher    matcher;
+    };
+
+    // A directory of a parallel walk. Its files that are to be searched and
+    // its sub directories are kept in the order they were found, until they
+    // can be enqueued in the order of a sequential walk (see flush_walk).
+    struct WalkDir;
+    struct WalkItem
+    {
+        Yast            path;
+        FileStamp       stamp;
+        WalkDir*        sub;            // a sub directory instead of a file
+    };
+    struct WalkDir
+    {
+        WalkDir*            parent;
+        const IgnoreRules*  rules;
+        cvector<WalkItem>   items;
+        size_t              next;       // the first item not enqueued yet
+        bool                listed;     // no more items will be added
+    };
+
+    // An entry of the reorder window. Files are searched in any order but
+    // their results are reported in the order the files were found.
+    struct Slot
+    {
+        Yast            path;
+        FileStamp       stamp;
+        const void*     prefetch;       // see TextFile::prefetch
+        size_t          prefetch_size;
+        SearchResult    result;
+        size_t          matches;
+        bool            done;
+    };
+
+    SearchParams            m_params;
+    ResultQueue             m_results;
+    OsRwLock                m_file_lock;
+    Yast                    m_current_file;
+    cvector<SearchContext>  m_contexts;
+    cvector<FilterContext>  m_filters;
+    cvector<Slot>           m_window;
+    cvector<WalkDir*>       m_walk_dirs;
+    WalkDir*                m_walk_next;    // where flush_walk goes on
+    TrigramIndex            m_index;
+    IgnoreTree              m_ignore;
+    const IgnoreRules*      m_ignore_parents;   // above the search path
+    ResultCache             m_cache;
+    Yast                    m_cache_file;   // that has been loaded
+    ULONGLONG               m_query;        // see ResultCache
+    OsMutex                 m_lock;
+    OsMutex                 m_walk_lock;
+    OsCondVar               m_cv_work;
+    OsCondVar               m_cv_space;
+    OsCondVar               m_cv_prefetch;
+    OsThread                m_thread;
+    OsThread                m_prefetcher;
+    size_t                  m_produced;
+    size_t                  m_prefetched;
+    size_t                  m_prefetch_bytes;
+    size_t                  m_taken;
+    size_t                  m_delivered;
+    UINT                    m_prefix_len;
+    bool                    m_producer_done;
+    bool                    m_delivering;
+    bool                    m_use_cache;
+    volatile long           m_num_processed;
+    volatile long           m_num_searched;
+    volatile long           m_want_current_file;
+    volatile long           m_notify_pending;
+    volatile long           m_running;
+    volatile long           m_canceled;
+
+    static const UINT MAX_WORKERS = 64;
+    static const UINT WINDOW_PER_WORKER = 16;
+
+    static void thread_proc(void* pctxt);
+    static void worker_proc(void* pctxt);
+    static void prefetch_proc(void* pctxt);
+    static const void* on_walk_enter(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR dir,
+        UINT dir_len
+        );
+    static bool on_walk_dir(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR path,
+        const OsDirEntry& info,
+        const void*& sub_scope
+        );
+    static void on_walk_file(
+        void* pctxt,
+        UINT walker,
+        const void* scope,
+        PCWSTR path,
+        const OsDirEntry& info
+        );
+    static void on_walk_leave(void* pctxt, UINT walker, const void* scope);
+    void walk_sequential(bool parallel);
+    void walk_parallel(UINT num_walkers);
+    void flush_walk();
+    UINT num_workers();
+    bool start_workers(UINT count);
+    void stop_workers();
+    void enqueue(const Yast& path, const FileStamp& stamp);
+    void deliver_ready();
+    void report(SearchResult& result, size_t matches);
+    void count_file(PCWSTR path, bool include);
+    ULONGLONG query_hash() const;
+    bool excl_dir(FilterContext& filters, PCWSTR name);
+    bool incl_file(FilterContext& filters, const OsDirEntry& info);
+    size_t search_cached(
+        SearchContext& ctxt,
+        const Yast& path,
+        const FileStamp& stamp,
+        StringSet& backup_files
+        );
+    size_t search_file(
+        SearchContext& ctxt,
+        const Yast& path,
+        ULONGLONG size_hint,
+        StringSet& backup_files
+        );
+    size_t search_stream(SearchContext& ctxt, const Yast& path);
+    void search_window(SearchContext& ctxt, ranges& match_ranges);
+    bool do_replace(TextFile& txt_file, StringSet& backup_files);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +38,10 @@ bool SettingsDlg::OnInitDialog()
     Ctrl.SetText(m_view_cmd);
     Ctrl = GetItem(IDC_CSV_SEP);
     Ctrl.SetText(m_csv_sep);
+    Yast workers;
+    workers.format(L"%u", m_num_workers);
+    Ctrl = GetItem(IDC_NUM_WORKERS);
+    Ctrl.SetText(workers);
     return true;
 }
 
@@ -54,6 +58,8 @@ bool SettingsDlg::OnCommand(UINT CmdId, UINT Notification, HWND Ctrl)
         m_edit_cmd = Yast(GetItem(IDC_EDITOR_CMD));
         m_view_cmd = Yast(GetItem(IDC_VIEWER_CMD));
         m_csv_sep = Yast(GetItem(IDC_CSV_SEP));
+        Yast workers(GetItem(IDC_NUM_WORKERS));
+        m_num_workers = static_cast<UINT>(_wtoi(workers.str()));
         EndDialog(m_hWnd, CmdId);
     }
     else if (
@@ -35,11 +35,18 @@
 class SettingsDlg : public DpiScaledDlg
 {
 public:
-    SettingsDlg(BaseWnd* Parent, Yast& edit_cmd, Yast& view_cmd, Yast& csv_sep):
+    SettingsDlg(
+        BaseWnd* Parent,
+        Yast& edit_cmd,
+        Yast& view_cmd,
+        Yast& csv_sep,
+        UINT num_workers
+        ):
         DpiScaledDlg(Parent),
         m_edit_cmd(edit_cmd),
         m_view_cmd(view_cmd),
-        m_csv_sep(csv_sep)
+        m_csv_sep(csv_sep),
+        m_num_workers(num_workers)
     {
     }
 
@@ -63,10 +70,16 @@ public:
         return m_csv_sep;
     }
 
+    UINT get_num_workers()
+    {
+        return m_num_workers;
+    }
+
 protected:
     Yast m_edit_cmd;
     Yast m_view_cmd;
     Yast m_csv_sep;
+    UINT m_num_workers;
     bool OnInitDialog() override;
     bool OnCommand(UINT CmdId, UINT Notification, HWND Ctrl) override;
 };
@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+//
+// Runs searches of -cli on a small tree, with the core built for a system
+// other than Windows (see bld_test.py). Returns 0 if all checks pass.
+//
+
+#include "../pch.h"
+#include "../rgrep_cli.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int num_failed = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+    if (!ok)
+    {
+        printf("line %d: CHECK(%s) failed\n", line, what);
+        ++num_failed;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DIR_NAME L"test_cli.dir"
+#define SEP OS_SEP_STR
+#define OUT_NAME "test_cli.out"
+
+static bool put_file(PCWSTR path, const char* text)
+{
+    OsFile file;
+    return file.create(path) && file.write(text, strlen(text));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs run_cli with args and puts what it writes to the standard output
+// into out.
+static int run(const cvector<PCWSTR>& args, cvector<char>& out)
+{
+    cvector<PWSTR> argv;
+    argv.push_back(const_cast<PWSTR>(L"rgrep"));
+    for (PCWSTR arg : args)
+    {
+        argv.push_back(const_cast<PWSTR>(arg));
+    }
+
+    fflush(stdout);
+    const int saved = dup(1);
+    const int fd = open(OUT_NAME, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    dup2(fd, 1);
+    close(fd);
+    int res;
+    {
+        ShoddyCmdlParser parser(static_cast<int>(argv.size()), &argv[0]);
+        res = run_cli(parser);
+    }
+    dup2(saved, 1);
+    close(saved);
+
+    out.clear();
+    OsFile file;
+    uint64_t size = 0;
+    size_t num_read = 0;
+    if (file.open(L"" OUT_NAME) && file.size(size) && size)
+    {
+        out.resize(static_cast<size_t>(size));
+        file.read(&out[0], out.size(), num_read);
+        out.resize(num_read);
+    }
+    file.close();
+    os_delete_file(L"" OUT_NAME);
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool equal(const cvector<char>& out, const char* expected)
+{
+    return (
+        out.size() == strlen(expected) &&
+        memcmp(out.data(), expected, out.size()) == 0
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_search()
+{
+    os_create_dir(DIR_NAME);
+    os_create_dir(DIR_NAME SEP L"sub");
+    CHECK(put_file(DIR_NAME SEP L"a.txt", "one\ntwo needle\nthree\n"));
+    CHECK(put_file(DIR_NAME SEP L"b.log", "needle\n"));
+    CHECK(
+        put_file(DIR_NAME SEP L"sub" SEP L"c.txt", "x\ny\n\xc3\xa4 needle\n")
+        );
+
+    cvector<char> out;
+    CHECK(
+        run(
+            { L"-cli", L"-path:" DIR_NAME, L"-text", L"needle",
+              L"-include", L"*.txt", L"-subdirs", L"-workers", L"1" },
+            out
+            ) == 0
+        );
+    // The order of the files is not fixed, but the lines of a file are
+    // printed together.
+    const char* const a_line = "test_cli.dir/a.txt:2:two needle\n";
+    const char* const c_line = "test_cli.dir/sub/c.txt:3:\xc3\xa4 needle\n";
+    const size_t a_len = strlen(a_line);
+    CHECK(
+        out.size() == a_len + strlen(c_line) && (
+            (
+                memcmp(out.data(), a_line, a_len) == 0 &&
+                memcmp(out.data() + a_len, c_line, strlen(c_line)) == 0
+                ) || (
+                memcmp(out.data(), c_line, strlen(c_line)) == 0 &&
+                memcmp(out.data() + strlen(c_line), a_line, a_len) == 0
+                )
+            )
+        );
+
+    CHECK(
+        run(
+            { L"-cli", L"-path:" DIR_NAME, L"-regex", L"^need",
+              L"-include", L"*.log" },
+            out
+            ) == 0
+        );
+    CHECK(equal(out, "test_cli.dir/b.log:1:needle\n"));
+
+    CHECK(
+        run(
+            { L"-cli", L"-path:" DIR_NAME, L"-text", L"haystack" },
+            out
+            ) == 1
+        );
+    CHECK(out.empty());
+
+    // no such directory
+    CHECK(
+        run(
+            { L"-cli", L"-path:" DIR_NAME SEP L"none", L"-text", L"x" },
+            out
+            ) == 2
+        );
+
+    os_delete_file(DIR_NAME SEP L"sub" SEP L"c.txt");
+    os_delete_file(DIR_NAME SEP L"b.log");
+    os_delete_file(DIR_NAME SEP L"a.txt");
+    os_delete_dir(DIR_NAME SEP L"sub");
+    os_delete_dir(DIR_NAME);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define TREE_NAME L"test_cli.tree"
+
+// Creates (or removes) a tree below dir with files that all match.
+static void make_tree(const Yast& dir, UINT depth, bool remove)
+{
+    if (!remove)
+    {
+        os_create_dir(dir);
+    }
+    for (UINT i = 0; i < 6; i++)
+    {
+        Yast name;
+        name.format(L"%s" SEP L"f%u.txt", dir.str(), i);
+        if (remove)
+        {
+            os_delete_file(name);
+        }
+        else
+        {
+            CHECK(put_file(name, "needle\n"));
+        }
+        if (depth < 3 && i < 3)
+        {
+            name.format(L"%s" SEP L"d%u", dir.str(), i);
+            make_tree(name, depth + 1, remove);
+        }
+    }
+    if (remove)
+    {
+        os_delete_dir(dir);
+    }
+}
+
+// Searching with walkers has to report the files in the same order as a
+// sequential walk.
+static void test_walker_order()
+{
+    make_tree(TREE_NAME, 0, false);
+    cvector<char> expected;
+    CHECK(
+        run(
+            { L"-cli", L"-path:" TREE_NAME, L"-text", L"needle",
+              L"-subdirs", L"-workers", L"4" },
+            expected
+            ) == 0
+        );
+    CHECK(!expected.empty());
+    for (PCWSTR walkers : { L"1", L"2", L"8" })
+    {
+        cvector<char> out;
+        CHECK(
+            run(
+                { L"-cli", L"-path:" TREE_NAME, L"-text", L"needle",
+                  L"-subdirs", L"-workers", L"4", L"-walkers", walkers },
+                out
+                ) == 0
+            );
+        CHECK(out == expected);
+    }
+    make_tree(TREE_NAME, 0, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_search();
+    test_walker_order();
+    printf("%s\n", num_failed ? "FAILED" : "ok");
+    return num_failed ? 1 : 0;
+}
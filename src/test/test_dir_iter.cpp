@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+//
+// Walks a generated tree with DirectoryIterator and with ParallelDirWalker
+// and checks, that both find the same files. Returns 0 if all checks pass.
+//
+
+#include "../pch.h"
+#include "../dir_iter.h"
+#include <stdio.h>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int num_failed = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+    if (!ok)
+    {
+        printf("line %d: CHECK(%s) failed\n", line, what);
+        ++num_failed;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DIR_NAME L"test_dir_iter.dir"
+
+// directories per directory, down to TREE_DEPTH
+static const UINT TREE_FANOUT = 3;
+static const UINT TREE_DEPTH = 4;
+static const UINT FILES_PER_DIR = 5;
+
+// Creates the tree below dir and returns the number of files in it. The
+// last directory of every level stays empty. If remove is set, the tree
+// is deleted instead.
+static UINT make_tree(const Yast& dir, UINT depth, bool remove)
+{
+    UINT num_files = 0;
+    if (!remove)
+    {
+        os_create_dir(dir);
+    }
+    if (depth < TREE_DEPTH)
+    {
+        for (UINT i = 0; i < TREE_FANOUT; ++i)
+        {
+            Yast sub;
+            sub.format(L"%s" OS_SEP_STR L"d%u", dir.str(), i);
+            if (i + 1 < TREE_FANOUT)
+            {
+                num_files += make_tree(sub, depth + 1, remove);
+            }
+            else if (!remove)
+            {
+                os_create_dir(sub);
+            }
+            else
+            {
+                os_delete_dir(sub);
+            }
+        }
+    }
+    for (UINT i = 0; i < FILES_PER_DIR; ++i)
+    {
+        Yast name;
+        name.format(L"%s" OS_SEP_STR L"f%u.txt", dir.str(), i);
+        if (remove)
+        {
+            os_delete_file(name);
+            continue;
+        }
+        OsFile file;
+        CHECK(file.create(name) && file.write("x", 1));
+        num_files++;
+    }
+    if (remove)
+    {
+        os_delete_dir(dir);
+    }
+    return num_files;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Skips the directories named like this one.
+static const WCHAR SKIPPED[] = L"d1";
+
+struct WalkResult
+{
+    OsMutex lock;
+    YastVector files;
+    bool skip;
+    volatile long num_walked;       // directories that are to be walked
+    volatile long num_left;
+};
+
+static bool on_dir(
+    void* pctxt,
+    UINT walker,
+    const void* scope,
+    PCWSTR path,
+    const OsDirEntry& info,
+    const void*& sub_scope
+    )
+{
+    (void)walker;
+    (void)scope;
+    (void)path;
+    (void)sub_scope;
+    WalkResult* result = static_cast<WalkResult*>(pctxt);
+    if (result->skip && os_strcmpi(info.name, SKIPPED) == 0)
+    {
+        return false;
+    }
+    os_increment(&result->num_walked);
+    return true;
+}
+
+static void on_file(
+    void* pctxt,
+    UINT walker,
+    const void* scope,
+    PCWSTR path,
+    const OsDirEntry& info
+    )
+{
+    (void)walker;
+    (void)scope;
+    (void)info;
+    WalkResult* result = static_cast<WalkResult*>(pctxt);
+    result->lock.lock();
+    result->files.push_back(path);
+    result->lock.unlock();
+}
+
+static void on_leave(void* pctxt, UINT walker, const void* scope)
+{
+    (void)walker;
+    (void)scope;
+    os_increment(&static_cast<WalkResult*>(pctxt)->num_left);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static YastVector walk_sequential(bool skip)
+{
+    YastVector files;
+    DirectoryIterator iter(DIR_NAME);
+    bool is_dir = false;
+    bool go_down = false;
+    while (iter.next(is_dir, go_down))
+    {
+        const OsDirEntry* info = iter.get_info();
+        go_down = is_dir && (!skip || os_strcmpi(info->name, SKIPPED) != 0);
+        if (!is_dir)
+        {
+            files.push_back(Yast(iter.path_str(), iter.path_len()));
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static YastVector walk_parallel(bool skip, UINT num_walkers)
+{
+    const volatile long canceled = 0;
+    WalkResult result;
+    result.skip = skip;
+    result.num_walked = 1;
+    result.num_left = 0;
+    ParallelDirWalker walker(
+        DIR_NAME,
+        nullptr,
+        on_dir,
+        on_file,
+        on_leave,
+        &result,
+        &canceled
+        );
+    walker.run(num_walkers);
+
+    // every directory that is walked is left exactly once
+    CHECK(result.num_left == result.num_walked);
+    std::sort(result.files.begin(), result.files.end());
+    return result.files;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_walkers()
+{
+    const UINT num_files = make_tree(DIR_NAME, 0, false);
+    for (bool skip : { false, true })
+    {
+        const YastVector expected = walk_sequential(skip);
+        CHECK(
+            skip ?
+                expected.size() < num_files :
+                expected.size() == num_files
+            );
+        for (UINT num_walkers : { 1u, 2u, 8u })
+        {
+            CHECK(walk_parallel(skip, num_walkers) == expected);
+        }
+    }
+    make_tree(DIR_NAME, 0, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_walkers();
+    printf("%s\n", num_failed ? "FAILED" : "ok");
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,637 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//
+// Tests the platform layer of the running system. Returns 0 if all checks
+// pass.
+//
+
+#include "../platform.h"
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int num_failed = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+    if (!ok)
+    {
+        printf("line %d: CHECK(%s) failed\n", line, what);
+        ++num_failed;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int NUM_THREADS = 4;
+static const long NUM_ROUNDS = 100000;
+
+static void count_up(void* arg)
+{
+    volatile long* counter = static_cast<volatile long*>(arg);
+    for (long i = 0; i < NUM_ROUNDS; ++i)
+    {
+        os_increment(counter);
+    }
+}
+
+static void test_atomics()
+{
+    volatile long counter = 0;
+    OsThread threads[NUM_THREADS];
+    for (OsThread& thread : threads)
+    {
+        CHECK(thread.start(count_up, const_cast<long*>(&counter)));
+    }
+    for (OsThread& thread : threads)
+    {
+        thread.join();
+        CHECK(!thread.is_started());
+    }
+    CHECK(counter == NUM_THREADS * NUM_ROUNDS);
+    CHECK(os_decrement(&counter) == NUM_THREADS * NUM_ROUNDS - 1);
+    CHECK(os_exchange(&counter, 7) == NUM_THREADS * NUM_ROUNDS - 1);
+    CHECK(counter == 7);
+
+    // A moved thread is joined by its new owner.
+    OsThread first;
+    CHECK(first.start(count_up, const_cast<long*>(&counter)));
+    OsThread second(static_cast<OsThread&&>(first));
+    CHECK(!first.is_started() && second.is_started());
+    second.join();
+    CHECK(counter == 7 + NUM_ROUNDS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// A queue with room for a few items, that a producer fills and consumers
+// drain.
+struct Queue
+{
+    OsMutex lock;
+    OsCondVar cv_items;
+    OsCondVar cv_space;
+    long items[8];
+    unsigned head = 0;
+    unsigned tail = 0;
+    bool done = false;
+    long sum = 0;
+};
+
+static void consume(void* arg)
+{
+    Queue& q = *static_cast<Queue*>(arg);
+    q.lock.lock();
+    for (;;)
+    {
+        while (q.head == q.tail && !q.done)
+        {
+            q.cv_items.wait(q.lock);
+        }
+        if (q.head == q.tail)
+        {
+            break;
+        }
+        q.sum += q.items[q.head++ % 8];
+        q.cv_space.wake_one();
+    }
+    q.lock.unlock();
+}
+
+static void test_condvar()
+{
+    Queue q;
+    OsThread threads[NUM_THREADS];
+    for (OsThread& thread : threads)
+    {
+        CHECK(thread.start(consume, &q));
+    }
+    long expected = 0;
+    for (long i = 1; i <= 20000; ++i)
+    {
+        q.lock.lock();
+        while (q.tail - q.head == 8)
+        {
+            q.cv_space.wait(q.lock);
+        }
+        q.items[q.tail++ % 8] = i;
+        q.lock.unlock();
+        q.cv_items.wake_one();
+        expected += i;
+    }
+    q.lock.lock();
+    q.done = true;
+    q.lock.unlock();
+    q.cv_items.wake_all();
+    for (OsThread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(q.sum == expected);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Writers keep both halves equal, readers must never see them differ.
+struct Shared
+{
+    OsRwLock lock;
+    long a = 0;
+    long b = 0;
+    volatile long torn = 0;
+};
+
+static void read_write(void* arg)
+{
+    Shared& s = *static_cast<Shared*>(arg);
+    for (long i = 0; i < NUM_ROUNDS / 10; ++i)
+    {
+        if (i % 4 == 0)
+        {
+            s.lock.lock();
+            ++s.a;
+            ++s.b;
+            s.lock.unlock();
+        }
+        else
+        {
+            s.lock.lock_shared();
+            if (s.a != s.b)
+            {
+                os_increment(&s.torn);
+            }
+            s.lock.unlock_shared();
+        }
+    }
+}
+
+static void test_rwlock()
+{
+    Shared s;
+    OsThread threads[NUM_THREADS];
+    for (OsThread& thread : threads)
+    {
+        CHECK(thread.start(read_write, &s));
+    }
+    for (OsThread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(s.torn == 0);
+    CHECK(s.a == NUM_THREADS * (NUM_ROUNDS / 40));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const os_char* const FILE_NAME = OS_TEXT("test_platform.tmp");
+
+static uint8_t byte_at(size_t pos)
+{
+    return static_cast<uint8_t>(pos * 7 + pos / 251);
+}
+
+static void test_file()
+{
+    const size_t SIZE = 300000;
+    static uint8_t data[SIZE];
+    for (size_t i = 0; i < SIZE; ++i)
+    {
+        data[i] = byte_at(i);
+    }
+
+    OsFile file;
+    CHECK(file.create(FILE_NAME));
+    CHECK(file.write(data, SIZE));
+    file.close();
+    CHECK(!file.is_open());
+
+    CHECK(file.open(FILE_NAME));
+    uint64_t size = 0;
+    CHECK(file.size(size) && size == SIZE);
+
+    // Reading stops at the end of the file.
+    static uint8_t buf[SIZE + 100];
+    size_t num_read = 0;
+    CHECK(file.read(buf, 1000, num_read) && num_read == 1000);
+    CHECK(memcmp(buf, data, 1000) == 0);
+    CHECK(file.read(buf, SIZE, num_read) && num_read == SIZE - 1000);
+    CHECK(memcmp(buf, data + 1000, SIZE - 1000) == 0);
+    CHECK(file.read(buf, 10, num_read) && num_read == 0);
+
+    // Views at odd positions, that outlive the file.
+    OsView whole;
+    OsView part;
+    CHECK(file.map(0, SIZE, whole));
+    CHECK(file.map(70001, 5000, part));
+    file.close();
+    CHECK(whole.data == whole.base && memcmp(whole.data, data, SIZE) == 0);
+    CHECK(memcmp(part.data, data + 70001, 5000) == 0);
+    CHECK(part.len >= 5000);
+    if (OsFile::can_prefetch())
+    {
+        OsFile::prefetch(whole);
+    }
+    OsFile::unmap(part);
+    OsFile::unmap(whole);
+
+    CHECK(!file.open(OS_TEXT("test_platform.missing")));
+
+    // A copy keeps the content and replaces an older file.
+    static const os_char* const COPY_NAME = OS_TEXT("test_platform.cpy");
+    static const os_char* const MOVED_NAME = OS_TEXT("test_platform.mvd");
+    CHECK(file.create(COPY_NAME) && file.write(data, 10));
+    file.close();
+    CHECK(os_copy_file(FILE_NAME, COPY_NAME));
+    OsDirEntry entry;
+    CHECK(os_get_entry(COPY_NAME, entry) && entry.size == SIZE);
+    CHECK(os_set_attributes(COPY_NAME, OS_ATTR_READONLY));
+    CHECK(os_get_entry(COPY_NAME, entry));
+    CHECK((entry.attributes & OS_ATTR_READONLY) != 0);
+    CHECK(os_set_attributes(COPY_NAME, 0));
+    CHECK(os_rename(COPY_NAME, MOVED_NAME));
+    CHECK(os_rename(FILE_NAME, MOVED_NAME));
+    CHECK(!os_get_entry(COPY_NAME, entry) && !os_get_entry(FILE_NAME, entry));
+    CHECK(os_get_entry(MOVED_NAME, entry) && entry.size == SIZE);
+    CHECK(os_delete_file(MOVED_NAME));
+    CHECK(!os_delete_file(MOVED_NAME));
+
+    // What is written to a temporary file can be read again.
+    CHECK(file.create_temp(FILE_NAME));
+    CHECK(file.write(data, 1000) && file.rewind());
+    CHECK(file.read(buf, 2000, num_read) && num_read == 1000);
+    CHECK(memcmp(buf, data, 1000) == 0);
+    file.close();
+    CHECK(!os_get_entry(FILE_NAME, entry));
+
+    // A file that is written through a view.
+    uint8_t* dst = nullptr;
+    CHECK(file.create_mapped(FILE_NAME, 5000, whole, dst));
+    memcpy(dst, data, 5000);
+    file.close();
+    OsFile::unmap(whole);
+    CHECK(file.open(FILE_NAME));
+    CHECK(file.read(buf, SIZE, num_read) && num_read == 5000);
+    CHECK(memcmp(buf, data, 5000) == 0);
+    file.close();
+    CHECK(os_delete_file(FILE_NAME));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DIR_NAME L"test_platform.dir"
+#define SEP OS_SEP_STR
+
+static void make_file(const os_char* path, size_t size)
+{
+    static const uint8_t data[16] = {};
+    OsFile file;
+    CHECK(file.create(path) && file.write(data, size));
+}
+
+static void test_dir_reader()
+{
+    CHECK(os_create_dir(DIR_NAME));
+    CHECK(os_create_dir(DIR_NAME SEP L"sub"));
+    CHECK(os_create_dir(DIR_NAME SEP L"sub"));
+#ifndef _WIN32
+    // A link to a file is listed, links to directories and pipes are not.
+    CHECK(symlink("file.txt", "test_platform.dir/link.txt") == 0);
+    CHECK(symlink("sub", "test_platform.dir/link_dir") == 0);
+    CHECK(mkfifo("test_platform.dir/fifo", 0666) == 0);
+#endif
+    make_file(DIR_NAME SEP OS_TEXT("file.txt"), 5);
+    make_file(DIR_NAME SEP OS_TEXT(".hidden"), 3);
+    make_file(DIR_NAME SEP OS_TEXT("\u00e4\U0001f600"), 7);
+
+    bool found_file = false;
+    bool found_sub = false;
+    int found_link = 0;
+    int num_entries = 0;
+    OsDirReader reader;
+    OsDirEntry entry;
+    CHECK(reader.open(DIR_NAME SEP));
+    while (reader.next(entry))
+    {
+        ++num_entries;
+        const os_char* const n = entry.name;
+        if (n[0] == 'f' && n[1] == 'i' && n[2] == 'l')
+        {
+            found_file = true;
+            CHECK(!entry.is_dir() && entry.size == 5);
+            CHECK((entry.attributes & OS_ATTR_READONLY) == 0);
+        }
+        else if (n[0] == 's')
+        {
+            found_sub = true;
+            CHECK(entry.is_dir());
+        }
+        else if (n[0] == 'l')
+        {
+            ++found_link;
+            CHECK(!entry.is_dir() && entry.size == 5);
+        }
+        else if (n[0] == 0xe4)
+        {
+            // a character of the BMP and a pair of surrogates
+            CHECK(n[1] == 0xd83d && n[2] == 0xde00 && n[3] == 0);
+            CHECK(entry.size == 7);
+        }
+        else if (n[0] == '.')
+        {
+            CHECK(entry.size == 3);
+#ifndef _WIN32
+            CHECK((entry.attributes & OS_ATTR_HIDDEN) != 0);
+#endif
+        }
+        // some time after 2001 and before 2100
+        CHECK(entry.write_time > 126227808000000000ull);
+        CHECK(entry.write_time < 157766112000000000ull);
+    }
+    CHECK(found_file && found_sub);
+#ifdef _WIN32
+    CHECK(num_entries == 4);
+#else
+    CHECK(num_entries == 5 && found_link == 1);
+#endif
+    reader.close();
+    CHECK(!reader.next(entry));
+
+    // without a separator at the end
+    CHECK(reader.open(DIR_NAME SEP OS_TEXT("sub")));
+    CHECK(!reader.next(entry));
+    CHECK(!reader.open(DIR_NAME SEP OS_TEXT("missing")));
+
+    CHECK(os_get_entry(DIR_NAME SEP OS_TEXT("file.txt"), entry));
+    CHECK(entry.name == nullptr && entry.size == 5 && !entry.is_dir());
+    CHECK(os_get_entry(DIR_NAME, entry) && entry.is_dir());
+    CHECK(!os_get_entry(DIR_NAME SEP OS_TEXT("missing"), entry));
+
+    CHECK(os_is_dir(DIR_NAME) && !os_is_dir(DIR_NAME SEP L"file.txt"));
+    os_delete_file(DIR_NAME SEP L"file.txt");
+    os_delete_file(DIR_NAME SEP L".hidden");
+    os_delete_file(DIR_NAME SEP L"\u00e4\U0001f600");
+#ifndef _WIN32
+    unlink("test_platform.dir/link.txt");
+    unlink("test_platform.dir/link_dir");
+    unlink("test_platform.dir/fifo");
+#endif
+    CHECK(os_delete_dir(DIR_NAME SEP L"sub"));
+    CHECK(os_delete_dir(DIR_NAME));
+    CHECK(!os_delete_dir(DIR_NAME));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define MON_NAME L"test_platform.mon"
+
+// The names that a monitor has reported so far.
+struct Seen
+{
+    static const int MAX = 64;
+    os_char names[MAX][64];
+    int count;
+};
+
+static void on_name(void* pctxt, const os_char* name, size_t len)
+{
+    Seen* seen = static_cast<Seen*>(pctxt);
+    if (seen->count < Seen::MAX && len < 64)
+    {
+        memcpy(seen->names[seen->count], name, len * sizeof(os_char));
+        seen->names[seen->count][len] = 0;
+        ++seen->count;
+    }
+}
+
+static bool has_seen(const Seen& seen, const os_char* name)
+{
+    for (int i = 0; i < seen.count; ++i)
+    {
+        const os_char* a = seen.names[i];
+        const os_char* b = name;
+        while (*a && *a == *b)
+        {
+            ++a;
+            ++b;
+        }
+        if (*a == 0 && *b == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Waits until name has been reported, at most for a few rounds.
+static bool wait_for(OsDirMonitor& monitor, Seen& seen, const os_char* name)
+{
+    for (int round = 0; round < 20 && !has_seen(seen, name); ++round)
+    {
+        if (monitor.wait(on_name, &seen) == OsDirMonitor::FAILED)
+        {
+            return false;
+        }
+    }
+    return has_seen(seen, name);
+}
+
+static void stop_monitor(void* arg)
+{
+    os_sleep(50);
+    static_cast<OsDirMonitor*>(arg)->stop();
+}
+
+static void test_dir_monitor()
+{
+    OsDirMonitor monitor;
+    CHECK(!monitor.open(MON_NAME SEP OS_TEXT("missing")));
+    CHECK(os_create_dir(MON_NAME));
+    CHECK(os_create_dir(MON_NAME SEP OS_TEXT("a")));
+    if (!monitor.open(MON_NAME))
+    {
+#ifdef __linux__
+        CHECK(false);
+#endif
+        return;
+    }
+
+    // below the root, in a directory that existed before and in one that
+    // has been created later
+    Seen seen = {};
+    make_file(MON_NAME SEP OS_TEXT("x.txt"), 1);
+    make_file(MON_NAME SEP OS_TEXT("a") SEP OS_TEXT("y.txt"), 1);
+    CHECK(os_create_dir(MON_NAME SEP OS_TEXT("b")));
+    CHECK(wait_for(monitor, seen, OS_TEXT("x.txt")));
+    CHECK(wait_for(monitor, seen, OS_TEXT("a") SEP OS_TEXT("y.txt")));
+    CHECK(wait_for(monitor, seen, OS_TEXT("b")));
+    make_file(MON_NAME SEP OS_TEXT("b") SEP OS_TEXT("z.txt"), 1);
+    CHECK(wait_for(monitor, seen, OS_TEXT("b") SEP OS_TEXT("z.txt")));
+
+    // A directory that has been renamed is reported under its new name.
+    CHECK(os_rename(MON_NAME SEP L"a", MON_NAME SEP L"c"));
+    make_file(MON_NAME SEP OS_TEXT("c") SEP OS_TEXT("w.txt"), 1);
+    CHECK(wait_for(monitor, seen, OS_TEXT("c") SEP OS_TEXT("w.txt")));
+
+    // stop() ends a wait() that is blocked
+    OsThread thread;
+    CHECK(thread.start(stop_monitor, &monitor));
+    CHECK(monitor.wait(on_name, &seen) == OsDirMonitor::STOPPED);
+    thread.join();
+    monitor.close();
+
+#ifdef _WIN32
+    os_delete_file(MON_NAME L"\\x.txt");
+    os_delete_file(MON_NAME L"\\b\\z.txt");
+    os_delete_file(MON_NAME L"\\c\\y.txt");
+    os_delete_file(MON_NAME L"\\c\\w.txt");
+    os_delete_dir(MON_NAME L"\\b");
+    os_delete_dir(MON_NAME L"\\c");
+    os_delete_dir(MON_NAME);
+#else
+    // Deleting the root makes the monitor fail.
+    CHECK(monitor.open(MON_NAME));
+    os_delete_file(MON_NAME L"/x.txt");
+    os_delete_file(MON_NAME L"/b/z.txt");
+    os_delete_file(MON_NAME L"/c/y.txt");
+    os_delete_file(MON_NAME L"/c/w.txt");
+    os_delete_dir(MON_NAME L"/b");
+    os_delete_dir(MON_NAME L"/c");
+    os_delete_dir(MON_NAME);
+    OsDirMonitor::Result result = OsDirMonitor::CHANGES;
+    for (int round = 0; round < 20 && result == OsDirMonitor::CHANGES; ++round)
+    {
+        result = monitor.wait(on_name, &seen);
+    }
+    CHECK(result == OsDirMonitor::FAILED);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_system()
+{
+    CHECK(os_num_cpus() >= 1);
+    CHECK(os_avail_memory() > 0);
+#if defined(_WIN32) || defined(__linux__)
+    CHECK(os_private_memory() > 0);
+#endif
+    const uint32_t before = os_ticks();
+    os_sleep(20);
+    const uint32_t elapsed = os_ticks() - before;
+    CHECK(elapsed >= 15 && elapsed < 5000);
+
+    CHECK(os_lowest_bit(1) == 0 && os_lowest_bit(0x80000000) == 31);
+    CHECK(os_lowest_bit(0x00f0) == 4);
+
+    // A day has 24 hours, unless the clock is changed.
+    uint64_t day1 = 0;
+    uint64_t day2 = 0;
+    CHECK(os_local_midnight(2024, 1, 10, day1));
+    CHECK(os_local_midnight(2024, 1, 11, day2));
+    CHECK(day2 - day1 == 24 * 3600 * 10000000ull);
+    CHECK(!os_local_midnight(2024, 2, 30, day1));
+
+    os_char dir[1024];
+    const size_t len = os_app_data_dir(dir, 1024);
+    CHECK(len > 0 && len < 1024 && dir[len] == 0);
+    CHECK(os_app_data_dir(dir, 2) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool equal(const os_char* a, const os_char* b, size_t len)
+{
+    return memcmp(a, b, len * sizeof(os_char)) == 0;
+}
+
+static void test_text()
+{
+    // 'a', U+00E4, U+20AC, U+1F600
+    static const char utf8[] = "a\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80";
+    static const os_char utf16[] = { 'a', 0xe4, 0x20ac, 0xd83d, 0xde00 };
+    os_char wide[16];
+    char narrow[32];
+    CHECK(os_to_utf16(OS_CP_UTF8, utf8, 10, nullptr, 0, true) == 5);
+    CHECK(os_to_utf16(OS_CP_UTF8, utf8, 10, wide, 16, true) == 5);
+    CHECK(equal(wide, utf16, 5));
+    CHECK(os_to_utf16(OS_CP_UTF8, utf8, 10, wide, 4, true) == 0);
+    CHECK(os_from_utf16(OS_CP_UTF8, utf16, 5, nullptr, 0) == 10);
+    CHECK(os_from_utf16(OS_CP_UTF8, utf16, 5, narrow, 32) == 10);
+    CHECK(memcmp(narrow, utf8, 10) == 0);
+
+    // A sequence that ends too early, an overlong one and a surrogate.
+    static const char bad[] = "x\xe2\x82y\xc0\xafz\xed\xa0\x80";
+    CHECK(os_to_utf16(OS_CP_UTF8, bad, 10, wide, 16, true) == 0);
+    const size_t num = os_to_utf16(OS_CP_UTF8, bad, 10, wide, 16, false);
+    CHECK(num >= 4 && wide[0] == 'x' && wide[1] == 0xfffd);
+    CHECK(wide[num - 1] == 0xfffd);
+#ifndef _WIN32
+    // Latin-1
+    CHECK(os_to_utf16(OS_CP_ANSI, "\xe4\xff", 2, wide, 16, true) == 2);
+    CHECK(wide[0] == 0xe4 && wide[1] == 0xff);
+    CHECK(os_from_utf16(OS_CP_ANSI, utf16, 3, narrow, 32) == 3);
+    CHECK(memcmp(narrow, "a\xe4?", 3) == 0);
+    CHECK(os_ansi_is_single_byte());
+#endif
+
+    os_char text[] = L"AbC\u00c4\u0416";
+    os_to_lower(text, 5);
+    CHECK(equal(text, L"abc\u00e4\u0436", 5));
+    CHECK(os_strlen(text) == 5 && os_strlen(L"") == 0);
+    CHECK(os_strcmpi(L"Readme.TXT", L"README.txt") == 0);
+    CHECK(os_strcmpi(L"a", L"B") < 0 && os_strcmpi(L"ab", L"A") > 0);
+
+    OsStdStream out(false);
+    CHECK(out.write(L"", 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_atomics();
+    test_condvar();
+    test_rwlock();
+    test_file();
+    test_dir_reader();
+    test_dir_monitor();
+    test_system();
+    test_text();
+    printf("%s\n", num_failed ? "FAILED" : "ok");
+    return num_failed ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//
+// Tests ResultStore without Windows or a GUI. Returns 0 if all checks pass.
+//
+
+#include "../result_store.h"
+#include <cstdio>
+#include <cwchar>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int num_failed = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+    if (!ok)
+    {
+        printf("line %d: CHECK(%s) failed\n", line, what);
+        ++num_failed;
+    }
+}
+
+static bool same_text(const wchar_t* text, unsigned len, const wchar_t* exp)
+{
+    return (
+        len == wcslen(exp) &&
+        (len == 0 || (text != nullptr && wmemcmp(text, exp, len) == 0))
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_rows()
+{
+    ResultStore store;
+    CHECK(store.num_rows() == 0 && store.num_files() == 0);
+
+    const std::wstring a(L"C:\\src\\a.cpp");
+    CHECK(store.add_file(a.c_str(), unsigned(a.length()), 7, 3) == 0);
+    CHECK(store.add_row(1, 0, L"first", 5));
+    CHECK(store.add_row(42, 2, nullptr, 0));
+    const std::wstring b(L"C:\\src\\sub\\b.txt");
+    CHECK(store.add_file(b.c_str(), unsigned(b.length()), 7, 1) == 1);
+    CHECK(store.add_row(0x100000000ull, 1, L"beyond 4G lines", 15));
+
+    CHECK(store.num_rows() == 3 && store.num_files() == 2);
+    CHECK(store.file_id(0) == 0 && store.file_id(1) == 0);
+    CHECK(store.file_id(2) == 1);
+    CHECK(store.line_number(1) == 42 && store.pattern(1) == 2);
+    CHECK(store.line_number(2) == 0x100000000ull);
+    CHECK(wcscmp(store.path(1), b.c_str()) == 0);
+    CHECK(wcscmp(store.display_name(0), L"a.cpp") == 0);
+    CHECK(store.encoding(0) == 3 && store.encoding(1) == 1);
+
+    unsigned len;
+    const wchar_t* text = store.text(0, len);
+    CHECK(same_text(text, len, L"first"));
+    CHECK(store.text(1, len) == nullptr && len == 0);
+    text = store.text(2, len);
+    CHECK(same_text(text, len, L"beyond 4G lines"));
+
+    store.clear();
+    CHECK(store.num_rows() == 0 && store.num_files() == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_many_rows()
+{
+    // Enough text to fill several chunks of the arena. The text of every
+    // row has to stay where it is, while more rows are added.
+    const unsigned NUM_ROWS = 300000;
+    ResultStore store;
+    std::wstring line;
+    for (unsigned i = 0; i < NUM_ROWS; ++i)
+    {
+        if (i % 1000 == 0)
+        {
+            const std::wstring path = L"file" + std::to_wstring(i / 1000);
+            store.add_file(path.c_str(), unsigned(path.length()), 0, 0);
+        }
+        line = L"line " + std::to_wstring(i) + std::wstring(i % 17, L'x');
+        store.add_row(i + 1, 0, line.c_str(), unsigned(line.length()));
+    }
+    unsigned len;
+    const wchar_t* const first = store.text(0, len);
+    CHECK(store.num_rows() == NUM_ROWS);
+    CHECK(store.num_files() == NUM_ROWS / 1000);
+    bool all_same = true;
+    for (unsigned i = 0; i < NUM_ROWS; i += 7)
+    {
+        line = L"line " + std::to_wstring(i) + std::wstring(i % 17, L'x');
+        const wchar_t* text = store.text(i, len);
+        all_same = (
+            all_same &&
+            same_text(text, len, line.c_str()) &&
+            store.line_number(i) == i + 1 &&
+            store.file_id(i) == i / 1000
+            );
+    }
+    CHECK(all_same);
+    CHECK(store.text(0, len) == first);
+    CHECK(wcscmp(store.path(store.num_files() - 1), L"file299") == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_long_text()
+{
+    // A text longer than a chunk is neither truncated nor does it keep the
+    // short texts around it from sharing their chunk.
+    const unsigned LONG_LEN = TextArena::CHUNK_LEN * 2 + 3;
+    const std::wstring long_text(LONG_LEN, L'y');
+    const std::wstring path(L"big.log");
+    ResultStore store;
+    store.add_file(path.c_str(), unsigned(path.length()), 0, 0);
+    CHECK(store.add_row(1, 0, L"short", 5));
+    CHECK(store.add_row(2, 0, long_text.c_str(), LONG_LEN));
+    CHECK(store.add_row(3, 0, L"after", 5));
+
+    unsigned len;
+    const wchar_t* text = store.text(1, len);
+    CHECK(same_text(text, len, long_text.c_str()));
+    const wchar_t* const first = store.text(0, len);
+    CHECK(same_text(first, len, L"short"));
+    text = store.text(2, len);
+    CHECK(same_text(text, len, L"after"));
+    CHECK(text == first + 5);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void test_memory()
+{
+    // 5M matching lines of typical length have to fit well under 1 GB. The
+    // bound is meant for the 16 bit wchar_t of Windows. Elsewhere the text
+    // takes twice the space, so the bound is doubled there.
+    const unsigned NUM_ROWS = 5000000;
+    const unsigned LINE_LEN = 40;
+    const size_t MAX_BYTES = (size_t(1) << 30) / 2 * sizeof(wchar_t);
+    const std::wstring line(LINE_LEN, L'z');
+    ResultStore store;
+    bool all_added = true;
+    for (unsigned i = 0; i < NUM_ROWS; ++i)
+    {
+        if (i % 100 == 0)
+        {
+            const std::wstring path = L"dir\\file" + std::to_wstring(i);
+            store.add_file(path.c_str(), unsigned(path.length()), 4, 0);
+        }
+        all_added = (
+            all_added &&
+            store.add_row(i + 1, 0, line.c_str(), LINE_LEN)
+            );
+    }
+    CHECK(all_added && store.num_rows() == NUM_ROWS);
+    CHECK(store.bytes() < MAX_BYTES);
+
+    // Besides its text, a row takes 28 bytes in the columns. Those grow by
+    // doubling, so up to twice that may have been allocated.
+    const size_t text_bytes = size_t(NUM_ROWS) * LINE_LEN * sizeof(wchar_t);
+    CHECK(store.bytes() > text_bytes);
+    CHECK((store.bytes() - text_bytes) / NUM_ROWS <= 2 * 28 + 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_rows();
+    test_many_rows();
+    test_long_text();
+    test_memory();
+    printf("%s\n", num_failed ? "FAILED" : "ok");
+    return num_failed ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
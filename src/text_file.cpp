@@ -27,87 +27,269 @@
 
 #include "pch.h"
 #include "text_file.h"
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define TF_USE_SSE2 1
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 
-BYTE* TextFile::map_file(const Yast& path, size_t max_size)
+TextFile::TextFile(TextFile&& other) :
+    m_path(std::move(other.m_path)),
+    m_content(std::move(other.m_content)),
+    m_view(other.m_view),
+    m_bytes(other.m_bytes),
+    m_bytes_len(other.m_bytes_len),
+    m_codepage(other.m_codepage),
+    m_size(other.m_size),
+    m_encoding(other.m_encoding),
+    m_too_large(other.m_too_large),
+    m_stream(other.m_stream),
+    m_stream_size(other.m_stream_size),
+    m_text_start(other.m_text_start),
+    m_next_start(other.m_next_start),
+    m_next_line(other.m_next_line),
+    m_line_base(other.m_line_base),
+    m_context(other.m_context),
+    m_accept(other.m_accept),
+    m_overlap(other.m_overlap),
+    m_buffer(other.m_buffer)
 {
-    HANDLE file = CreateFileW(
-        path,
-        GENERIC_READ,
-        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-        nullptr,
-        OPEN_EXISTING,
-        FILE_FLAG_SEQUENTIAL_SCAN,
-        0
-        );
+    other.m_buffer = nullptr;
+    other.m_view.base = nullptr;
+    other.m_bytes = nullptr;
+    other.m_bytes_len = 0;
+    other.m_stream = nullptr;
+}
 
-    if (file == INVALID_HANDLE_VALUE)
+////////////////////////////////////////////////////////////////////////////////
+
+void TextFile::unload()
+{
+    release_view();
+    m_bytes = nullptr;
+    m_bytes_len = 0;
+    if (m_stream)
+    {
+        delete m_stream;
+        m_stream = nullptr;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Asking for the available memory is too expensive to be done for every
+// file, so it is only asked for again after this many milliseconds.
+static const uint32_t MEMORY_STATUS_INTERVAL = 1000;
+
+// The size of the largest file that is loaded as a whole: a fifth of the
+// available physical memory. The value is shared by all threads. It is kept
+// in two longs, so it can be read and written without a lock. A race only
+// causes an additional refresh.
+static ULONGLONG load_limit()
+{
+    static volatile long s_limit_kb = 0;
+    static volatile long s_refreshed = 0;
+
+    const uint32_t now = os_ticks();
+    if (
+        s_limit_kb == 0 ||
+        now - static_cast<uint32_t>(s_refreshed) >= MEMORY_STATUS_INTERVAL
+        )
+    {
+        ULONGLONG limit_kb = os_avail_memory() / 5 / 1024;
+        if (limit_kb > MAXLONG)
+        {
+            limit_kb = MAXLONG;
+        }
+        else if (limit_kb == 0)
+        {
+            limit_kb = 1;
+        }
+        os_exchange(&s_limit_kb, static_cast<long>(limit_kb));
+        os_exchange(&s_refreshed, static_cast<long>(now));
+    }
+    return static_cast<ULONGLONG>(s_limit_kb) * 1024;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const BYTE* TextFile::load_bytes(
+    const Yast& path,
+    size_t max_size,
+    ULONGLONG size_hint
+    )
+{
+    OsFile file;
+    if (!file.open(path))
     {
         return nullptr;
     }
 
-    MEMORYSTATUSEX mstat = {sizeof(MEMORYSTATUSEX)};
-    GlobalMemoryStatusEx(&mstat);
-    const UINT threshold_percent = 20U;
-    const UINT thresh_div = 100U / threshold_percent;
-    const ULONGLONG threshold = mstat.ullAvailPhys / thresh_div;
+    // A file that ends before the buffer is full has been read completely
+    // and does not even need its size to be asked for. One that has grown
+    // since it was listed is mapped after all.
+    const bool try_read = size_hint < READ_LIMIT || size_hint == SIZE_UNKNOWN;
+    if (try_read && m_buffer == nullptr)
+    {
+        m_buffer = p2p<BYTE*>(malloc(READ_LIMIT));
+    }
+    size_t num_read = 0;
+    if (
+        try_read &&
+        m_buffer &&
+        file.read(m_buffer, READ_LIMIT, num_read) &&
+        num_read < READ_LIMIT
+        )
+    {
+        if (num_read == 0)
+        {
+            // like an empty file, that cannot be mapped
+            return nullptr;
+        }
+        m_size = num_read;
+        return m_buffer;
+    }
 
-    LARGE_INTEGER lsize;
-    GetFileSizeEx(file, &lsize);
-    ULONGLONG fsize = lsize.QuadPart;
-    if (fsize > max_size || fsize > threshold)
+    uint64_t fsize = 0;
+    if (!file.size(fsize))
+    {
+        return nullptr;
+    }
+    if (fsize > max_size || fsize > load_limit())
     {
-        CloseHandle(file);
+        m_too_large = true;
         return nullptr;
     }
 
-    HANDLE mapping = CreateFileMappingW(
-        file,
-        nullptr,
-        PAGE_READONLY,
-        0,
-        0,
-        nullptr
-        );
-    CloseHandle(file);
-    if (mapping == nullptr)
+    if (!file.map(0, static_cast<size_t>(fsize), m_view))
     {
+        m_view.base = nullptr;
         return nullptr;
     }
+    m_size = static_cast<size_t>(fsize);
+    return m_view.data;
+}
 
-    BYTE* pBase = static_cast<BYTE*>(
-        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
-        );
-    CloseHandle(mapping);
-    if (pBase)
+////////////////////////////////////////////////////////////////////////////////
+
+void TextFile::release_view()
+{
+    if (m_view.base)
+    {
+        OsFile::unmap(m_view);
+        m_view.base = nullptr;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TextFile::can_prefetch()
+{
+    return OsFile::can_prefetch();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const void* TextFile::prefetch(const Yast& path, size_t size)
+{
+    OsFile file;
+    OsView view;
+    if (size == 0 || !OsFile::can_prefetch() || !file.open(path))
+    {
+        return nullptr;
+    }
+    // Fails on Windows, if the file has become smaller since it was found.
+    if (!file.map(0, size, view))
+    {
+        return nullptr;
+    }
+    OsFile::prefetch(view);
+    return view.base;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TextFile::end_prefetch(const void* view, size_t size)
+{
+    if (view)
     {
-        m_size = static_cast<size_t>(fsize);
+        const OsView v = { view, size, static_cast<const uint8_t*>(view) };
+        OsFile::unmap(v);
     }
-    return pBase;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-bool TextFile::load(const Yast& path, bool prefer_utf8, bool include_binary)
+static void widen_binary(Yast& content, const BYTE* bytes, UINT len)
 {
-    m_line_ends.clear();
+    content.clear(len);
+    PWSTR dst = const_cast<PWSTR>(content.str());
+    for (UINT u = 0; u < len; u++)
+    {
+        dst[u] = bytes[u];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Converts UTF-8 to UTF-16 and checks it for validity. The first pass
+// checks and counts, the second one writes straight into content.
+static bool from_utf8(Yast& content, PCSTR src, UINT len)
+{
+    if (len == 0)
+    {
+        content.clear();
+        return true;
+    }
+    const size_t num = os_to_utf16(CP_UTF8, src, len, nullptr, 0, true);
+    if (num == 0)
+    {
+        return false;
+    }
+    content.clear(static_cast<UINT>(num));
+    os_to_utf16(
+        CP_UTF8,
+        src,
+        len,
+        const_cast<PWSTR>(content.str()),
+        num,
+        false
+        );
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TextFile::load(
+    const Yast& path,
+    bool prefer_utf8,
+    bool include_binary,
+    bool keep_bytes,
+    ULONGLONG size_hint
+    )
+{
+    unload();
     m_content.clear();
     m_encoding = TE_UNKNOWN;
+    m_too_large = false;
+    m_line_base = 0;
     m_size = 0;
     m_path = path;
 
     // Currently Yast is deliberately designed so that its size
     // cannot exceed 32 bits.
-    const BYTE* const mapping = map_file(path, Yast::MAX_LEN);
+    const BYTE* const mapping = load_bytes(path, Yast::MAX_LEN, size_hint);
     if (mapping == nullptr)
     {
         return false;
     }
-    m_encoding = guess_encoding(mapping, m_size, prefer_utf8);
+    // If the content is converted right away, checking for valid UTF-8 is
+    // done while converting.
+    m_encoding = guess_encoding(mapping, m_size, prefer_utf8, keep_bytes);
     if (m_encoding == TE_BINARY && !include_binary)
     {
-        UnmapViewOfFile(mapping);
+        release_view();
         return false;
     }
 
@@ -143,19 +325,20 @@ bool TextFile::load(const Yast& path, bool prefer_utf8, bool include_binary)
             break;
     }
 
+    if (keep_bytes && (cp == CP_ACP || cp == CP_UTF8 || cp == bin_to_utf16))
+    {
+        // The view stays alive until unload() is called.
+        m_bytes = p_cnv;
+        m_bytes_len = c_size;
+        m_codepage = cp;
+        return true;
+    }
+
     switch (cp)
     {
         case bin_to_utf16:
-        {
-            // store each byte as the corresponding code point
-            m_content.clear(c_size);
-            PWSTR dst = const_cast<PWSTR>(m_content.str());
-            for (UINT u = 0; u < c_size; u++)
-            {
-                dst[u] = mapping[u];
-            }
+            widen_binary(m_content, mapping, c_size);
             break;
-        }
 
         case keep_utf16:
         {
@@ -165,145 +348,487 @@ bool TextFile::load(const Yast& path, bool prefer_utf8, bool include_binary)
             break;
         }
 
+        case CP_UTF8:
+            if (m_encoding == TE_UTF8_BOM)
+            {
+                m_content = Yast(c_size, p_cnv, cp);
+            }
+            else if (!from_utf8(m_content, p_cnv, c_size))
+            {
+                // not valid UTF-8 after all
+                m_encoding = TE_ANSI;
+                m_content = Yast(c_size, p_cnv, CP_ACP);
+            }
+            break;
+
         default:
             // convert from cp to utf16
             m_content = Yast(c_size, p_cnv, cp);
             break;
     }
 
-    UnmapViewOfFile(mapping);
+    release_view();
 
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-LineInfos TextFile::lines_from_ranges(const ranges& bounds)
+void TextFile::widen()
 {
-    // Reserve one info entry for every range. Overlapping is rare.
-    LineInfos result;
-    result.reserve(bounds.size());
-    auto rit = bounds.begin();
-    if (rit == bounds.end())
+    if (m_bytes)
     {
-        return result;
+        if (m_encoding == TE_BINARY)
+        {
+            widen_binary(m_content, p2p<const BYTE*>(m_bytes), m_bytes_len);
+        }
+        else
+        {
+            m_content = Yast(m_bytes_len, m_bytes, m_codepage);
+        }
+        unload();
     }
+}
 
-    if (m_encoding == TE_BINARY)
+////////////////////////////////////////////////////////////////////////////////
+
+bool TextFile::open_stream(const Yast& path, bool prefer_utf8, UINT overlap)
+{
+    unload();
+    m_content.clear();
+    m_encoding = TE_UNKNOWN;
+    m_size = 0;
+    m_path = path;
+    m_overlap = overlap;
+    m_text_start = 0;
+    m_next_start = 0;
+    m_next_line = 0;
+
+    m_stream = new OsFile;
+    if (!m_stream->open(path) || !m_stream->size(m_stream_size))
     {
-        // No line ends available -> Report range begin and empty line.
-        do
-        {
-            result.push_back(
-                LineInfo { static_cast<UINT>(rit->begin), Yast() }
-                );
-        } while (++rit != bounds.end());
-        return result;
+        unload();
+        return false;
+    }
+
+    // The encoding is guessed from the lines in the first window.
+    if (!next_window())
+    {
+        unload();
+        return false;
+    }
+    m_encoding = guess_encoding(
+        p2p<const BYTE*>(m_bytes),
+        m_bytes_len,
+        prefer_utf8
+        );
+    switch (m_encoding)
+    {
+        case TE_ANSI:
+            m_codepage = CP_ACP;
+            break;
+
+        case TE_UTF8_BOM:
+            m_text_start = 3;   // skip BOM
+                                // fall through
+        case TE_UTF8:
+            m_codepage = CP_UTF8;
+            break;
+
+        default:
+            // UTF-16 and binary files are not supported
+            unload();
+            return false;
     }
+    m_next_start = m_text_start;
+    m_next_line = 0;
+    return true;
+}
 
-    // determine line ends, expecting an average line length of 32
-    m_line_ends.reserve(m_content.length() / 32);
-    PCWSTR it = m_content.str();
-    PCWSTR const begin = it;
-    PCWSTR const end = it + m_content.length();
-    while(it < end)
+////////////////////////////////////////////////////////////////////////////////
+
+// A line ends at every '\n' and at a '\r' that is not followed by '\n'.
+// So the line end of "\r\n" is the position of '\n'. The character behind
+// a '\r' always belongs to its line end, which makes "\r\r" a single line
+// end. So a '\r' only ends a line, if an even number of '\r' precede it.
+
+template <class C>
+static size_t count_cr_in_front(const C* str, size_t pos)
+{
+    size_t num = 0;
+    while (num < pos && str[pos - num - 1] == '\r')
     {
-        if (*it == L'\r')
+        ++num;
+    }
+    return num;
+}
+
+template <class C>
+static inline bool ends_with_cr(const C* str, size_t len, size_t pos)
+{
+    return pos + 1 == len || str[pos + 1] != '\n';
+}
+
+template <class C>
+static inline bool is_line_end(const C* str, size_t len, size_t pos)
+{
+    return (
+        str[pos] == '\n' || (
+            str[pos] == '\r' &&
+            ends_with_cr(str, len, pos) &&
+            (count_cr_in_front(str, pos) & 1) == 0
+            )
+        );
+}
+
+// A window may only start behind a line end, that isn't followed by a '\r'.
+// Otherwise the parity of the '\r' in front of it would get lost.
+template <class C>
+static inline bool is_line_start(const C* str, size_t len, size_t pos)
+{
+    return is_line_end(str, len, pos - 1) && str[pos] != '\r';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Counts the line ends in [from, to) one character after the other.
+template <class C>
+static size_t count_line_ends_slowly(
+    const C* str,
+    size_t len,
+    size_t from,
+    size_t to
+    )
+{
+    size_t count = 0;
+    size_t num_cr = count_cr_in_front(str, from);
+    for (size_t pos = from; pos < to; ++pos)
+    {
+        const C c = str[pos];
+        count += (
+            c == '\n' || (
+                c == '\r' &&
+                (num_cr & 1) == 0 &&
+                ends_with_cr(str, len, pos)
+                )
+            );
+        num_cr = (c == '\r') ? num_cr + 1 : 0;
+    }
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef TF_USE_SSE2
+
+static inline __m128i splat(char c)
+{
+    return _mm_set1_epi8(c);
+}
+
+static inline __m128i splat(WCHAR c)
+{
+    return _mm_set1_epi16(static_cast<short>(c));
+}
+
+static inline __m128i equal(__m128i a, __m128i b, char)
+{
+    return _mm_cmpeq_epi8(a, b);
+}
+
+static inline __m128i equal(__m128i a, __m128i b, WCHAR)
+{
+    return _mm_cmpeq_epi16(a, b);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Counts the line ends in [from, to).
+template <class C>
+static size_t count_line_ends(const C* str, size_t len, size_t from, size_t to)
+{
+    size_t count = 0;
+    size_t pos = from;
+#ifdef TF_USE_SSE2
+    // As long as no '\r' follows another one, every '\n' and every '\r'
+    // that is not followed by '\n' is a line end. Blocks that contain
+    // "\r\r" are rare and counted slowly. A comparison yields -1 for every
+    // line end, that is subtracted from 8 bit counters. Those are summed
+    // up before they could overflow. For WCHAR every line end is counted
+    // in both of its bytes. Looking at the characters around a block
+    // needs one more on each side.
+    const size_t LANES = sizeof(__m128i) / sizeof(C);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v_lf = splat(static_cast<C>('\n'));
+    const __m128i v_cr = splat(static_cast<C>('\r'));
+    if (pos == 0 && to != 0)
+    {
+        count += count_line_ends_slowly(str, len, 0, 1);
+        pos = 1;
+    }
+    while (pos + LANES <= to && pos + LANES < len)
+    {
+        __m128i acc = zero;
+        for (
+            size_t b = 0;
+            b < 255 && pos + LANES <= to && pos + LANES < len;
+            ++b, pos += LANES
+            )
         {
-            size_t pos = it++ - begin;
-            if (*it == L'\n')
+            const __m128i cur = _mm_loadu_si128(p2p<const __m128i*>(str + pos));
+            const __m128i prev = _mm_loadu_si128(
+                p2p<const __m128i*>(str + pos - 1)
+                );
+            const __m128i next = _mm_loadu_si128(
+                p2p<const __m128i*>(str + pos + 1)
+                );
+            const __m128i cr = equal(cur, v_cr, C());
+            if (_mm_movemask_epi8(_mm_and_si128(cr, equal(prev, v_cr, C()))))
             {
-                pos += 1;
+                count += count_line_ends_slowly(str, len, pos, pos + LANES);
+                continue;
             }
-            m_line_ends.push_back(pos);
-        }
-        else if (*it == L'\n')
-        {
-            m_line_ends.push_back(it - begin);
+            const __m128i lf = equal(cur, v_lf, C());
+            const __m128i lone_cr = _mm_andnot_si128(
+                equal(next, v_lf, C()),
+                cr
+                );
+            acc = _mm_sub_epi8(acc, _mm_or_si128(lf, lone_cr));
         }
-        ++it;
+        const __m128i sum = _mm_sad_epu8(acc, zero);
+        count += (
+            static_cast<size_t>(_mm_cvtsi128_si32(sum)) +
+            static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)))
+            ) / sizeof(C);
     }
-    m_line_ends.push_back(m_content.length());
+#endif
+    return count + count_line_ends_slowly(str, len, pos, to);
+}
 
+////////////////////////////////////////////////////////////////////////////////
 
-    auto lit = m_line_ends.begin();
-    auto const first_line = lit;
+bool TextFile::next_window()
+{
+    release_view();
+    m_bytes = nullptr;
+    m_bytes_len = 0;
+    if (m_stream == nullptr || m_next_start >= m_stream_size)
+    {
+        return false;
+    }
+
+    // The byte in front of the window is mapped too, if there is one.
+    const ULONGLONG start = m_next_start;
+    const UINT context = (start > m_text_start) ? 1 : 0;
+    const ULONGLONG view_end = (
+        (m_stream_size - start > STREAM_WINDOW) ?
+        start + STREAM_WINDOW :
+        m_stream_size
+        );
+    if (
+        !m_stream->map(
+            start - context,
+            static_cast<size_t>(view_end - (start - context)),
+            m_view
+            )
+        )
+    {
+        m_view.base = nullptr;
+        return false;
+    }
 
-    bool wait_for_range_start = true;
-    while (lit != m_line_ends.end())
+    PCSTR const p = p2p<PCSTR>(m_view.data + context);
+    UINT len = static_cast<UINT>(view_end - start);
+    UINT accept = len;
+    if (view_end < m_stream_size)
     {
-        bool add_line = false;
-        if (wait_for_range_start && (rit->begin <= *lit))
+        // End the window behind its last line end, unless a single line
+        // is longer than the whole window. The last character is needed to
+        // tell a lone '\r' from "\r\n", so it can't end the window itself.
+        UINT end = len - 1;
+        while (end > 0 && !is_line_start(p, len, end))
         {
-            // This line contains a range start.
-            add_line = true;
-            wait_for_range_start = false;
+            --end;
         }
-        else if (!wait_for_range_start && (rit->end > *lit))
+        if (end > 0)
         {
-            // This is one of the lines that are completely inside of a range.
-            add_line = true;
+            len = end;
         }
-        else if (!wait_for_range_start && (rit->end <= *lit))
+
+        // Let the next window start 'overlap' lines in front of the end
+        // of this one, but make sure that it starts behind this one.
+        UINT line_start = len;
+        for (UINT n = 0; n < m_overlap && line_start > 0; ++n)
         {
-            // On this line a range ends.
-            add_line = wait_for_range_start = true;
+            --line_start;
+            while (line_start > 0 && !is_line_start(p, len, line_start))
+            {
+                --line_start;
+            }
         }
-        if (add_line)
+        accept = (line_start > 0) ? line_start : len;
+    }
+
+    const ULONGLONG lines = count_line_ends(p, len, 0, accept);
+    m_line_base = m_next_line;
+    m_next_line += lines;
+    m_next_start = start + accept;
+
+    m_bytes = p;
+    m_bytes_len = len;
+    m_context = context;
+    m_accept = accept;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UINT TextFile::append_line_text(LineText& text, size_t begin, size_t end)
+{
+    const size_t pos = text.size();
+    const UINT len = static_cast<UINT>(end - begin);
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (m_bytes)
+    {
+        // Only the lines that are reported get converted to UTF-16, which
+        // never needs more code units than there are bytes.
+        text.resize(pos + len);
+        const size_t num = os_to_utf16(
+            m_codepage,
+            p2p<PCSTR>(m_bytes + begin),
+            len,
+            &text[pos],
+            len,
+            false
+            );
+        text.resize(pos + num);
+        return static_cast<UINT>(text.size() - pos);
+    }
+    const WCHAR* str = m_content.str() + begin;
+    text.insert(text.end(), str, str + len);
+    return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+LineInfos TextFile::lines_from_ranges(const ranges& bounds, LineText& text)
+{
+    if (m_encoding == TE_BINARY)
+    {
+        // No line ends available -> Report range begin and empty line.
+        LineInfos result;
+        result.reserve(bounds.size());
+        for (const range& r : bounds)
         {
-            const UINT line_no = static_cast<UINT>((lit - first_line) + 1);
-            const UINT line_end = static_cast<UINT>(*lit);
-            const UINT line_begin = (
-                (lit == first_line) ?
-                0 :
-                static_cast<UINT>(*(lit - 1) + 1)
-                );
-            result.push_back(
-                LineInfo { line_no, m_content.slice(line_begin, line_end) }
+            result.push_back(LineInfo { r.begin, 0, 0, r.pattern });
+        }
+        return result;
+    }
+    if (m_bytes)
+    {
+        return lines_from_ranges(m_bytes, m_bytes_len, bounds, text);
+    }
+    return lines_from_ranges(
+        m_content.str(),
+        m_content.length(),
+        bounds,
+        text
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class C>
+LineInfos TextFile::lines_from_ranges(
+    const C* str,
+    size_t len,
+    const ranges& bounds,
+    LineText& text
+    )
+{
+    // Reserve one info entry for every range. Overlapping is rare.
+    LineInfos result;
+    result.reserve(bounds.size());
+    auto rit = bounds.begin();
+    if (rit == bounds.end())
+    {
+        return result;
+    }
+
+    // A line is reported, if the current range starts in it or in front of
+    // it. The lines in between the ranges are only counted and just the
+    // reported ones are looked at character by character.
+    size_t line_begin = 0;
+    ULONGLONG line_idx = 0;
+    for (;;)
+    {
+        if (rit->begin > line_begin)
+        {
+            const size_t skipped = count_line_ends(
+                str,
+                len,
+                line_begin,
+                rit->begin
                 );
-            // We added the line. So we can - and have to - skip all ranges
-            // that still end on this very line.
-            while (line_end >= rit->end)
+            if (skipped != 0)
             {
-                if (++rit == bounds.end())
+                line_idx += skipped;
+                line_begin = rit->begin;
+                while (!is_line_end(str, len, line_begin - 1))
                 {
-                    return result;
+                    --line_begin;
                 }
             }
-            // If the next interesting range - being now pointed to by rit -
-            // starts behind the line we just added, we have to expect a
-            // range start - no matter what the current value of
-            // wait_for_range_start is.
-            if (rit->begin > *lit)
+        }
+        size_t line_end = line_begin;
+        while (line_end < len && !is_line_end(str, len, line_end))
+        {
+            ++line_end;
+        }
+
+        const size_t text_pos = text.size();
+        result.push_back(
+            LineInfo {
+                m_line_base + line_idx + 1,
+                text_pos,
+                append_line_text(text, line_begin, line_end),
+                rit->pattern
+                }
+            );
+
+        // We added the line. So we can - and have to - skip all ranges
+        // that still end on this very line.
+        while (line_end >= rit->end)
+        {
+            if (++rit == bounds.end())
             {
-                wait_for_range_start = true;
+                return result;
             }
         }
-        ++lit;
+        if (line_end == len)
+        {
+            return result;
+        }
+        line_begin = line_end + 1;
+        ++line_idx;
     }
-    return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 bool TextFile::store(const Yast& path)
 {
-    HANDLE file = CreateFile(
-        path,
-        GENERIC_WRITE,
-        FILE_SHARE_READ,
-        nullptr,
-        CREATE_ALWAYS,
-        FILE_FLAG_SEQUENTIAL_SCAN,
-        nullptr
-        );
-    if (file == INVALID_HANDLE_VALUE)
+    OsFile file;
+    if (!file.create(path))
     {
         return false;
     }
 
-    DWORD num_written;
-
     bool r = true;
     const UINT keep_utf16 = ~0U;
     UINT cp = CP_ACP;
@@ -315,7 +840,7 @@ bool TextFile::store(const Yast& path)
             break;
 
         case TE_UTF8_BOM:
-            r = r && WriteFile(file, "\xef\xbb\xbf", 3, &num_written, nullptr);
+            r = r && file.write("\xef\xbb\xbf", 3);
             // fall through
 
         case TE_UTF8:
@@ -323,7 +848,7 @@ bool TextFile::store(const Yast& path)
             break;
 
         case TE_UTF16_LE_BOM:
-            r = r && WriteFile(file, "\xfe\xff", 2, &num_written, nullptr);
+            r = r && file.write("\xfe\xff", 2);
             // fall through
 
         case TE_UTF16_LE:
@@ -341,8 +866,8 @@ bool TextFile::store(const Yast& path)
         p_data = cvt.str();
     }
 
-    r = r && WriteFile(file, p_data, len, &num_written, nullptr);
-    return (CloseHandle(file) && r);
+    r = r && file.write(p_data, len);
+    return r;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
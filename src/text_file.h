@@ -28,18 +28,112 @@
 #pragma once
 
 #include "rgrep_util.h"
+#include "platform.h"
 
 class TextFile
 {
 public:
 
-    TextFile() : m_size(0), m_encoding(TE_UNKNOWN)
+    TextFile() :
+        m_view(),
+        m_bytes(nullptr),
+        m_bytes_len(0),
+        m_codepage(CP_ACP),
+        m_size(0),
+        m_encoding(TE_UNKNOWN),
+        m_too_large(false),
+        m_stream(nullptr),
+        m_stream_size(0),
+        m_text_start(0),
+        m_next_start(0),
+        m_next_line(0),
+        m_line_base(0),
+        m_context(0),
+        m_accept(0),
+        m_overlap(0),
+        m_buffer(nullptr)
     {
     }
 
-    bool load(const Yast& path, bool prefer_utf8, bool include_binary);
+    TextFile(TextFile&& other);
+
+    ~TextFile()
+    {
+        unload();
+        free(m_buffer);
+    }
+
+    //
+    // Loads a file and converts its content to UTF-16. If keep_bytes is
+    // true, UTF-8, ANSI and binary content is not converted but kept in
+    // the mapped file (see get_bytes) until widen() or unload() is called.
+    // size_hint is the size that the directory listing reported for the
+    // file, if the caller knows it (see load_bytes).
+    //
+    bool load(
+        const Yast& path,
+        bool prefer_utf8,
+        bool include_binary,
+        bool keep_bytes = false,
+        ULONGLONG size_hint = SIZE_UNKNOWN
+        );
+    void widen();
+    void unload();
+
+    // Whether the last load failed, because the file is too large.
+    bool too_large() const
+    {
+        return m_too_large;
+    }
+
+    //
+    // A file that is too large to be loaded can be searched in windows
+    // of at most STREAM_WINDOW bytes instead. This only works for UTF-8
+    // and ANSI files. Every window consists of complete lines, that are
+    // provided by get_bytes. It overlaps the previous one by 'overlap'
+    // lines, so matches that span more lines might be missed.
+    //
+    static const UINT STREAM_WINDOW = 16 * 1024 * 1024;
+    static const ULONGLONG SIZE_UNKNOWN = ~0ull;
+
+    bool open_stream(const Yast& path, bool prefer_utf8, UINT overlap);
+    bool next_window();
+
+    // Number of bytes in front of get_bytes() that belong to the previous
+    // window. They are only meant to be looked at by the matcher.
+    UINT window_context() const
+    {
+        return m_context;
+    }
+
+    // Matches that start at or behind this position relative to
+    // get_bytes() are found again in the next window.
+    UINT window_accept() const
+    {
+        return m_accept;
+    }
+
+    // Treats the stream as ANSI from now on, because its encoding has been
+    // guessed wrong. This affects the current window too.
+    void stream_as_ansi()
+    {
+        m_encoding = TE_ANSI;
+        m_codepage = CP_ACP;
+    }
     bool store(const Yast& path);
-    LineInfos lines_from_ranges(const ranges& bounds);
+
+    //
+    // Asks the system to read the first size bytes of a file into the cache
+    // without waiting for that. The view that is returned keeps the pages
+    // from being dropped before the file is loaded and has to be passed to
+    // end_prefetch with the same size (see OsFile::can_prefetch).
+    //
+    static bool can_prefetch();
+    static const void* prefetch(const Yast& path, size_t size);
+    static void end_prefetch(const void* view, size_t size);
+
+    // The text of the lines is appended to text (see LineInfo).
+    LineInfos lines_from_ranges(const ranges& bounds, LineText& text);
 
     const Yast& get_path() const
     {
@@ -61,13 +155,90 @@ public:
         return m_encoding;
     }
 
+    // Only valid while has_bytes() is true. Positions in the bytes are
+    // used in place of positions in the content then.
+    bool has_bytes() const
+    {
+        return m_bytes != nullptr;
+    }
+
+    PCSTR get_bytes() const
+    {
+        return m_bytes;
+    }
+
+    UINT get_bytes_len() const
+    {
+        return m_bytes_len;
+    }
+
+    bool bytes_are_utf8() const
+    {
+        return m_codepage == CP_UTF8;
+    }
+
+    // Whether load() has already checked the bytes for valid UTF-8.
+    // Windows of a stream and files with a BOM are not checked.
+    bool bytes_are_checked() const
+    {
+        return m_encoding == TE_UTF8 && m_stream == nullptr;
+    }
+
+    bool bytes_are_binary() const
+    {
+        return m_encoding == TE_BINARY;
+    }
+
 protected:
 
-    BYTE* map_file(const Yast& path, size_t max_size);
+    TextFile(const TextFile&) = delete;
+    TextFile& operator=(const TextFile&) = delete;
+
+    //
+    // Files of less than READ_LIMIT bytes are read with a single read
+    // into m_buffer, which is reused for every file. That saves the calls
+    // for creating and releasing a mapping, that would dominate the time
+    // for loading a small file. Larger files are mapped. A file is only
+    // read first, if its size is unknown or below READ_LIMIT.
+    //
+    static const UINT READ_LIMIT = 64 * 1024;
+
+    const BYTE* load_bytes(
+        const Yast& path,
+        size_t max_size,
+        ULONGLONG size_hint
+        );
+    void release_view();
+    UINT append_line_text(LineText& text, size_t begin, size_t end);
+
+    template <class C>
+    LineInfos lines_from_ranges(
+        const C* str,
+        size_t len,
+        const ranges& bounds,
+        LineText& text
+        );
 
-    cvector<size_t> m_line_ends;
     Yast m_path;
     Yast m_content;
+    OsView m_view;                  // base is nullptr if nothing is mapped
+    PCSTR m_bytes;
+    UINT m_bytes_len;
+    UINT m_codepage;
     size_t m_size;
     TextEncoding m_encoding;
+    bool m_too_large;
+
+    // state of a stream (see open_stream)
+    OsFile* m_stream;
+    uint64_t m_stream_size;
+    ULONGLONG m_text_start;         // behind the BOM
+    ULONGLONG m_next_start;
+    ULONGLONG m_next_line;
+    ULONGLONG m_line_base;          // lines in front of the current window
+    UINT m_context;
+    UINT m_accept;
+    UINT m_overlap;
+
+    BYTE* m_buffer;                 // READ_LIMIT bytes, see load_bytes
 };
@@ -0,0 +1,1164 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "pch.h"
+#include "trigram_index.h"
+#include "text_file.h"
+#include "dir_iter.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Layout of an index file:
+//
+//      IndexHeader
+//      IndexFile   files[num_files]        sorted by name
+//      IndexKey    keys[num_keys]          sorted by key
+//      UINT        postings[num_postings]  file ids, ascending per key
+//      WCHAR       names[names_len]        relative paths, not terminated
+//
+struct IndexHeader
+{
+    DWORD       magic;
+    DWORD       version;
+    UINT        num_files;
+    UINT        num_keys;
+    UINT        num_postings;
+    UINT        reserved;
+    ULONGLONG   names_len;
+};
+
+struct IndexFile
+{
+    ULONGLONG   size;
+    ULONGLONG   write_time;
+    ULONGLONG   name_pos;
+    UINT        name_len;
+    UINT        flags;
+};
+
+struct IndexKey
+{
+    UINT        key;
+    UINT        count;
+    UINT        pos;                    // of the first id in postings
+    UINT        reserved;
+};
+
+//
+// Files that have changed since the index was built are kept in a delta
+// file next to it (see TrigramIndex::update), together with their own
+// trigrams:
+//
+//      DeltaHeader
+//      for every file:
+//          DeltaRecord
+//          WCHAR   name[name_len]          padded to an even length
+//          UINT    keys[num_keys]          ascending
+//
+struct DeltaHeader
+{
+    DWORD       magic;
+    DWORD       version;
+    UINT        num_files;
+    UINT        reserved;
+};
+
+struct DeltaRecord
+{
+    ULONGLONG   size;
+    ULONGLONG   write_time;
+    UINT        name_len;
+    UINT        num_keys;
+    UINT        flags;
+    UINT        reserved;
+};
+
+static const DWORD INDEX_MAGIC = 0x49544752;    // "RGTI"
+static const DWORD DELTA_MAGIC = 0x44544752;    // "RGTD"
+static const DWORD INDEX_VERSION = 1;
+static const UINT FILE_INDEXED = 1;             // its trigrams are known
+static const UINT FILE_REMOVED = 2;             // only used by update()
+
+// When the delta gets larger, the whole index is built again.
+static const size_t MAX_DELTA_FILES = 64 * 1024;
+
+// A trigram is made of three characters folded to 8 bits each.
+static const UINT NUM_KEYS = 1 << 24;
+
+// Only that many trigrams of a literal are looked up (m_hits are BYTEs).
+static const UINT MAX_LOOKUPS = 64;
+
+// (trigram, id) pairs that are collected before writing them.
+static const size_t PAIR_BUFFER = 8 * 1024 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// ASCII letters are folded to lower case and everything beyond ASCII to
+// one of 128 values. Folding only lets the index report files that do not
+// match after all, it never hides one that does.
+static inline UINT fold(WCHAR c)
+{
+    if (c >= 0x80)
+    {
+        return 0x80 | ((c ^ (c >> 7)) & 0x7f);
+    }
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline UINT trigram(const WCHAR* p)
+{
+    return (fold(p[0]) << 16) | (fold(p[1]) << 8) | fold(p[2]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int compare_names(PCWSTR a, size_t a_len, PCWSTR b, size_t b_len)
+{
+    const size_t len = (a_len < b_len) ? a_len : b_len;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (a[i] != b[i])
+        {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+    return (a_len < b_len) ? -1 : ((a_len > b_len) ? 1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Orders anything that has a name_pos and a name_len.
+template <class F>
+struct NameLess
+{
+    const WCHAR* names;
+
+    bool operator()(const F& a, const F& b) const
+    {
+        return compare_names(
+            names + a.name_pos,
+            a.name_len,
+            names + b.name_pos,
+            b.name_len
+            ) < 0;
+    }
+};
+
+struct KeyLess
+{
+    bool operator()(UINT a, UINT b) const
+    {
+        return a < b;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <class T, class Less>
+static void sift_down(cvector<T>& items, size_t root, size_t end, Less less)
+{
+    for (;;)
+    {
+        size_t child = 2 * root + 1;
+        if (child >= end)
+        {
+            return;
+        }
+        if (child + 1 < end && less(items[child], items[child + 1]))
+        {
+            ++child;
+        }
+        if (!less(items[root], items[child]))
+        {
+            return;
+        }
+        const T tmp = items[root];
+        items[root] = items[child];
+        items[child] = tmp;
+        root = child;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Heap sort, which needs neither recursion nor additional memory.
+template <class T, class Less>
+static void heap_sort(cvector<T>& items, Less less)
+{
+    const size_t num = items.size();
+    for (size_t i = num / 2; i-- > 0; )
+    {
+        sift_down(items, i, num, less);
+    }
+    for (size_t end = num; end-- > 1; )
+    {
+        const T tmp = items[0];
+        items[0] = items[end];
+        items[end] = tmp;
+        sift_down(items, 0, end, less);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Only files that are searched as the same characters that are indexed.
+// ANSI files might be searched as (invalid) UTF-8 instead.
+static bool is_indexable(TextEncoding encoding)
+{
+    return (
+        encoding == TE_UTF8 ||
+        encoding == TE_UTF8_BOM ||
+        encoding == TE_UTF16_LE ||
+        encoding == TE_UTF16_LE_BOM
+        );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool write_pairs(OsFile& file, const cvector<UINT>& pairs)
+{
+    return pairs.empty() || file.write(&pairs[0], pairs.size() * sizeof(UINT));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Replaces the file at path without ever leaving a partial one behind.
+static bool store_file(const Yast& path, const cvector<BYTE>& data)
+{
+    const Yast new_path(path + L".new");
+    OsFile file;
+    if (!file.create(new_path))
+    {
+        return false;
+    }
+    bool ok = data.empty() || file.write(&data[0], data.size());
+    file.close();
+    ok = ok && os_rename(new_path, path);
+    if (!ok)
+    {
+        os_delete_file(new_path);
+    }
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool load_file(const Yast& path, cvector<BYTE>& data)
+{
+    data.clear();
+    OsFile file;
+    uint64_t size = 0;
+    if (!file.open(path) || !file.size(size) || size > SIZE_MAX)
+    {
+        return false;
+    }
+    size_t read = 0;
+    bool ok = true;
+    if (size != 0)
+    {
+        data.resize(static_cast<size_t>(size));
+        ok = file.read(&data[0], data.size(), read) && read == data.size();
+    }
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sets keys to the distinct trigrams of content in ascending order. seen
+// has a bit for every trigram, that has to be clear and is left clear.
+static void collect_trigrams(
+    const Yast& content,
+    cvector<UINT>& seen,
+    cvector<UINT>& keys
+    )
+{
+    keys.clear();
+    const WCHAR* str = content.str();
+    for (UINT i = 0; i + 2 < content.length(); ++i)
+    {
+        const UINT key = trigram(str + i);
+        const UINT bit = 1u << (key & 31);
+        if ((seen[key >> 5] & bit) == 0)
+        {
+            seen[key >> 5] |= bit;
+            keys.push_back(key);
+        }
+    }
+    for (UINT key : keys)
+    {
+        seen[key >> 5] = 0;
+    }
+    heap_sort(keys, KeyLess());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// The content of a delta file (see DeltaHeader).
+struct IndexDelta
+{
+    struct File
+    {
+        ULONGLONG   size;
+        ULONGLONG   write_time;
+        size_t      name_pos;
+        size_t      keys_pos;
+        UINT        name_len;
+        UINT        num_keys;
+        UINT        flags;
+    };
+
+    cvector<File>   files;              // sorted by name after load()
+    cvector<WCHAR>  names;
+    cvector<UINT>   keys;
+
+    static const size_t NOT_FOUND = ~size_t(0);
+
+    void add(
+        PCWSTR name,
+        UINT name_len,
+        ULONGLONG size,
+        ULONGLONG write_time,
+        UINT flags,
+        const UINT* file_keys,
+        UINT num_keys
+        );
+    bool load(const Yast& path);
+    bool store(const Yast& path) const;
+    size_t find(PCWSTR name, size_t len) const;
+    bool has_keys(const File& file, const cvector<UINT>& wanted) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+void IndexDelta::add(
+    PCWSTR name,
+    UINT name_len,
+    ULONGLONG size,
+    ULONGLONG write_time,
+    UINT flags,
+    const UINT* file_keys,
+    UINT num_keys
+    )
+{
+    files.push_back(
+        File {
+            size,
+            write_time,
+            names.size(),
+            keys.size(),
+            name_len,
+            num_keys,
+            flags
+            }
+        );
+    names.insert(names.end(), name, name + name_len);
+    keys.insert(keys.end(), file_keys, file_keys + num_keys);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IndexDelta::load(const Yast& path)
+{
+    files.clear();
+    names.clear();
+    keys.clear();
+
+    cvector<BYTE> data;
+    if (!load_file(path, data) || data.size() < sizeof(DeltaHeader))
+    {
+        return false;
+    }
+    const BYTE* p = &data[0];
+    const BYTE* const end = p + data.size();
+    const DeltaHeader* hdr = p2p<const DeltaHeader*>(p);
+    if (hdr->magic != DELTA_MAGIC || hdr->version != INDEX_VERSION)
+    {
+        return false;
+    }
+    p += sizeof(DeltaHeader);
+    for (UINT i = 0; i < hdr->num_files; ++i)
+    {
+        if (size_t(end - p) < sizeof(DeltaRecord))
+        {
+            return false;
+        }
+        const DeltaRecord* rec = p2p<const DeltaRecord*>(p);
+        p += sizeof(DeltaRecord);
+        const size_t name_bytes = (rec->name_len + (rec->name_len & 1)) * 2;
+        const size_t key_bytes = size_t(rec->num_keys) * sizeof(UINT);
+        if (size_t(end - p) < name_bytes + key_bytes)
+        {
+            return false;
+        }
+        add(
+            p2p<PCWSTR>(p),
+            rec->name_len,
+            rec->size,
+            rec->write_time,
+            rec->flags,
+            p2p<const UINT*>(p + name_bytes),
+            rec->num_keys
+            );
+        p += name_bytes + key_bytes;
+    }
+    names.push_back(0);
+    heap_sort(files, NameLess<File> { &names[0] });
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IndexDelta::store(const Yast& path) const
+{
+    const DeltaHeader hdr = {
+        DELTA_MAGIC,
+        INDEX_VERSION,
+        static_cast<UINT>(files.size()),
+        0
+        };
+    cvector<BYTE> data;
+    const BYTE* bytes = p2p<const BYTE*>(&hdr);
+    data.insert(data.end(), bytes, bytes + sizeof(hdr));
+    for (const File& file : files)
+    {
+        const DeltaRecord rec = {
+            file.size,
+            file.write_time,
+            file.name_len,
+            file.num_keys,
+            file.flags,
+            0
+            };
+        bytes = p2p<const BYTE*>(&rec);
+        data.insert(data.end(), bytes, bytes + sizeof(rec));
+        bytes = p2p<const BYTE*>(&names[file.name_pos]);
+        data.insert(data.end(), bytes, bytes + file.name_len * 2);
+        if (file.name_len & 1)
+        {
+            data.push_back(0);
+            data.push_back(0);
+        }
+        if (file.num_keys)
+        {
+            bytes = p2p<const BYTE*>(&keys[file.keys_pos]);
+            data.insert(data.end(), bytes, bytes + file.num_keys * 4);
+        }
+    }
+    return store_file(path, data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+size_t IndexDelta::find(PCWSTR name, size_t len) const
+{
+    size_t lo = 0;
+    size_t hi = files.size();
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        const File& file = files[mid];
+        const int cmp = compare_names(
+            &names[file.name_pos],
+            file.name_len,
+            name,
+            len
+            );
+        if (cmp == 0)
+        {
+            return mid;
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return NOT_FOUND;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool IndexDelta::has_keys(const File& file, const cvector<UINT>& wanted) const
+{
+    if ((file.flags & FILE_INDEXED) == 0)
+    {
+        return true;
+    }
+    const UINT* const first = file.num_keys ? &keys[file.keys_pos] : nullptr;
+    for (UINT key : wanted)
+    {
+        size_t lo = 0;
+        size_t hi = file.num_keys;
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (first[mid] < key)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (lo == file.num_keys || first[lo] != key)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+TrigramIndex::TrigramIndex() :
+    m_view(),
+    m_mapping(nullptr),
+    m_header(nullptr),
+    m_files(nullptr),
+    m_names(nullptr),
+    m_required(0),
+    m_delta(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TrigramIndex::~TrigramIndex()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Yast TrigramIndex::index_path(const Yast& root)
+{
+    if (root.is_empty())
+    {
+        return Yast();
+    }
+
+    // The same root may be given with a different case or a trailing
+    // separator.
+    Yast name(root);
+    name.to_lower();
+    UINT len = name.length();
+    while (len > 1 && name.str()[len - 1] == OS_SEP)
+    {
+        --len;
+    }
+    ULONGLONG hash = FNV_BASIS;     // FNV-1a per character
+    for (UINT i = 0; i < len; ++i)
+    {
+        hash = (hash ^ name.str()[i]) * 1099511628211ull;
+    }
+    Yast file_name;
+    file_name.format(L"index_%016I64x.rgi", hash);
+    return app_data_path(file_name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TrigramIndex::build(const Yast& root, const volatile long* canceled)
+{
+    const Yast path(index_path(root));
+    if (path.is_empty())
+    {
+        return false;
+    }
+
+    // Collect the files first, since their ids are their positions in the
+    // sorted table.
+    cvector<IndexFile> files;
+    cvector<WCHAR> names;
+    Yast prefix;
+    {
+        DirectoryIterator diter(root);
+        const UINT prefix_len = diter.prefix_len();
+        Yast full_name;
+        bool is_dir;
+        while (diter.next(full_name, is_dir, true))
+        {
+            if (*canceled)
+            {
+                return false;
+            }
+            if (is_dir)
+            {
+                continue;
+            }
+            if (prefix.is_empty())
+            {
+                prefix = Yast(full_name.str(), prefix_len);
+            }
+            const OsDirEntry& info = *diter.get_info();
+            PCWSTR rel = full_name.str() + prefix_len;
+            const UINT rel_len = full_name.length() - prefix_len;
+            files.push_back(
+                IndexFile {
+                    info.size,
+                    info.write_time,
+                    names.size(),
+                    rel_len,
+                    0
+                    }
+                );
+            names.insert(names.end(), rel, rel + rel_len);
+        }
+    }
+    names.push_back(0);
+    heap_sort(files, NameLess<IndexFile> { &names[0] });
+    if (files.size() > MAXDWORD)
+    {
+        return false;
+    }
+
+    // The trigrams of every file are written to a temporary file as pairs
+    // of trigram and id in the order of the ids. Since the number of ids
+    // per trigram is counted too, the ids can be put in their final place
+    // afterwards without sorting anything.
+    const Yast tmp_path(path + L".tmp");
+    OsFile tmp;
+    if (!tmp.create_temp(tmp_path))
+    {
+        return false;
+    }
+
+    cvector<UINT> seen;                 // id + 1 of the last file
+    cvector<UINT> counts;
+    cvector<UINT> pairs;
+    seen.resize(NUM_KEYS);
+    counts.resize(NUM_KEYS);
+    pairs.reserve(PAIR_BUFFER);
+    ULONGLONG num_postings = 0;
+    bool ok = true;
+    {
+        TextFile tf;
+        for (UINT id = 0; ok && id < files.size(); ++id)
+        {
+            IndexFile& file = files[id];
+            const Yast full_name(
+                prefix + Yast(&names[file.name_pos], file.name_len)
+                );
+            ok = !*canceled;
+            if (
+                !ok ||
+                !tf.load(full_name, true, false, false, file.size) ||
+                !is_indexable(tf.get_encoding())
+                )
+            {
+                continue;
+            }
+            const Yast& content = tf.get_content();
+            const WCHAR* str = content.str();
+            for (UINT i = 0; i + 2 < content.length(); ++i)
+            {
+                const UINT key = trigram(str + i);
+                if (seen[key] != id + 1)
+                {
+                    seen[key] = id + 1;
+                    counts[key]++;
+                    pairs.push_back(key);
+                    pairs.push_back(id);
+                    num_postings++;
+                }
+            }
+            file.flags = FILE_INDEXED;
+            if (pairs.size() >= PAIR_BUFFER)
+            {
+                ok = write_pairs(tmp, pairs);
+                pairs.clear();
+            }
+        }
+    }
+    ok = ok && write_pairs(tmp, pairs) && num_postings <= MAXDWORD;
+    seen = cvector<UINT>();
+
+    // From now on counts tells where the next id of a trigram goes.
+    cvector<IndexKey> keys;
+    UINT pos = 0;
+    for (UINT key = 0; ok && key < NUM_KEYS; ++key)
+    {
+        const UINT count = counts[key];
+        if (count)
+        {
+            keys.push_back(IndexKey { key, count, pos, 0 });
+            counts[key] = pos;
+            pos += count;
+        }
+    }
+
+    const IndexHeader header = {
+        INDEX_MAGIC,
+        INDEX_VERSION,
+        static_cast<UINT>(files.size()),
+        static_cast<UINT>(keys.size()),
+        static_cast<UINT>(num_postings),
+        0,
+        names.size()
+        };
+    const ULONGLONG files_pos = sizeof(IndexHeader);
+    const ULONGLONG keys_pos = files_pos + files.size() * sizeof(IndexFile);
+    const ULONGLONG postings_pos = keys_pos + keys.size() * sizeof(IndexKey);
+    const ULONGLONG names_pos = postings_pos + num_postings * sizeof(UINT);
+    const ULONGLONG total = names_pos + names.size() * sizeof(WCHAR);
+
+    const Yast new_path(path + L".new");
+    OsFile file;
+    OsView mapping = {};
+    BYTE* view = nullptr;
+    ok = (
+        ok &&
+        total <= SIZE_MAX &&
+        file.create_mapped(
+            new_path,
+            static_cast<size_t>(total),
+            mapping,
+            view
+            )
+        );
+    if (ok)
+    {
+        memcpy(view, &header, sizeof(header));
+        if (files.size())
+        {
+            memcpy(view + files_pos, &files[0], keys_pos - files_pos);
+        }
+        if (keys.size())
+        {
+            memcpy(view + keys_pos, &keys[0], postings_pos - keys_pos);
+        }
+        memcpy(view + names_pos, &names[0], total - names_pos);
+
+        UINT* postings = p2p<UINT*>(view + postings_pos);
+        ok = tmp.rewind();
+        pairs.resize(PAIR_BUFFER);
+        size_t read = 0;
+        while (
+            ok &&
+            tmp.read(&pairs[0], PAIR_BUFFER * sizeof(UINT), read) &&
+            read != 0
+            )
+        {
+            const size_t num = read / sizeof(UINT);
+            for (size_t i = 0; i + 1 < num; i += 2)
+            {
+                postings[counts[pairs[i]]++] = pairs[i + 1];
+            }
+        }
+    }
+    if (view)
+    {
+        OsFile::unmap(mapping);
+    }
+    if (file.is_open())
+    {
+        file.close();
+        ok = ok && os_rename(new_path, path);
+        if (!ok)
+        {
+            os_delete_file(new_path);
+        }
+    }
+    if (ok)
+    {
+        // the new index contains all changes
+        os_delete_file(path + L".delta");
+    }
+    tmp.close();
+    TRACE("index '%S': %s\n", path.str(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TrigramIndex::exists(const Yast& root)
+{
+    const Yast path(index_path(root));
+    OsDirEntry entry;
+    return !path.is_empty() && os_get_entry(path, entry);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TrigramIndex::update(
+    const Yast& root,
+    const YastVector& changed,
+    const volatile long* canceled
+    )
+{
+    const Yast path(index_path(root));
+    OsDirEntry entry;
+    if (path.is_empty() || !os_get_entry(path, entry))
+    {
+        return build(root, canceled);
+    }
+    const Yast delta_path(path + L".delta");
+    Yast prefix(root);
+    if (prefix.is_empty() || prefix.str()[prefix.length() - 1] != OS_SEP)
+    {
+        prefix += OS_SEP_STR;
+    }
+
+    // A changed directory stands for all files below it. Files that do
+    // not exist anymore are remembered as removed, so that their old
+    // entries are dropped.
+    IndexDelta fresh;
+    cvector<UINT> seen;
+    cvector<UINT> keys;
+    seen.resize(NUM_KEYS / 32);
+    TextFile tf;
+    for (const Yast& rel : changed)
+    {
+        const Yast full_name(prefix + rel);
+        OsDirEntry info;
+        if (!os_get_entry(full_name, info))
+        {
+            fresh.add(rel.str(), rel.length(), 0, 0, FILE_REMOVED, nullptr, 0);
+            continue;
+        }
+        YastVector files;
+        if (info.is_dir())
+        {
+            DirectoryIterator diter(full_name);
+            Yast name;
+            bool is_dir;
+            while (diter.next(name, is_dir, true))
+            {
+                if (!is_dir)
+                {
+                    files.push_back(
+                        Yast(
+                            name.str() + prefix.length(),
+                            name.length() - prefix.length()
+                            )
+                        );
+                }
+            }
+        }
+        else
+        {
+            files.push_back(rel);
+        }
+
+        for (const Yast& file : files)
+        {
+            if (*canceled)
+            {
+                return false;
+            }
+            const Yast file_name(prefix + file);
+            if (!os_get_entry(file_name, info))
+            {
+                continue;
+            }
+            UINT flags = 0;
+            keys.clear();
+            if (
+                tf.load(file_name, true, false, false, info.size) &&
+                is_indexable(tf.get_encoding())
+                )
+            {
+                collect_trigrams(tf.get_content(), seen, keys);
+                flags = FILE_INDEXED;
+            }
+            tf.unload();
+            fresh.add(
+                file.str(),
+                file.length(),
+                info.size,
+                info.write_time,
+                flags,
+                keys.size() ? &keys[0] : nullptr,
+                static_cast<UINT>(keys.size())
+                );
+        }
+    }
+    fresh.names.push_back(0);
+    heap_sort(fresh.files, NameLess<IndexDelta::File> { &fresh.names[0] });
+    fresh.names.pop_back();
+
+    // The new delta consists of the fresh entries and all old ones, that
+    // have not been looked at again.
+    IndexDelta old;
+    IndexDelta merged;
+    old.load(delta_path);
+    for (const IndexDelta::File& file : old.files)
+    {
+        PCWSTR name = &old.names[file.name_pos];
+        if (fresh.find(name, file.name_len) == IndexDelta::NOT_FOUND)
+        {
+            merged.add(
+                name,
+                file.name_len,
+                file.size,
+                file.write_time,
+                file.flags,
+                file.num_keys ? &old.keys[file.keys_pos] : nullptr,
+                file.num_keys
+                );
+        }
+    }
+    for (const IndexDelta::File& file : fresh.files)
+    {
+        if ((file.flags & FILE_REMOVED) == 0)
+        {
+            merged.add(
+                &fresh.names[file.name_pos],
+                file.name_len,
+                file.size,
+                file.write_time,
+                file.flags,
+                file.num_keys ? &fresh.keys[file.keys_pos] : nullptr,
+                file.num_keys
+                );
+        }
+    }
+    TRACE(
+        "index delta '%S': %u files\n",
+        delta_path.str(),
+        UINT(merged.files.size())
+        );
+    if (merged.files.size() > MAX_DELTA_FILES)
+    {
+        return build(root, canceled);
+    }
+    return merged.store(delta_path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TrigramIndex::open(const Yast& root, const Yast& literal, bool ignore_case)
+{
+    close();
+
+    // The index does not know how characters beyond ASCII are folded. So
+    // their trigrams cannot be looked up, when case is ignored.
+    cvector<UINT> lookups;
+    PCWSTR const str = literal.str();
+    for (UINT i = 0; i + 2 < literal.length(); ++i)
+    {
+        if (
+            ignore_case &&
+            (str[i] >= 0x80 || str[i + 1] >= 0x80 || str[i + 2] >= 0x80)
+            )
+        {
+            continue;
+        }
+        const UINT key = trigram(str + i);
+        bool known = false;
+        for (UINT k : lookups)
+        {
+            known = known || (k == key);
+        }
+        if (!known && lookups.size() < MAX_LOOKUPS)
+        {
+            lookups.push_back(key);
+        }
+    }
+    if (lookups.size() == 0)
+    {
+        return false;
+    }
+
+    const Yast path(index_path(root));
+    OsFile file;
+    uint64_t size = 0;
+    if (
+        !file.open(path) ||
+        !file.size(size) ||
+        size < sizeof(IndexHeader) ||
+        size > SIZE_MAX ||
+        !file.map(0, static_cast<size_t>(size), m_view)
+        )
+    {
+        return false;
+    }
+    file.close();
+    m_mapping = m_view.data;
+
+    const IndexHeader* hdr = p2p<const IndexHeader*>(m_mapping);
+    const ULONGLONG files_pos = sizeof(IndexHeader);
+    const ULONGLONG keys_pos = files_pos + hdr->num_files * sizeof(IndexFile);
+    const ULONGLONG postings_pos = keys_pos + hdr->num_keys * sizeof(IndexKey);
+    const ULONGLONG names_pos = postings_pos + hdr->num_postings * sizeof(UINT);
+    if (
+        hdr->magic != INDEX_MAGIC ||
+        hdr->version != INDEX_VERSION ||
+        names_pos + hdr->names_len * sizeof(WCHAR) != size
+        )
+    {
+        close();
+        return false;
+    }
+    m_header = hdr;
+    m_files = p2p<const IndexFile*>(m_mapping + files_pos);
+    m_names = p2p<PCWSTR>(m_mapping + names_pos);
+    const IndexKey* const keys = p2p<const IndexKey*>(m_mapping + keys_pos);
+    const UINT* const postings = p2p<const UINT*>(m_mapping + postings_pos);
+
+    // A file passes, if it is found in the lists of all trigrams. Its
+    // counter is only advanced, if it has been found in all lists so far.
+    m_hits.resize(hdr->num_files);
+    for (UINT key : lookups)
+    {
+        size_t lo = 0;
+        size_t hi = hdr->num_keys;
+        while (lo < hi)
+        {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (keys[mid].key < key)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (lo == hdr->num_keys || keys[lo].key != key)
+        {
+            // no indexed file contains this trigram
+            m_required = static_cast<BYTE>(lookups.size() + 1);
+            break;
+        }
+        const UINT* ids = postings + keys[lo].pos;
+        for (UINT i = 0; i < keys[lo].count; ++i)
+        {
+            BYTE& hits = m_hits[ids[i]];
+            if (hits == m_required)
+            {
+                hits++;
+            }
+        }
+        m_required++;
+    }
+
+    // Files that have changed since the index was built are looked up in
+    // the delta instead.
+    m_delta = new IndexDelta;
+    if (m_delta->load(path + L".delta"))
+    {
+        m_delta_hits.resize(m_delta->files.size());
+        for (size_t i = 0; i < m_delta->files.size(); ++i)
+        {
+            m_delta_hits[i] = m_delta->has_keys(m_delta->files[i], lookups);
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TrigramIndex::close()
+{
+    if (m_mapping)
+    {
+        OsFile::unmap(m_view);
+    }
+    m_view = OsView();
+    m_mapping = nullptr;
+    m_header = nullptr;
+    m_files = nullptr;
+    m_names = nullptr;
+    m_hits = cvector<BYTE>();
+    m_required = 0;
+    delete m_delta;
+    m_delta = nullptr;
+    m_delta_hits = cvector<BYTE>();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool TrigramIndex::may_match(PCWSTR rel_path, const OsDirEntry& info) const
+{
+    if (m_header == nullptr)
+    {
+        return true;
+    }
+    const size_t len = os_strlen(rel_path);
+    const size_t pos = m_delta ? m_delta->find(rel_path, len) : ~size_t(0);
+    if (pos != IndexDelta::NOT_FOUND)
+    {
+        const IndexDelta::File& file = m_delta->files[pos];
+        if (
+            file.size != info.size ||
+            file.write_time != info.write_time
+            )
+        {
+            return true;
+        }
+        return m_delta_hits[pos] != 0;
+    }
+    size_t lo = 0;
+    size_t hi = m_header->num_files;
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+        const IndexFile& file = m_files[mid];
+        const int cmp = compare_names(
+            m_names + file.name_pos,
+            file.name_len,
+            rel_path,
+            len
+            );
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else if (cmp > 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            if (
+                (file.flags & FILE_INDEXED) == 0 ||
+                file.size != info.size ||
+                file.write_time != info.write_time
+                )
+            {
+                return true;
+            }
+            return m_hits[mid] == m_required;
+        }
+    }
+    // not indexed yet
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
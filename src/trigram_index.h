@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of rgrep.
+// rgrep is based on PCRE2 (see pcre2_16\LICENCE).
+//
+// Copyright 2018-2025 Rocco Matano
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "rgrep_util.h"
+#include "platform.h"
+
+struct IndexHeader;
+struct IndexFile;
+struct IndexDelta;
+
+//
+// An index of the trigrams (three consecutive characters) that occur in the
+// text files below a search root. A search for a pattern, that every match
+// of contains a certain literal, can skip all indexed files that lack one
+// of the trigrams of that literal. The index is a single file, that is
+// mapped into memory as it is: a table of the files sorted by their path
+// relative to the root, a sorted table of the trigrams and for every
+// trigram the ascending ids of the files that contain it. A file is only
+// trusted as long as its size and its time of last write are unchanged.
+// All other files (new, modified, binary, ANSI or too large ones) are
+// always searched. Changed files can be indexed again with update(),
+// which keeps them in a small delta file next to the index.
+//
+class TrigramIndex
+{
+public:
+    TrigramIndex();
+    ~TrigramIndex();
+
+    // Reads all files below root and (re)writes the index of root.
+    static bool build(const Yast& root, const volatile long* canceled);
+
+    // Indexes the given files or directories (relative to root) again.
+    // Builds the whole index, if there is none or the delta gets too big.
+    static bool update(
+        const Yast& root,
+        const YastVector& changed,
+        const volatile long* canceled
+        );
+
+    static bool exists(const Yast& root);
+
+    // Maps the index of root and determines the files that may contain
+    // literal. Returns false, if there is no index or literal has no
+    // trigram that could be looked up. Then every file has to be searched.
+    bool open(const Yast& root, const Yast& literal, bool ignore_case);
+    void close();
+
+    // Whether a file has to be searched. rel_path is relative to the root.
+    // May be called by several threads at once.
+    bool may_match(PCWSTR rel_path, const OsDirEntry& info) const;
+
+    // Where the index of root is stored.
+    static Yast index_path(const Yast& root);
+
+private:
+    TrigramIndex(const TrigramIndex&) = delete;
+    TrigramIndex& operator=(const TrigramIndex&) = delete;
+
+    OsView              m_view;
+    const BYTE*         m_mapping;      // the data of m_view
+    const IndexHeader*  m_header;
+    const IndexFile*    m_files;
+    PCWSTR              m_names;
+    cvector<BYTE>       m_hits;         // trigrams found per file
+    BYTE                m_required;     // trigrams a file needs
+    IndexDelta*         m_delta;
+    cvector<BYTE>       m_delta_hits;   // whether a delta file may match
+};
+
+////////////////////////////////////////////////////////////////////////////////